@@ -5,6 +5,7 @@ for Count-Min Sketch MPI implementations
 
 import subprocess
 import re
+import json
 import shutil
 import csv
 import os
@@ -14,11 +15,23 @@ DATASET = "data/dataset_5000000_sorted.txt"
 FOLDER = "data/"
 
 MPIRUN = "mpirun.actual" if shutil.which("mpirun.actual") else "mpirun"
+REPORT = "benchmark_report.jsonl"
 
 def run_command(cmd):
     result = subprocess.run(cmd, shell=True, capture_output=True, text=True)
     return result.stdout + result.stderr
 
+def run_with_report(cmd):
+    """Run a driver with --report, return its output and JSON record (None if missing)"""
+    if os.path.exists(REPORT):
+        os.remove(REPORT)
+    output = run_command(f"{cmd} --report={REPORT}")
+    try:
+        with open(REPORT) as f:
+            return output, json.loads(f.readlines()[-1])
+    except (OSError, IndexError, ValueError):
+        return output, None
+
 def extract_time(output, pattern):
     """Extract time from output using regex"""
     match = re.search(pattern, output)
@@ -103,9 +116,9 @@ print("MAINV2.C (MPI-I/O Implementation)")
  
 for P in processes:
     print(f"Running mainV2.c with {P} processes")
-    cmd = f"{MPIRUN} -np {P} ./mainV2 {DATASET}"
-    output = run_command(cmd)
-    T = extract_time(output, r"Total time V2 full chunk: ([\d.]+) seconds")
+    cmd = f"{MPIRUN} -np {P} ./mpiV2 {DATASET}"
+    output, report = run_with_report(cmd)
+    T = report['wall'] if report else None
     
     if T is None:
         T = extract_time(output, r"Total time:[\s]+([\d.]+) s")
@@ -130,6 +143,10 @@ for P in processes:
     })
     
     print(f"Time with {P} processes: {T:.3f}s")
+    if report:
+        # the slowest rank bounds every phase, max/mean shows where the scaling is lost
+        for name, phase in report['phases'].items():
+            print(f"  {name}: max {phase['max']:.3f}s, mean {phase['mean']:.3f}s, imbalance {phase['imbalance']:.2f}")
 
 # Calculate speedup/efficiency for mainV2.c using its own 1-process time
 if len(results_mainv2) > 0:
@@ -17,10 +17,17 @@ test_configurations = [
   {"chunks" : 1, "cores_per_chunk" : 1, "mode" : "pack:excl", "processes" : 1, "threads" : 1},
 ]
 RESULTS_DIR = "output_results"
+
+# extra driver flags, e.g. "--update=owner" to sweep the ownership-partitioned mode
+EXTRA_ARGS = ""
+
+def args_tag():
+  # "--update=owner" -> "_update-owner", keeps job and csv names apart per mode
+  return "".join("_" + a.lstrip("-").replace("=", "-") for a in EXTRA_ARGS.split())
 os.makedirs(RESULTS_DIR, exist_ok=True)
 
 def gen_pbs_script(chunks, cores_per_chunk, mode, processes, threads, executable_name, dataset_folder, dataset_name):
-  name = f"hybrid_{extract_number_from_dataset(dataset_name)}_{chunks}_{threads}_packexcl"
+  name = f"hybrid_{extract_number_from_dataset(dataset_name)}_{chunks}_{threads}_packexcl{args_tag()}"
   walltime = "0:30:00"
   queue = "short_HPC4DS"
   pbs_script = f"""#!/bin/bash
@@ -42,7 +49,7 @@ module load python-3.10.14
 
 export OMP_NUM_THREADS={threads}
 
-mpirun.actual -np {processes} ./{executable_name} {dataset_folder}/{dataset_name} {dataset_folder}/ > {RESULTS_DIR}/{name}/output.txt 2> {RESULTS_DIR}/{name}/error.txt
+mpirun.actual -np {processes} ./{executable_name} {dataset_folder}/{dataset_name} {dataset_folder}/ {EXTRA_ARGS} > {RESULTS_DIR}/{name}/output.txt 2> {RESULTS_DIR}/{name}/error.txt
 """
   return pbs_script
 
@@ -69,7 +76,7 @@ def gen_script(configuration, executable_name, dataset_folder, dataset_name):
   processes = configuration['processes']
   threads = configuration['threads']
 
-  name = f"hybrid_{extract_number_from_dataset(dataset_name)}_{chunks}_{threads}_packexcl"
+  name = f"hybrid_{extract_number_from_dataset(dataset_name)}_{chunks}_{threads}_packexcl{args_tag()}"
   print(f"Running with {name} configuration")
 
   pbs_script = gen_pbs_script(chunks, cores_per_chunk, mode, processes, threads, executable_name, dataset_folder, dataset_name)
@@ -184,7 +191,7 @@ def main():
   subprocess.run(f"rm hybrid_{extract_number_from_dataset(dataset_name)}_*", shell=True, capture_output=True, text=True)
 
 def save_results_to_csv(all_results, dataset_name):
-  csv_filename = f"{RESULTS_DIR}/benchmark_{extract_number_from_dataset(dataset_name)}_hybridv2_packexcl.csv"
+  csv_filename = f"{RESULTS_DIR}/benchmark_{extract_number_from_dataset(dataset_name)}_hybridv2_packexcl{args_tag()}.csv"
   file_exists = os.path.exists(csv_filename)
 
   with open(csv_filename, 'a', newline='') as csvfile:
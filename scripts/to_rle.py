@@ -0,0 +1,43 @@
+import argparse
+import struct
+
+# Converts a text dataset (one value per line) into the binary RLE format read by the drivers:
+# a flat array of little-endian uint32 (key, count) pairs, one per run of consecutive equal keys.
+# Sorted inputs give the best compression, unsorted ones are still valid.
+
+MAX_COUNT = 2**32 - 1
+
+def to_rle(infile, outfile):
+    n_items = 0
+    n_runs = 0
+    with open(infile, "r") as f, open(outfile, "wb") as out:
+        key = None
+        count = 0
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            val = int(line)
+            n_items += 1
+            if val == key and count < MAX_COUNT:
+                count += 1
+                continue
+            if key is not None:
+                out.write(struct.pack("<II", key, count))
+                n_runs += 1
+            key = val
+            count = 1
+        if key is not None:
+            out.write(struct.pack("<II", key, count))
+            n_runs += 1
+    return n_items, n_runs
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("infile")
+    parser.add_argument("outfile", nargs="?")
+    args = parser.parse_args()
+
+    outfile = args.outfile or args.infile.rsplit(".", 1)[0] + ".rle"
+    n_items, n_runs = to_rle(args.infile, outfile)
+    print(f"{args.infile}: {n_items} items -> {n_runs} runs in {outfile}")
@@ -0,0 +1,624 @@
+#include <math.h>
+#include <mpi.h>
+#include <omp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/cms_alloc.h"
+#include "../core/cms_engine.h"
+#include "../core/cms_kernels.h"
+#include "../core/cms_live.h"
+#include "../core/cms_merge.h"
+#include "../core/cms_reduce.h"
+#include "../core/cms_topology.h"
+#include "../core/count_min_sketch.h"
+
+/*
+ * Micro-benchmark harness
+ * every kernel (hash, update, batch update per strategy, point/range/inner product
+ * queries, private-copy merge, serialization, reduction) runs in isolation on
+ * synthetic keys: warmup passes, then timed repetitions. The *_special kernels
+ * run the update and point query specialized on the sketch shape (cms_kernels.h)
+ * next to the generic ones. The live_* kernels
+ * ingest into a live sketch (cms_live.h), live_mixed with reader threads
+ * querying it back to back, to measure ingestion and queries under mixed load. With mpirun -np N the
+ * ranks run each repetition together and a repetition lasts as long as its slowest
+ * rank; without mpirun it is a single process. Results go out as JSON or CSV with
+ * the median and percentile timings.
+ *
+ *   ./cms_bench [--flag=value ...]
+ *   mpirun -np 4 ./cms_bench --keys=4194304 --dist=zipf --format=csv --out=bench.csv
+ */
+
+typedef enum { DIST_UNIFORM, DIST_ZIPF } KeyDist;
+
+typedef struct {
+  uint32_t depth;
+  uint32_t width;
+  size_t keys;        // keys per rank and repetition
+  uint32_t universe;  // distinct keys
+  KeyDist dist;
+  double skew;        // zipf exponent
+  int warmup;
+  int reps;
+  int threads;        // 0 = OpenMP default
+  int pin;
+  int csv;
+  size_t batch;       // engine batch, 0 = OWNER_BATCH
+  uint64_t seed;
+  const char* out;    // NULL = stdout
+  const char* kernels;  // comma separated subset, NULL = all
+  int readers;        // query threads of live_mixed
+  int publish;        // batches of writer 0 between two publishes
+} BenchConfig;
+
+// state shared by the kernels, built once
+typedef struct {
+  BenchConfig cfg;
+  uint32_t* keys;
+  CountMinSketch a;        // updated by the update kernels, queried by the others
+  CountMinSketch b;        // second operand of the inner product, merge target
+  CountMinSketch* copies;  // one per thread for the merge
+  CountMinSketch** slots;
+  CmsEngine engines[3];    // private, atomic, partitioned
+  const CmsKernels* kern;  // specialized on the shape of a
+  uint32_t* packed;        // serialization buffer
+  int rank;
+  int size;
+  volatile uint32_t sink;  // keeps the query results alive
+  CmsLive live;
+  struct LiveReaderArg* readers;
+  int live_stop;
+  // live_* statistics, reset before the timed passes
+  double* query_lat;       // query latencies in seconds
+  size_t n_query_lat;
+  size_t max_query_lat;
+  uint64_t queries;
+  uint64_t publishes;
+  double t_publish;
+  double publish_max;
+} Bench;
+
+#define LIVE_SAMPLES (1u << 14)  // latencies kept per reader and pass, the last ones
+
+// one query thread of live_mixed
+typedef struct LiveReaderArg {
+  Bench* b;
+  int id;
+  uint64_t queries;
+  uint32_t sink;
+  double* lat;  // LIVE_SAMPLES, written cyclically
+} LiveReaderArg;
+
+static const char* KERNELS[] = {"hash",          "update",      "batch_private", "batch_atomic",
+                                "batch_partitioned", "point_query", "range_query", "inner_product",
+                                "merge",         "serialize",   "reduce",      "update_special",
+                                "point_query_special", "live_ingest", "live_mixed"};
+#define N_KERNELS (int)(sizeof(KERNELS) / sizeof(KERNELS[0]))
+#define RANGE_LEN 10  // keys per range query
+#define LIVE_KERNEL 13  // first of the live_* kernels
+
+// splitmix64: small, fast and good enough to draw benchmark keys
+static uint64_t next_random(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static double next_unit(uint64_t* state) {
+  return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// keys in [0, universe): uniform, or zipf by inverse CDF (rank 0 most frequent)
+static uint32_t* make_keys(const BenchConfig* cfg, int rank) {
+  uint32_t* keys = cms_buffer_alloc(cfg->keys * sizeof(uint32_t));
+  if (!keys)
+    return NULL;
+  uint64_t state = cfg->seed + 0x1000193ULL * (uint64_t)(rank + 1);
+
+  if (cfg->dist == DIST_UNIFORM) {
+    for (size_t i = 0; i < cfg->keys; i++)
+      keys[i] = (uint32_t)(next_random(&state) % cfg->universe);
+    return keys;
+  }
+
+  double* cdf = malloc(cfg->universe * sizeof(double));
+  if (!cdf) {
+    cms_buffer_free(keys);
+    return NULL;
+  }
+  double sum = 0;
+  for (uint32_t k = 0; k < cfg->universe; k++)
+    cdf[k] = (sum += 1.0 / pow(k + 1.0, cfg->skew));
+  for (size_t i = 0; i < cfg->keys; i++) {
+    double u = next_unit(&state) * sum;
+    uint32_t lo = 0, hi = cfg->universe - 1;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    keys[i] = lo;
+  }
+  free(cdf);
+  return keys;
+}
+
+// a sketch of exactly depth x width cells, hashes drawn from the seeded rand()
+static int make_sketch(CountMinSketch* cms, uint32_t depth, uint32_t width) {
+  cms->depth = depth;
+  cms->width = width;
+  cms->total = 0;
+  cms->epsilon = exp(1.0) / width;
+  cms->delta = exp(-(double)depth);
+  cms->table = malloc(depth * sizeof(uint32_t*));
+  cms->hashFunctions = malloc(depth * sizeof(UniversalHash));
+  if (!cms->table || !cms->hashFunctions)
+    return -1;
+  cms->table[0] = cms_buffer_alloc((size_t)depth * width * sizeof(uint32_t));
+  if (!cms->table[0])
+    return -1;
+  for (uint32_t d = 1; d < depth; d++)
+    cms->table[d] = cms->table[0] + (size_t)d * width;
+  universal_hash_array_init(cms->hashFunctions, PRIME, width, depth);
+  return 0;
+}
+
+static int kernel_selected(const BenchConfig* cfg, const char* name) {
+  if (!cfg->kernels)
+    return 1;
+  size_t len = strlen(name);
+  for (const char* p = cfg->kernels; *p;) {
+    const char* end = strchr(p, ',');
+    size_t n = end ? (size_t)(end - p) : strlen(p);
+    if (n == len && strncmp(p, name, n) == 0)
+      return 1;
+    p += n + (end ? 1 : 0);
+  }
+  return 0;
+}
+
+static void* live_reader(void* arg) {
+  LiveReaderArg* r = arg;
+  Bench* b = r->b;
+  size_t n = b->cfg.keys;
+  size_t i = (size_t)r->id * 7919 % n;
+  uint64_t q = 0;
+  uint32_t acc = 0;
+  while (!__atomic_load_n(&b->live_stop, __ATOMIC_ACQUIRE)) {
+    double t0 = omp_get_wtime();
+    acc += live_point_query(&b->live, r->id, b->keys[i]);
+    r->lat[q % LIVE_SAMPLES] = omp_get_wtime() - t0;
+    q++;
+    if (++i == n)
+      i = 0;
+  }
+  r->queries = q;
+  r->sink = acc;
+  return NULL;
+}
+
+static void live_publish_timed(Bench* b) {
+  double t0 = omp_get_wtime();
+  live_publish(&b->live);
+  double t = omp_get_wtime() - t0;
+  b->publishes++;
+  b->t_publish += t;
+  if (t > b->publish_max)
+    b->publish_max = t;
+}
+
+// the keys in engine batches, writer 0 publishing every cfg.publish of its
+// batches, while cfg.readers threads query (mixed) or nobody does
+static uint64_t live_run(Bench* b, int mixed) {
+  const BenchConfig* cfg = &b->cfg;
+  const uint32_t* keys = b->keys;
+  size_t n = cfg->keys;
+  size_t batch = b->engines[0].batch;
+  int n_readers = mixed ? cfg->readers : 0;
+  pthread_t* tids = malloc((n_readers > 0 ? n_readers : 1) * sizeof(pthread_t));
+  if (!tids)
+    MPI_Abort(MPI_COMM_WORLD, 99);
+
+  b->live_stop = 0;
+  for (int r = 0; r < n_readers; r++) {
+    b->readers[r].queries = 0;
+    if (pthread_create(&tids[r], NULL, live_reader, &b->readers[r]) != 0)
+      MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+#pragma omp parallel
+  {
+    int t = omp_get_thread_num();
+    size_t step = (size_t)omp_get_num_threads() * batch;
+    int batches = 0;
+    for (size_t lo = (size_t)t * batch; lo < n; lo += step) {
+      live_update(&b->live, t, keys + lo, lo + batch < n ? batch : n - lo);
+      if (t == 0 && ++batches % cfg->publish == 0)
+        live_publish_timed(b);
+    }
+  }
+  // everything ingested is visible
+  live_publish_timed(b);
+  __atomic_store_n(&b->live_stop, 1, __ATOMIC_RELEASE);
+
+  for (int r = 0; r < n_readers; r++) {
+    LiveReaderArg* arg = &b->readers[r];
+    pthread_join(tids[r], NULL);
+    b->sink += arg->sink;
+    b->queries += arg->queries;
+    size_t kept = arg->queries < LIVE_SAMPLES ? (size_t)arg->queries : LIVE_SAMPLES;
+    if (kept > b->max_query_lat - b->n_query_lat)
+      kept = b->max_query_lat - b->n_query_lat;
+    memcpy(b->query_lat + b->n_query_lat, arg->lat, kept * sizeof(double));
+    b->n_query_lat += kept;
+  }
+  free(tids);
+  return n;
+}
+
+// one pass of kernel k, returns the number of operations it performed
+static uint64_t kernel_run(Bench* b, int k) {
+  CountMinSketch* a = &b->a;
+  const uint32_t* keys = b->keys;
+  size_t n = b->cfg.keys;
+  size_t cells = (size_t)a->depth * a->width;
+
+  switch (k) {
+    case 0: {  // hash: every row of every key
+      uint32_t acc = 0;
+      for (size_t i = 0; i < n; i++)
+        for (uint32_t d = 0; d < a->depth; d++)
+          acc += cms_column(&a->hashFunctions[d], keys[i]);
+      b->sink = acc;
+      return (uint64_t)n * a->depth;
+    }
+    case 1:  // serial update
+      for (size_t i = 0; i < n; i++)
+        cms_update_int(a, keys[i], 1);
+      return n;
+    case 2:
+    case 3:
+    case 4:  // threaded batch update through the engine
+      engine_update_items(&b->engines[k - 2], keys, n);
+      return n;
+    case 5: {
+      uint32_t acc = 0;
+      for (size_t i = 0; i < n; i++)
+        acc += cms_point_query_int(a, keys[i]);
+      b->sink = acc;
+      return n;
+    }
+    case 6: {
+      size_t queries = n / RANGE_LEN;
+      uint32_t acc = 0;
+      for (size_t i = 0; i < queries; i++)
+        acc += cms_range_query_int(a, (int)keys[i], (int)keys[i] + RANGE_LEN - 1);
+      b->sink = acc;
+      return queries;
+    }
+    case 7:
+      b->sink = cms_inner_product(a, &b->b);
+      return 1;
+    case 8: {  // merge of one private copy per thread into b
+      int used = 0;
+#pragma omp parallel
+      {
+#pragma omp single
+        used = omp_get_num_threads();
+        cms_merge_private(&b->b, b->slots, &b->copies[omp_get_thread_num()], CMS_MERGE_COLUMNS);
+      }
+      return (uint64_t)cells * used;
+    }
+    case 9:  // serialization: pack table and total, then unpack into b
+      memcpy(b->packed, a->table[0], cells * sizeof(uint32_t));
+      b->packed[cells] = a->total;
+      memcpy(b->b.table[0], b->packed, cells * sizeof(uint32_t));
+      b->b.total = b->packed[cells];
+      return cells;
+    case 10: {  // reduction of every rank's sketch, everyone gets the result
+      ReducedSketch out;
+      uint32_t meta = a->total;
+      if (cms_reduce(a, &out, &meta, 1, CMS_REDUCE_ALL, MPI_COMM_WORLD) != 0)
+        MPI_Abort(MPI_COMM_WORLD, 98);
+      reduced_free(&out);
+      return cells;
+    }
+    case 11:
+      for (size_t i = 0; i < n; i++)
+        b->kern->update(a, keys[i], 1);
+      return n;
+    case 12: {
+      uint32_t acc = 0;
+      for (size_t i = 0; i < n; i++)
+        acc += b->kern->query(a, keys[i]);
+      b->sink = acc;
+      return n;
+    }
+    default:
+      return live_run(b, k == LIVE_KERNEL + 1);
+  }
+}
+
+static int cmp_double(const void* x, const void* y) {
+  double a = *(const double*)x, b = *(const double*)y;
+  return (a > b) - (a < b);
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int n, double p) {
+  int idx = (int)ceil(p * n) - 1;
+  return sorted[idx < 0 ? 0 : idx];
+}
+
+static int parse_config(int argc, char* argv[], BenchConfig* cfg) {
+  cfg->depth = (uint32_t)ceil(log(1 / DELTA));
+  cfg->width = (uint32_t)ceil(exp(1.0) / EPSILON);
+  cfg->keys = 1u << 20;
+  cfg->universe = 1u << 20;
+  cfg->dist = DIST_UNIFORM;
+  cfg->skew = 1.1;
+  cfg->warmup = 2;
+  cfg->reps = 10;
+  cfg->threads = 0;
+  cfg->pin = 0;
+  cfg->csv = 0;
+  cfg->batch = 0;
+  cfg->seed = 42;
+  cfg->out = NULL;
+  cfg->kernels = NULL;
+  cfg->readers = 2;
+  cfg->publish = 16;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* eq = strchr(arg, '=');
+    const char* v = eq ? eq + 1 : "";
+    if (strncmp(arg, "--depth=", 8) == 0) {
+      cfg->depth = (uint32_t)strtoul(v, NULL, 10);
+    } else if (strncmp(arg, "--width=", 8) == 0) {
+      cfg->width = (uint32_t)strtoul(v, NULL, 10);
+    } else if (strncmp(arg, "--keys=", 7) == 0) {
+      cfg->keys = strtoull(v, NULL, 10);
+    } else if (strncmp(arg, "--universe=", 11) == 0) {
+      cfg->universe = (uint32_t)strtoul(v, NULL, 10);
+    } else if (strcmp(arg, "--dist=uniform") == 0) {
+      cfg->dist = DIST_UNIFORM;
+    } else if (strcmp(arg, "--dist=zipf") == 0) {
+      cfg->dist = DIST_ZIPF;
+    } else if (strncmp(arg, "--skew=", 7) == 0) {
+      cfg->skew = strtod(v, NULL);
+    } else if (strncmp(arg, "--warmup=", 9) == 0) {
+      cfg->warmup = atoi(v);
+    } else if (strncmp(arg, "--reps=", 7) == 0) {
+      cfg->reps = atoi(v);
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      cfg->threads = atoi(v);
+    } else if (strcmp(arg, "--pin") == 0) {
+      cfg->pin = 1;
+    } else if (strcmp(arg, "--format=json") == 0) {
+      cfg->csv = 0;
+    } else if (strcmp(arg, "--format=csv") == 0) {
+      cfg->csv = 1;
+    } else if (strncmp(arg, "--batch=", 8) == 0) {
+      cfg->batch = strtoull(v, NULL, 10);
+    } else if (strncmp(arg, "--seed=", 7) == 0) {
+      cfg->seed = strtoull(v, NULL, 10);
+    } else if (strncmp(arg, "--out=", 6) == 0 && *v) {
+      cfg->out = v;
+    } else if (strncmp(arg, "--kernels=", 10) == 0 && *v) {
+      cfg->kernels = v;
+    } else if (strncmp(arg, "--readers=", 10) == 0) {
+      cfg->readers = atoi(v);
+    } else if (strncmp(arg, "--publish=", 10) == 0) {
+      cfg->publish = atoi(v);
+    } else if (strcmp(arg, "--help") == 0) {
+      return -1;
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", arg);
+      return -1;
+    }
+  }
+  if (cfg->depth == 0 || cfg->width == 0 || cfg->keys < RANGE_LEN || cfg->universe == 0 ||
+      cfg->reps <= 0 || cfg->warmup < 0 || cfg->threads < 0 || cfg->skew <= 0 || cfg->readers < 0 ||
+      cfg->publish <= 0) {
+    fprintf(stderr, "Error: sizes, keys, universe, reps, skew and publish must be positive\n");
+    return -1;
+  }
+  return 0;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [options]   (or mpirun -np N %s [options])\n"
+          "  --depth=d --width=w   sketch size (default %u x %u)\n"
+          "  --keys=n              keys per rank and repetition (default 1048576)\n"
+          "  --universe=u          distinct keys (default 1048576)\n"
+          "  --dist=uniform|zipf   key distribution, --skew=s zipf exponent (default 1.1)\n"
+          "  --warmup=n --reps=n   untimed and timed passes per kernel (default 2 and 10)\n"
+          "  --threads=n --pin     OpenMP threads and thread pinning\n"
+          "  --batch=n             engine batch of the batch_* kernels (default %d)\n"
+          "  --kernels=a,b         subset of: hash update batch_private batch_atomic batch_partitioned\n"
+          "                        point_query range_query inner_product merge serialize reduce\n"
+          "                        update_special point_query_special live_ingest live_mixed\n"
+          "  --readers=n           query threads of live_mixed (default 2)\n"
+          "  --publish=n           live_* batches of writer 0 between publishes (default 16)\n"
+          "  --format=json|csv --out=file   output (default JSON on stdout)\n"
+          "  --seed=n              keys and hashes\n",
+          prog, prog, (uint32_t)ceil(log(1 / DELTA)), (uint32_t)ceil(exp(1.0) / EPSILON), OWNER_BATCH);
+}
+
+int main(int argc, char* argv[]) {
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  Bench b;
+  memset(&b, 0, sizeof(b));
+  MPI_Comm_rank(MPI_COMM_WORLD, &b.rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &b.size);
+
+  if (parse_config(argc, argv, &b.cfg) != 0) {
+    if (b.rank == 0) print_usage(argv[0]);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  BenchConfig* cfg = &b.cfg;
+  if (cfg->threads > 0) omp_set_num_threads(cfg->threads);
+  int pinned = cfg->pin ? topo_pin_threads() : 0;
+  int threads = omp_get_max_threads();
+
+  // same hashes on every rank, different keys
+  srand((unsigned)cfg->seed);
+  b.keys = make_keys(cfg, b.rank);
+  b.copies = calloc(threads, sizeof(CountMinSketch));
+  b.slots = malloc(threads * sizeof(CountMinSketch*));
+  b.packed = malloc(((size_t)cfg->depth * cfg->width + 1) * sizeof(uint32_t));
+  int ok = b.keys && b.copies && b.slots && b.packed && make_sketch(&b.a, cfg->depth, cfg->width) == 0 &&
+           make_sketch(&b.b, cfg->depth, cfg->width) == 0;
+  for (int t = 0; ok && t < threads; t++)
+    ok = make_sketch(&b.copies[t], cfg->depth, cfg->width) == 0;
+  for (int s = CMS_STRATEGY_PRIVATE; ok && s <= CMS_STRATEGY_PARTITIONED; s++)
+    ok = engine_init(&b.engines[s], &b.a, (CmsStrategy)s, cfg->batch, CMS_MERGE_COLUMNS, NULL, NULL, 0) == 0;
+  b.kern = cms_kernels_select(&b.a);
+  b.max_query_lat = (size_t)cfg->reps * cfg->readers * LIVE_SAMPLES;
+  b.query_lat = malloc((b.max_query_lat > 0 ? b.max_query_lat : 1) * sizeof(double));
+  b.readers = calloc(cfg->readers > 0 ? cfg->readers : 1, sizeof(LiveReaderArg));
+  ok = ok && b.query_lat && b.readers && live_init(&b.live, &b.a, threads, cfg->readers) == 0;
+  for (int r = 0; ok && r < cfg->readers; r++) {
+    b.readers[r].b = &b;
+    b.readers[r].id = r;
+    ok = (b.readers[r].lat = malloc(LIVE_SAMPLES * sizeof(double))) != NULL;
+  }
+  if (!ok) {
+    fprintf(stderr, "Rank %d: error allocating the benchmark state\n", b.rank);
+    MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+  // the merge and inner product read populated tables
+  size_t cells = (size_t)cfg->depth * cfg->width;
+  for (int t = 0; t < threads; t++)
+    for (size_t c = 0; c < cells; c++)
+      b.copies[t].table[0][c] = (uint32_t)(c % 7);
+  for (size_t c = 0; c < cells; c++)
+    b.b.table[0][c] = (uint32_t)(c % 5);
+
+  FILE* out = stdout;
+  if (b.rank == 0 && cfg->out && !(out = fopen(cfg->out, "w"))) {
+    perror(cfg->out);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  size_t l1, l2;
+  engine_cache_sizes(&l1, &l2);
+  if (b.rank == 0) {
+    if (cfg->csv) {
+      fprintf(out, "kernel,ranks,threads,depth,width,keys,dist,ops,reps,"
+                   "min_s,median_s,p90_s,p99_s,max_s,mean_s,ns_per_op,mops,"
+                   "queries,query_p50_ns,query_p99_ns,query_max_ns,publishes,publish_mean_us,publish_max_us\n");
+    } else {
+      fprintf(out, "{\n  \"config\": {\"ranks\": %d, \"threads\": %d, \"pinned\": %d, \"depth\": %u, "
+                   "\"width\": %u, \"keys\": %zu, \"universe\": %u, \"dist\": \"%s\", \"skew\": %g, "
+                   "\"warmup\": %d, \"reps\": %d, \"batch\": %zu, \"seed\": %llu, \"l1d_bytes\": %zu, "
+                   "\"l2_bytes\": %zu, \"variant\": \"%s\"},\n  \"results\": [",
+              b.size, threads, pinned, cfg->depth, cfg->width, cfg->keys, cfg->universe,
+              cfg->dist == DIST_ZIPF ? "zipf" : "uniform", cfg->skew, cfg->warmup, cfg->reps,
+              b.engines[0].batch, (unsigned long long)cfg->seed, l1, l2, b.kern->name);
+    }
+  }
+
+  double* times = malloc(cfg->reps * sizeof(double));
+  if (!times) MPI_Abort(MPI_COMM_WORLD, 99);
+  int first = 1;
+  for (int k = 0; k < N_KERNELS; k++) {
+    if (!kernel_selected(cfg, KERNELS[k]))
+      continue;
+
+    uint64_t ops = 0;
+    for (int w = 0; w < cfg->warmup; w++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      kernel_run(&b, k);
+    }
+    b.n_query_lat = 0;
+    b.queries = b.publishes = 0;
+    b.t_publish = b.publish_max = 0;
+    for (int r = 0; r < cfg->reps; r++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      double t0 = MPI_Wtime();
+      ops = kernel_run(&b, k);
+      double elapsed = MPI_Wtime() - t0;
+      // the repetition lasts as long as its slowest rank
+      MPI_Allreduce(&elapsed, &times[r], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+    if (b.rank != 0)
+      continue;
+
+    qsort(times, cfg->reps, sizeof(double), cmp_double);
+    double mean = 0;
+    for (int r = 0; r < cfg->reps; r++)
+      mean += times[r] / cfg->reps;
+    double median = percentile(times, cfg->reps, 0.5);
+    double ns_per_op = median * 1e9 / (double)ops;
+    double mops = median > 0 ? (double)ops / median / 1e6 : 0;
+    const char* dist = cfg->dist == DIST_ZIPF ? "zipf" : "uniform";
+
+    // live_*: query latencies and publish times over the timed passes
+    int nq = (int)b.n_query_lat;
+    qsort(b.query_lat, nq, sizeof(double), cmp_double);
+    double q50 = nq ? percentile(b.query_lat, nq, 0.5) * 1e9 : 0;
+    double q99 = nq ? percentile(b.query_lat, nq, 0.99) * 1e9 : 0;
+    double qmax = nq ? b.query_lat[nq - 1] * 1e9 : 0;
+    double pub_mean = b.publishes ? b.t_publish / b.publishes * 1e6 : 0;
+    char live[256] = "";
+
+    if (k >= LIVE_KERNEL && !cfg->csv)
+      snprintf(live, sizeof(live), ", \"readers\": %d, \"queries\": %llu, \"query_p50_ns\": %.1f, "
+               "\"query_p99_ns\": %.1f, \"query_max_ns\": %.1f, \"publishes\": %llu, "
+               "\"publish_mean_us\": %.3f, \"publish_max_us\": %.3f",
+               k == LIVE_KERNEL ? 0 : cfg->readers, (unsigned long long)b.queries, q50, q99, qmax,
+               (unsigned long long)b.publishes, pub_mean, b.publish_max * 1e6);
+    if (cfg->csv) {
+      if (k >= LIVE_KERNEL)
+        snprintf(live, sizeof(live), "%llu,%.1f,%.1f,%.1f,%llu,%.3f,%.3f", (unsigned long long)b.queries, q50,
+                 q99, qmax, (unsigned long long)b.publishes, pub_mean, b.publish_max * 1e6);
+      else
+        strcpy(live, ",,,,,,");
+      fprintf(out, "%s,%d,%d,%u,%u,%zu,%s,%llu,%d,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e,%.3f,%.3f,%s\n", KERNELS[k],
+              b.size, threads, cfg->depth, cfg->width, cfg->keys, dist, (unsigned long long)ops, cfg->reps,
+              times[0], median, percentile(times, cfg->reps, 0.9), percentile(times, cfg->reps, 0.99),
+              times[cfg->reps - 1], mean, ns_per_op, mops, live);
+    } else {
+      fprintf(out, "%s\n    {\"kernel\": \"%s\", \"ops\": %llu, \"reps\": %d, \"min_s\": %.9e, "
+                   "\"median_s\": %.9e, \"p90_s\": %.9e, \"p99_s\": %.9e, \"max_s\": %.9e, "
+                   "\"mean_s\": %.9e, \"ns_per_op\": %.3f, \"mops\": %.3f%s}",
+              first ? "" : ",", KERNELS[k], (unsigned long long)ops, cfg->reps, times[0], median,
+              percentile(times, cfg->reps, 0.9), percentile(times, cfg->reps, 0.99),
+              times[cfg->reps - 1], mean, ns_per_op, mops, live);
+    }
+    first = 0;
+  }
+  if (b.rank == 0) {
+    if (!cfg->csv) fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+  }
+
+  free(times);
+  live_free(&b.live);
+  for (int r = 0; r < cfg->readers; r++)
+    free(b.readers[r].lat);
+  free(b.readers);
+  free(b.query_lat);
+  for (int s = CMS_STRATEGY_PRIVATE; s <= CMS_STRATEGY_PARTITIONED; s++)
+    engine_free(&b.engines[s]);
+  for (int t = 0; t < threads; t++)
+    cms_free(&b.copies[t]);
+  free(b.copies);
+  free(b.slots);
+  free(b.packed);
+  cms_free(&b.a);
+  cms_free(&b.b);
+  cms_buffer_free(b.keys);
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,393 @@
+#define _GNU_SOURCE
+#include "cms_accuracy.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cms_kernels.h"
+#include "cms_report.h"
+
+#define QUERY_BLOCK 1024  // keys per block of the batched query
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int max_threads(void) {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+static int thread_num(void) {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+static inline int log2_bucket(uint32_t v) {
+  return v ? 32 - __builtin_clz(v) : 0;
+}
+
+// next number starting before end, the digits may run past it; 0 when none is left
+static inline int next_number(const char** p, const char* end, const char* limit, uint32_t* v) {
+  const char* q = *p;
+  while (q < end && (*q < '0' || *q > '9')) q++;
+  if (q >= end)
+    return 0;
+  uint32_t x = 0;
+  while (q < limit && *q >= '0' && *q <= '9') x = x * 10 + (uint32_t)(*q++ - '0');
+  *v = x;
+  *p = q;
+  return 1;
+}
+
+// the lines starting in [lo, hi) of the text belong to one thread
+static const char* line_start(const char* text, size_t size, size_t lo) {
+  const char* p = text + lo;
+  if (lo > 0 && p[-1] != '\n')
+    while (p < text + size && *p != '\n') p++;
+  return p;
+}
+
+// "val count" lines: count the entries of every thread's share, then parse
+// them again into their place
+static RealCount* parse_truth(const char* text, size_t size, size_t* n) {
+  int nt = max_threads();
+  size_t* offsets = calloc(nt + 1, sizeof(size_t));
+  if (!offsets)
+    return NULL;
+  RealCount* truth = NULL;
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nt)
+#endif
+  {
+    int t = thread_num();
+    const char* p = line_start(text, size, size * t / nt);
+    const char* end = text + size * (t + 1) / nt;
+    size_t count = 0;
+    uint32_t v;
+    while (next_number(&p, end, text + size, &v) && next_number(&p, text + size, text + size, &v))
+      count++;
+    offsets[t + 1] = count;
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+    {
+      for (int i = 0; i < nt; i++)
+        offsets[i + 1] += offsets[i];
+      truth = malloc((offsets[nt] > 0 ? offsets[nt] : 1) * sizeof(RealCount));
+    }
+    if (truth) {
+      p = line_start(text, size, size * t / nt);
+      RealCount* out = truth + offsets[t];
+      for (size_t i = 0; i < count; i++) {
+        next_number(&p, end, text + size, &out[i].val);
+        next_number(&p, text + size, text + size, &out[i].count);
+      }
+    }
+  }
+  *n = offsets[nt];
+  free(offsets);
+  return truth;
+}
+
+RealCount* accuracy_load_truth(const char* path, size_t* n) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  RealCount* truth;
+  const char* ext = strrchr(path, '.');
+  if (ext && strcmp(ext, ".bin") == 0) {
+    *n = size / sizeof(RealCount);
+    truth = malloc((*n > 0 ? *n : 1) * sizeof(RealCount));
+    if (truth)
+      memcpy(truth, map, *n * sizeof(RealCount));
+  } else {
+    truth = parse_truth(map, size, n);
+  }
+  munmap(map, size);
+  return truth;
+}
+
+void cms_point_query_batch(const CountMinSketch* cms, const uint32_t* keys, size_t n, uint32_t* out) {
+  size_t n_blocks = (n + QUERY_BLOCK - 1) / QUERY_BLOCK;
+  const CmsKernels* kern = cms_kernels_select(cms);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t b = 0; b < n_blocks; b++) {
+    size_t lo = b * QUERY_BLOCK;
+    size_t hi = lo + QUERY_BLOCK < n ? lo + QUERY_BLOCK : n;
+    kern->query_batch(cms, keys + lo, hi - lo, out + lo);
+  }
+}
+
+// value of rank k (0-based) of the n values: radix select on the high 16 bits,
+// then on the low 16 bits of the values in the chosen high bucket
+static uint32_t select_rank(const uint32_t* values, size_t n, size_t k, uint64_t* hist) {
+  uint32_t prefix = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    memset(hist, 0, 65536 * sizeof(uint64_t));
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+      uint64_t* mine = calloc(65536, sizeof(uint64_t));
+      uint64_t* h = mine ? mine : hist;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (size_t i = 0; i < n; i++) {
+        uint32_t v = values[i];
+        if (pass == 1 && (v >> 16) != prefix)
+          continue;
+        uint32_t digit = pass == 0 ? v >> 16 : v & 0xFFFF;
+        if (mine)
+          h[digit]++;
+        else
+          __atomic_fetch_add(&h[digit], 1, __ATOMIC_RELAXED);
+      }
+      if (mine) {
+        for (int d = 0; d < 65536; d++)
+          if (mine[d])
+            __atomic_fetch_add(&hist[d], mine[d], __ATOMIC_RELAXED);
+        free(mine);
+      }
+    }
+    uint32_t digit = 0;
+    while (k >= hist[digit]) k -= hist[digit++];
+    prefix = pass == 0 ? digit : (prefix << 16) | digit;
+  }
+  return prefix;
+}
+
+// nearest rank: the smallest error with at least a share p of the keys at or below it
+static uint32_t percentile(const uint32_t* values, size_t n, double p, uint64_t* hist) {
+  size_t k = (size_t)ceil(p * n);
+  return select_rank(values, n, k > 0 ? k - 1 : 0, hist);
+}
+
+int accuracy_evaluate(const RealCount* truth, const uint32_t* estimates, size_t n, double epsilon,
+                      AccuracyStats* st) {
+  double t_start = now_sec();
+  memset(st, 0, sizeof(*st));
+  st->keys = n;
+  uint32_t* errors = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+  uint64_t* hist = malloc(65536 * sizeof(uint64_t));
+  if (!errors || !hist) {
+    free(errors);
+    free(hist);
+    return -1;
+  }
+
+  uint64_t items = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : items)
+#endif
+  for (size_t i = 0; i < n; i++)
+    items += truth[i].count;
+  st->items = items;
+  st->bound = epsilon * items;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    AccuracyStats mine;
+    memset(&mine, 0, sizeof(mine));
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (size_t i = 0; i < n; i++) {
+      uint32_t count = truth[i].count, est = estimates[i];
+      uint32_t err = est > count ? est - count : 0;
+      errors[i] = err;
+      double rel = count > 0 ? (double)err / count : 0.0;
+      int over = err > st->bound;
+      mine.under += est < count;
+      mine.exact += est == count;
+      mine.within_bound += !over;
+      mine.sum_abs += err;
+      mine.sum_rel += rel;
+      if (err > mine.max_abs) mine.max_abs = err;
+      mine.error_hist[log2_bucket(err)]++;
+      AccuracyBucket* b = &mine.by_count[log2_bucket(count)];
+      b->keys++;
+      b->sum_abs += err;
+      b->sum_rel += rel;
+      if (rel > b->max_rel) b->max_rel = rel;
+      b->violations += over;
+    }
+#ifdef _OPENMP
+#pragma omp critical(accuracy_stats)
+#endif
+    {
+      st->under += mine.under;
+      st->exact += mine.exact;
+      st->within_bound += mine.within_bound;
+      st->sum_abs += mine.sum_abs;
+      st->sum_rel += mine.sum_rel;
+      if (mine.max_abs > st->max_abs) st->max_abs = mine.max_abs;
+      for (int k = 0; k < ACCURACY_BUCKETS; k++) {
+        AccuracyBucket* b = &st->by_count[k];
+        st->error_hist[k] += mine.error_hist[k];
+        b->keys += mine.by_count[k].keys;
+        b->sum_abs += mine.by_count[k].sum_abs;
+        b->sum_rel += mine.by_count[k].sum_rel;
+        b->violations += mine.by_count[k].violations;
+        if (mine.by_count[k].max_rel > b->max_rel) b->max_rel = mine.by_count[k].max_rel;
+      }
+    }
+  }
+
+  if (n > 0) {
+    st->p50 = percentile(errors, n, 0.5, hist);
+    st->p90 = percentile(errors, n, 0.9, hist);
+    st->p99 = percentile(errors, n, 0.99, hist);
+    st->p999 = percentile(errors, n, 0.999, hist);
+  }
+  free(errors);
+  free(hist);
+  st->t_stats = now_sec() - t_start;
+  return 0;
+}
+
+void accuracy_print(const AccuracyStats* st) {
+  double n = st->keys > 0 ? (double)st->keys : 1.0;
+  printf("\n--- ACCURACY ---\n");
+  printf("Keys: %llu, items: %llu, error bound epsilon*N: %.0f\n", (unsigned long long)st->keys,
+         (unsigned long long)st->items, st->bound);
+  printf("Avg absolute error: %.2f, max: %u\n", st->sum_abs / n, st->max_abs);
+  printf("Absolute error p50/p90/p99/p99.9: %u/%u/%u/%u\n", st->p50, st->p90, st->p99, st->p999);
+  printf("Avg relative error: %.4f\n", st->sum_rel / n);
+  printf("Exact matches: %llu (%.2f%%)\n", (unsigned long long)st->exact, 100.0 * st->exact / n);
+  printf("Within error bound: %llu (%.2f%%), violation rate %.6f\n", (unsigned long long)st->within_bound,
+         100.0 * st->within_bound / n, (st->keys - st->within_bound) / n);
+  if (st->under > 0)
+    printf("Implementation error: %llu estimates below the true count\n", (unsigned long long)st->under);
+  printf("Evaluation time: load %f s, query %f s, statistics %f s\n", st->t_load, st->t_query, st->t_stats);
+}
+
+int accuracy_write(const AccuracyStats* st, const CountMinSketch* cms, const char* driver, const char* truth,
+                   const char* path) {
+  int to_stdout = strcmp(path, "-") == 0;
+  FILE* f = to_stdout ? stdout : fopen(path, "a");
+  if (!f)
+    return -1;
+  double n = st->keys > 0 ? (double)st->keys : 1.0;
+
+  fprintf(f, "{\"driver\":");
+  report_write_string(f, driver);
+  fprintf(f, ",\"truth\":");
+  report_write_string(f, truth);
+  fprintf(f, ",\"epsilon\":%g,\"delta\":%g,\"width\":%u,\"depth\":%u", cms->epsilon, cms->delta, cms->width,
+          cms->depth);
+  fprintf(f, ",\"keys\":%llu,\"items\":%llu,\"bound\":%.1f", (unsigned long long)st->keys,
+          (unsigned long long)st->items, st->bound);
+  fprintf(f, ",\"exact\":%.6f,\"within_bound\":%.6f,\"violation_rate\":%.6f,\"under\":%llu", st->exact / n,
+          st->within_bound / n, (st->keys - st->within_bound) / n, (unsigned long long)st->under);
+  fprintf(f, ",\"abs_error\":{\"mean\":%.4f,\"max\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u}",
+          st->sum_abs / n, st->max_abs, st->p50, st->p90, st->p99, st->p999);
+  fprintf(f, ",\"rel_error\":{\"mean\":%.6f}", st->sum_rel / n);
+
+  // [lo, hi] ranges of the non-empty log2 buckets
+  fprintf(f, ",\"error_hist\":[");
+  const char* sep = "";
+  for (int k = 0; k < ACCURACY_BUCKETS; k++) {
+    if (st->error_hist[k] == 0)
+      continue;
+    uint32_t lo = k ? 1u << (k - 1) : 0, hi = k ? (uint32_t)((2ull << (k - 1)) - 1) : 0;
+    fprintf(f, "%s{\"lo\":%u,\"hi\":%u,\"keys\":%llu}", sep, lo, hi, (unsigned long long)st->error_hist[k]);
+    sep = ",";
+  }
+  fprintf(f, "],\"by_count\":[");
+  sep = "";
+  for (int k = 0; k < ACCURACY_BUCKETS; k++) {
+    const AccuracyBucket* b = &st->by_count[k];
+    if (b->keys == 0)
+      continue;
+    uint32_t lo = k ? 1u << (k - 1) : 0, hi = k ? (uint32_t)((2ull << (k - 1)) - 1) : 0;
+    fprintf(f,
+            "%s{\"lo\":%u,\"hi\":%u,\"keys\":%llu,\"mean_abs\":%.4f,\"mean_rel\":%.6f,\"max_rel\":%.6f,"
+            "\"violation_rate\":%.6f}",
+            sep, lo, hi, (unsigned long long)b->keys, (double)b->sum_abs / b->keys, b->sum_rel / b->keys,
+            b->max_rel, (double)b->violations / b->keys);
+    sep = ",";
+  }
+  fprintf(f, "],\"time\":{\"load\":%.6f,\"query\":%.6f,\"stats\":%.6f}}\n", st->t_load, st->t_query,
+          st->t_stats);
+
+  if (to_stdout)
+    return fflush(f) == 0 ? 0 : -1;
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+int accuracy_run(const CountMinSketch* cms, const char* truth, const char* driver, const char* path) {
+  double t0 = now_sec();
+  size_t n = 0;
+  RealCount* entries = accuracy_load_truth(truth, &n);
+  if (!entries) {
+    fprintf(stderr, "Error: cannot load the ground truth file %s\n", truth);
+    return -1;
+  }
+  double t1 = now_sec();
+
+  uint32_t* keys = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+  uint32_t* estimates = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+  AccuracyStats st;
+  int status = -1;
+  if (keys && estimates) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = 0; i < n; i++)
+      keys[i] = entries[i].val;
+    cms_point_query_batch(cms, keys, n, estimates);
+    double t2 = now_sec();
+    status = accuracy_evaluate(entries, estimates, n, cms->epsilon, &st);
+    st.t_load = t1 - t0;
+    st.t_query = t2 - t1;
+  }
+  if (status == 0) {
+    accuracy_print(&st);
+    if (path && accuracy_write(&st, cms, driver, truth, path) != 0) {
+      fprintf(stderr, "Error writing the accuracy record to %s\n", path);
+      status = -1;
+    }
+  } else {
+    fprintf(stderr, "Error allocating the accuracy evaluation\n");
+  }
+  free(entries);
+  free(keys);
+  free(estimates);
+  return status;
+}
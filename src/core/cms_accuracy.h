@@ -0,0 +1,65 @@
+#ifndef CMS_ACCURACY_H
+#define CMS_ACCURACY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cms_types.h"
+
+// Accuracy evaluation against the exact counts (--accuracy=TRUTH).
+// The ground truth is the total_<dataset> file of cms_count: "val count" lines,
+// parsed in parallel, or RealCount records in a .bin file. Every key is queried
+// through cms_point_query_batch and the errors are summarised in parallel:
+// histogram of the absolute error, exact percentiles, relative error by true
+// count and the share of keys above the epsilon*N bound, where N is the sum of
+// the true counts. accuracy_write appends the result as one JSON line, so runs
+// over epsilon, delta and thread counts can be compared side by side.
+
+#define ACCURACY_BUCKETS 33  // log2 buckets of a uint32: 0, 1, 2-3, 4-7, ..., 2^31-(2^32-1)
+
+typedef struct {
+  uint64_t keys;
+  uint64_t sum_abs;
+  double sum_rel;
+  double max_rel;
+  uint64_t violations;  // keys above the bound
+} AccuracyBucket;
+
+typedef struct {
+  uint64_t keys;          // ground-truth entries
+  uint64_t items;         // sum of the true counts
+  double bound;           // epsilon * items
+  uint64_t exact;         // estimate == true count
+  uint64_t within_bound;  // absolute error <= bound
+  uint64_t under;         // estimate < true count, never for a correct sketch
+  uint64_t sum_abs;
+  uint32_t max_abs;
+  double sum_rel;         // absolute error / true count
+  uint32_t p50, p90, p99, p999;
+  uint64_t error_hist[ACCURACY_BUCKETS];       // keys by absolute error
+  AccuracyBucket by_count[ACCURACY_BUCKETS];   // keys by true count
+  double t_load, t_query, t_stats;             // seconds
+} AccuracyStats;
+
+// load the ground truth (RealCount records for .bin, text otherwise), NULL on error
+RealCount* accuracy_load_truth(const char* path, size_t* n);
+
+// min over the rows for each of the n keys, with the kernels of the shape of cms
+// (cms_kernels.h) over blocks of keys shared between the threads
+void cms_point_query_batch(const CountMinSketch* cms, const uint32_t* keys, size_t n, uint32_t* out);
+
+// statistics of the estimates of the n truth entries, returns 0 on success
+int accuracy_evaluate(const RealCount* truth, const uint32_t* estimates, size_t n, double epsilon,
+                      AccuracyStats* st);
+
+// print a summary to stdout
+void accuracy_print(const AccuracyStats* st);
+
+// append one JSON line to path ("-" = stdout), returns 0 on success
+int accuracy_write(const AccuracyStats* st, const CountMinSketch* cms, const char* driver, const char* truth,
+                   const char* path);
+
+// load, query, evaluate, print and write, for a sketch holding the full table
+int accuracy_run(const CountMinSketch* cms, const char* truth, const char* driver, const char* path);
+
+#endif  // CMS_ACCURACY_H
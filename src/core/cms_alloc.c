@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+#include "cms_alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define PAGE_2M ((size_t)2 << 20)
+#define PAGE_1G ((size_t)1 << 30)
+#define MAX_MAPPINGS 256
+
+// mmap'ed buffers, everything else came from malloc
+typedef struct {
+  void* addr;
+  size_t length;
+  size_t page_size;
+  const char* backing;
+} Mapping;
+
+static Mapping mappings[MAX_MAPPINGS];
+static int huge_pages = 0;
+
+void cms_alloc_use_huge_pages(int enable) {
+  huge_pages = enable;
+}
+
+static size_t round_up(size_t bytes, size_t page) {
+  return (bytes + page - 1) / page * page;
+}
+
+static int thp_enabled(void) {
+  char mode[128] = "";
+  FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (!f)
+    return 0;
+  if (!fgets(mode, sizeof(mode), f))
+    mode[0] = '\0';
+  fclose(f);
+  return strstr(mode, "[never]") == NULL && mode[0] != '\0';
+}
+
+static void* map_huge(size_t bytes, Mapping* m) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  if (bytes >= PAGE_1G) {
+    m->length = round_up(bytes, PAGE_1G);
+    m->addr = mmap(NULL, m->length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    if (m->addr != MAP_FAILED) {
+      m->page_size = PAGE_1G;
+      m->backing = "hugetlb";
+      return m->addr;
+    }
+  }
+
+  m->length = round_up(bytes, PAGE_2M);
+  m->addr = mmap(NULL, m->length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+  if (m->addr != MAP_FAILED) {
+    m->page_size = PAGE_2M;
+    m->backing = "hugetlb";
+    return m->addr;
+  }
+
+  // no reserved huge pages: ask for transparent ones on a 2 MB aligned range
+  if (!thp_enabled())
+    return NULL;
+  size_t span = m->length + PAGE_2M;
+  char* raw = mmap(NULL, span, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (raw == MAP_FAILED)
+    return NULL;
+  char* aligned = (char*)round_up((size_t)raw, PAGE_2M);
+  if (aligned > raw)
+    munmap(raw, aligned - raw);
+  if (aligned + m->length < raw + span)
+    munmap(aligned + m->length, raw + span - (aligned + m->length));
+  if (madvise(aligned, m->length, MADV_HUGEPAGE) != 0) {
+    munmap(aligned, m->length);
+    return NULL;
+  }
+  m->addr = aligned;
+  m->page_size = PAGE_2M;
+  m->backing = "thp";
+  return aligned;
+}
+
+void* cms_buffer_alloc(size_t bytes) {
+  if (huge_pages && bytes >= HUGE_MIN_BYTES) {
+    Mapping m;
+    if (map_huge(bytes, &m)) {
+      int stored = 0;
+#ifdef _OPENMP
+#pragma omp critical(cms_alloc)
+#endif
+      for (int i = 0; i < MAX_MAPPINGS && !stored; i++) {
+        if (!mappings[i].addr) {
+          mappings[i] = m;
+          stored = 1;
+        }
+      }
+      if (stored)
+        return m.addr;
+      munmap(m.addr, m.length);  // registry full
+    }
+  }
+  return calloc(bytes > 0 ? bytes : 1, 1);
+}
+
+// registry slot of p, -1 if it is not mmap'ed
+static int find_mapping(const void* p) {
+  int found = -1;
+#ifdef _OPENMP
+#pragma omp critical(cms_alloc)
+#endif
+  for (int i = 0; i < MAX_MAPPINGS && found < 0; i++)
+    if (p && mappings[i].addr == p)
+      found = i;
+  return found;
+}
+
+void cms_buffer_free(void* p) {
+  int i = find_mapping(p);
+  if (i < 0) {
+    free(p);
+    return;
+  }
+  munmap(mappings[i].addr, mappings[i].length);
+#ifdef _OPENMP
+#pragma omp critical(cms_alloc)
+#endif
+  mappings[i].addr = NULL;
+}
+
+// kB of AnonHugePages in the mappings of /proc/self/smaps overlapping [addr, addr + length),
+// -1 if the file cannot be read
+static long anon_huge_kb(const void* addr, size_t length) {
+  FILE* f = fopen("/proc/self/smaps", "r");
+  if (!f)
+    return -1;
+  unsigned long lo = (unsigned long)addr, hi = lo + length;
+  unsigned long start, end;
+  long kb, total = 0;
+  int inside = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+      inside = start < hi && end > lo;
+    else if (inside && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+      total += kb;
+  }
+  fclose(f);
+  return total;
+}
+
+// madvise is only a request: the range counts as thp once the kernel backs part of it with
+// huge pages, which it does at the first touch
+static int thp_backed(const Mapping* m) {
+  return strcmp(m->backing, "thp") != 0 || anon_huge_kb(m->addr, m->length) > 0;
+}
+
+size_t cms_buffer_page_size(const void* p) {
+  int i = find_mapping(p);
+  return i < 0 || !thp_backed(&mappings[i]) ? (size_t)sysconf(_SC_PAGESIZE) : mappings[i].page_size;
+}
+
+const char* cms_buffer_backing(const void* p) {
+  int i = find_mapping(p);
+  if (i < 0)
+    return "malloc";
+  return thp_backed(&mappings[i]) ? mappings[i].backing : "thp-requested";
+}
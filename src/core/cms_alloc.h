@@ -0,0 +1,30 @@
+#ifndef CMS_ALLOC_H
+#define CMS_ALLOC_H
+
+#include <stddef.h>
+
+// Allocation of the large buffers: sketch tables and input arrays.
+// With huge pages enabled, buffers of at least HUGE_MIN_BYTES are mapped with
+// MAP_HUGETLB (1 GB pages when the buffer is that large, then 2 MB), falling back
+// to transparent huge pages (madvise(MADV_HUGEPAGE)) and finally to calloc.
+// Random sketch updates then hit far fewer TLB entries.
+
+#define HUGE_MIN_BYTES (1u << 20)
+
+// process-wide switch, off by default
+void cms_alloc_use_huge_pages(int enable);
+
+// zeroed buffer, NULL on failure
+void* cms_buffer_alloc(size_t bytes);
+
+// releases buffers from cms_buffer_alloc and plain malloc alike
+void cms_buffer_free(void* p);
+
+// page size backing p (the base page size for malloc'd memory), call it after the first
+// touch: transparent huge pages are checked in /proc/self/smaps
+size_t cms_buffer_page_size(const void* p);
+
+// "hugetlb", "thp", "thp-requested" (madvise'd, no huge page seen in the range) or "malloc"
+const char* cms_buffer_backing(const void* p);
+
+#endif  // CMS_ALLOC_H
@@ -0,0 +1,177 @@
+#include "cms_checkpoint.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char MAGIC[8] = {'C', 'M', 'S', 'C', 'K', 'P', 'T', '2'};
+
+typedef struct {
+  char magic[8];
+  uint32_t ranks;
+  uint32_t depth;
+  uint32_t width;
+  uint32_t n_meta;
+  uint32_t mode;
+  uint32_t pad;
+  uint64_t input_size;
+} CheckpointHeader;
+
+static MPI_Offset header_bytes(uint32_t depth) {
+  MPI_Offset bytes = sizeof(CheckpointHeader) + (MPI_Offset)depth * sizeof(UniversalHash);
+  return (bytes + 7) & ~(MPI_Offset)7;
+}
+
+// position, total, meta, table: the same size on every rank
+static MPI_Offset record_bytes(const CountMinSketch* cms, int n_meta) {
+  MPI_Offset bytes = sizeof(CheckpointPosition) + (1 + (MPI_Offset)n_meta) * sizeof(uint32_t) +
+                     (MPI_Offset)cms->depth * cms->width * sizeof(uint32_t);
+  return (bytes + 7) & ~(MPI_Offset)7;
+}
+
+// MPI counts are int: the table goes in INT_MAX sized pieces, the same number on every rank
+static void write_all(MPI_File fh, MPI_Offset offset, const void* buf, MPI_Offset bytes) {
+  for (MPI_Offset done = 0; done < bytes; done += INT_MAX) {
+    int n = (bytes - done) > INT_MAX ? INT_MAX : (int)(bytes - done);
+    MPI_File_write_at_all(fh, offset + done, (const char*)buf + done, n, MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+}
+
+static void read_all(MPI_File fh, MPI_Offset offset, void* buf, MPI_Offset bytes) {
+  for (MPI_Offset done = 0; done < bytes; done += INT_MAX) {
+    int n = (bytes - done) > INT_MAX ? INT_MAX : (int)(bytes - done);
+    MPI_File_read_at_all(fh, offset + done, (char*)buf + done, n, MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+}
+
+uint64_t checkpoint_segments(uint64_t items_left, uint64_t runs_left, uint64_t every, MPI_Comm comm) {
+  uint64_t left = items_left > runs_left ? items_left : runs_left;
+  uint64_t segs = left > 0 ? (left + every - 1) / every : 1;
+  MPI_Allreduce(MPI_IN_PLACE, &segs, 1, MPI_UINT64_T, MPI_MAX, comm);
+  return segs;
+}
+
+uint64_t checkpoint_offset(const uint64_t* marks, uint64_t every, uint64_t done, uint64_t n, uint64_t end) {
+  return done < n ? marks[done / every] : end;
+}
+
+int checkpoint_write(const char* path, const CountMinSketch* local, const uint32_t* meta, int n_meta, int mode,
+                     const CheckpointPosition* pos, uint64_t input_size, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  MPI_File fh;
+  if (MPI_File_open(comm, tmp_path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    return -1;
+  MPI_File_set_size(fh, 0);  // leftovers of an interrupted write
+
+  // the small fields of the record, the table follows from its own buffer
+  size_t head_len = sizeof(CheckpointPosition) + (1 + n_meta) * sizeof(uint32_t);
+  char* head = malloc(head_len);
+  int ok = head != NULL;
+  MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+  if (!ok) {
+    free(head);
+    MPI_File_close(&fh);
+    return -1;
+  }
+  uint32_t total = local->total;
+  memcpy(head, pos, sizeof(CheckpointPosition));
+  memcpy(head + sizeof(CheckpointPosition), &total, sizeof(uint32_t));
+  memcpy(head + sizeof(CheckpointPosition) + sizeof(uint32_t), meta, n_meta * sizeof(uint32_t));
+
+  MPI_Offset record = header_bytes(local->depth) + (MPI_Offset)rank * record_bytes(local, n_meta);
+  write_all(fh, record, head, head_len);
+  write_all(fh, record + head_len, local->table[0], (MPI_Offset)local->depth * local->width * sizeof(uint32_t));
+  free(head);
+
+  if (rank == 0) {
+    CheckpointHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.ranks = size;
+    h.depth = local->depth;
+    h.width = local->width;
+    h.n_meta = n_meta;
+    h.mode = mode;
+    h.input_size = input_size;
+    MPI_File_write_at(fh, 0, &h, sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at(fh, sizeof(h), local->hashFunctions, local->depth * sizeof(UniversalHash), MPI_BYTE,
+                      MPI_STATUS_IGNORE);
+  }
+  MPI_File_sync(fh);
+  MPI_File_close(&fh);
+
+  // every record is on disk: publish the checkpoint atomically
+  int status = 0;
+  if (rank == 0 && rename(tmp_path, path) != 0)
+    status = -1;
+  MPI_Bcast(&status, 1, MPI_INT, 0, comm);
+  return status;
+}
+
+int checkpoint_read(const char* path, CountMinSketch* local, uint32_t* meta, int n_meta, int mode,
+                    CheckpointPosition* pos, uint64_t input_size, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  MPI_File fh;
+  if (MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    return 1;
+
+  // rank 0 checks that the checkpoint belongs to this configuration
+  int status = 0;
+  if (rank == 0) {
+    CheckpointHeader h;
+    MPI_Status st;
+    int got = 0;
+    MPI_File_read_at(fh, 0, &h, sizeof(h), MPI_BYTE, &st);
+    MPI_Get_count(&st, MPI_BYTE, &got);
+    if (got != (int)sizeof(h) || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.ranks != (uint32_t)size ||
+        h.depth != local->depth || h.width != local->width || h.n_meta != (uint32_t)n_meta ||
+        h.mode != (uint32_t)mode || h.input_size != input_size)
+      status = -1;
+    else
+      MPI_File_read_at(fh, sizeof(h), local->hashFunctions, local->depth * sizeof(UniversalHash), MPI_BYTE,
+                       MPI_STATUS_IGNORE);
+  }
+  MPI_Bcast(&status, 1, MPI_INT, 0, comm);
+  if (status != 0) {
+    MPI_File_close(&fh);
+    return status;
+  }
+  MPI_Bcast(local->hashFunctions, local->depth * sizeof(UniversalHash), MPI_BYTE, 0, comm);
+
+  size_t head_len = sizeof(CheckpointPosition) + (1 + n_meta) * sizeof(uint32_t);
+  char* head = malloc(head_len);
+  int ok = head != NULL;
+  MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+  if (!ok) {
+    free(head);
+    MPI_File_close(&fh);
+    return -1;
+  }
+  MPI_Offset record = header_bytes(local->depth) + (MPI_Offset)rank * record_bytes(local, n_meta);
+  read_all(fh, record, head, head_len);
+  read_all(fh, record + head_len, local->table[0], (MPI_Offset)local->depth * local->width * sizeof(uint32_t));
+  MPI_File_close(&fh);
+
+  uint32_t total;
+  memcpy(pos, head, sizeof(CheckpointPosition));
+  memcpy(&total, head + sizeof(CheckpointPosition), sizeof(uint32_t));
+  memcpy(meta, head + sizeof(CheckpointPosition) + sizeof(uint32_t), n_meta * sizeof(uint32_t));
+  local->total = total;
+  free(head);
+
+  // the range left must lie in the input, and only the counter of the mode can have moved
+  ok = pos->next <= pos->end && pos->end <= input_size &&
+       (mode == CHECKPOINT_RUNS ? pos->done_items == 0 : pos->done_runs == 0);
+  MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,54 @@
+#ifndef CMS_CHECKPOINT_H
+#define CMS_CHECKPOINT_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// Checkpoint/restart of a partially ingested run.
+// The drivers update their sketch in segments of the local input; after each
+// segment every rank writes its local sketch, a few counters and how far into
+// its input it got, collectively to one file through MPI-IO. The file is
+// written as path.tmp and renamed once complete, so path always holds the last
+// consistent checkpoint. A restarted job with the same ranks and input reloads
+// it and reads only the rest of each input range: every record holds the byte
+// offset of the first input not yet in the sketch and the end of the range, so
+// a restart neither re-reads nor re-parses what is already counted.
+//
+// layout: header (magic, ranks, depth, width, n_meta, mode, input size, hashes)
+// then one fixed-size record per rank (position, total, meta, table)
+
+// how the input was ingested: a checkpoint only resumes in the same mode, the
+// offsets of runs are not valid for items and the counts would not add up
+#define CHECKPOINT_ITEMS 0
+#define CHECKPOINT_RUNS 1  // --runs or a .rle input
+
+// where a rank stands in its input
+typedef struct {
+  uint64_t done_items;  // items and runs in the sketch since the start of the job
+  uint64_t done_runs;
+  uint64_t next;        // byte offset of the first input not in the sketch
+  uint64_t end;         // end of the rank's range, exclusive
+} CheckpointPosition;
+
+// collective over comm: segments of every items (and every runs) needed by the rank with the
+// most input left, every rank updates in that many segments so that they checkpoint together
+uint64_t checkpoint_segments(uint64_t items_left, uint64_t runs_left, uint64_t every, MPI_Comm comm);
+
+// offset of entry done out of the n of a rank: marks[k] is the offset of entry k * every,
+// end once all of them are in the sketch
+uint64_t checkpoint_offset(const uint64_t* marks, uint64_t every, uint64_t done, uint64_t n, uint64_t end);
+
+// collective over comm: write local, the n_meta counters and the position of every rank,
+// mode and input_size identify the ingestion. Returns 0 on success
+int checkpoint_write(const char* path, const CountMinSketch* local, const uint32_t* meta, int n_meta, int mode,
+                     const CheckpointPosition* pos, uint64_t input_size, MPI_Comm comm);
+
+// collective over comm: restore the sketch (hashes included), the counters and the position
+// returns 0 on success, 1 if there is no checkpoint, -1 if it belongs to another configuration
+// (ranks, shape, mode or input) or holds a position outside the input
+int checkpoint_read(const char* path, CountMinSketch* local, uint32_t* meta, int n_meta, int mode,
+                    CheckpointPosition* pos, uint64_t input_size, MPI_Comm comm);
+
+#endif  // CMS_CHECKPOINT_H
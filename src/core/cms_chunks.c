@@ -0,0 +1,230 @@
+#include "cms_chunks.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cms_trace.h"
+
+// bytes read past the end of a chunk to find the end of its last line, doubled as needed
+#define LINE_TAIL 256
+
+int chunk_queue_init(ChunkQueue* q, MPI_File fh, MPI_Offset chunk_bytes, int rle, MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  memset(q, 0, sizeof(*q));
+  q->fh = fh;
+  q->rle = rle;
+  MPI_File_get_size(fh, &q->file_size);
+  if (rle) {
+    q->file_size -= q->file_size % sizeof(ItemRun);
+    chunk_bytes -= chunk_bytes % sizeof(ItemRun);
+    if (chunk_bytes == 0) chunk_bytes = sizeof(ItemRun);
+  }
+  if (chunk_bytes <= 0)
+    return -1;
+  q->chunk_bytes = chunk_bytes;
+  q->n_chunks = (uint64_t)((q->file_size + chunk_bytes - 1) / chunk_bytes);
+
+  MPI_Aint win_bytes = rank == 0 ? sizeof(uint64_t) : 0;
+  if (MPI_Win_allocate(win_bytes, sizeof(uint64_t), MPI_INFO_NULL, comm, &q->counter, &q->win) != MPI_SUCCESS)
+    return -1;
+  if (rank == 0) *q->counter = 0;
+  MPI_Barrier(comm);  // the counter is zero before anyone claims
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, q->win);
+
+  q->t_start = MPI_Wtime();
+  return 0;
+}
+
+// read [lo, hi) of the file into the reusable buffer, with room for a terminating NUL
+static int read_range(ChunkQueue* q, MPI_Offset lo, MPI_Offset hi) {
+  size_t bytes = (size_t)(hi - lo);
+  if (bytes + 1 > q->buf_cap) {
+    char* tmp = realloc(q->buf, bytes + 1);
+    if (!tmp)
+      return -1;
+    q->buf = tmp;
+    q->buf_cap = bytes + 1;
+  }
+  for (size_t done = 0; done < bytes; done += INT_MAX) {
+    int n = (bytes - done) > INT_MAX ? INT_MAX : (int)(bytes - done);
+    MPI_File_read_at(q->fh, lo + done, q->buf + done, n, MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+  return 0;
+}
+
+int chunk_queue_next(ChunkQueue* q, char** data, size_t* len) {
+  const uint64_t one = 1;
+  uint64_t claim;
+  MPI_Fetch_and_op(&one, &claim, MPI_UINT64_T, 0, 0, MPI_SUM, q->win);
+  MPI_Win_flush(0, q->win);
+  if (claim >= q->n_chunks) {
+    q->busy = MPI_Wtime() - q->t_start;
+    return 0;
+  }
+  q->claimed++;
+
+  MPI_Offset start = (MPI_Offset)claim * q->chunk_bytes;
+  MPI_Offset end = start + q->chunk_bytes < q->file_size ? start + q->chunk_bytes : q->file_size;
+  q->bytes += (uint64_t)(end - start);
+
+  if (q->rle) {
+    if (read_range(q, start, end) != 0)
+      return -1;
+    *data = q->buf;
+    *len = (size_t)(end - start);
+    return 1;
+  }
+
+  // the byte before the chunk tells whether its first line starts in the previous one,
+  // the tail past the end holds the rest of its last line
+  MPI_Offset lo = start > 0 ? start - 1 : 0;
+  MPI_Offset tail = LINE_TAIL;
+  size_t stop;
+  for (;;) {
+    MPI_Offset hi = end + tail < q->file_size ? end + tail : q->file_size;
+    if (read_range(q, lo, hi) != 0)
+      return -1;
+    // the last line starting in the chunk ends at the first newline from end - 1 on
+    size_t from = (size_t)(end - 1 - lo);
+    char* nl = memchr(q->buf + from, '\n', (size_t)(hi - lo) - from);
+    if (nl || hi == q->file_size) {
+      stop = nl ? (size_t)(nl - q->buf) + 1 : (size_t)(hi - lo);
+      break;
+    }
+    tail *= 2;
+  }
+
+  size_t begin = 0;
+  if (start > 0) {
+    char* nl = memchr(q->buf, '\n', stop);
+    begin = nl ? (size_t)(nl - q->buf) + 1 : stop;
+  }
+  q->buf[stop] = '\0';
+  *data = q->buf + begin;
+  *len = stop - begin;
+  return 1;
+}
+
+// make room for extra more elements of size elem in arr holding n of *cap
+// returns the (possibly moved) array, NULL if out of memory
+static void* grow(void* arr, size_t* cap, size_t n, size_t extra, size_t elem) {
+  if (arr && n + extra <= *cap)
+    return arr;
+  size_t new_cap = *cap ? *cap : 1024;
+  while (new_cap < n + extra) new_cap *= 2;
+  void* tmp = realloc(arr, new_cap * elem);
+  if (tmp)
+    *cap = new_cap;
+  return tmp;
+}
+
+int chunk_read_all(ChunkQueue* q, int as_runs, uint32_t** items, size_t* n_items,
+                   ItemRun** runs, size_t* n_runs) {
+  size_t items_cap = *n_items;
+  size_t runs_cap = *n_runs;
+  char* data;
+  size_t len;
+  int status;
+
+  for (;;) {
+    trace_begin(TRACE_READ);
+    status = chunk_queue_next(q, &data, &len);
+    trace_end(TRACE_READ);
+    if (status <= 0)
+      break;
+
+    trace_begin(TRACE_PARSE);
+    if (q->rle) {
+      size_t n = len / sizeof(ItemRun);
+      ItemRun* tmp = grow(*runs, &runs_cap, *n_runs, n, sizeof(ItemRun));
+      if (!tmp)
+        return -1;
+      *runs = tmp;
+      memcpy(*runs + *n_runs, data, n * sizeof(ItemRun));
+      *n_runs += n;
+    } else if (as_runs) {
+      size_t n;
+      ItemRun* chunk_runs = parse_runs(data, &n);
+      ItemRun* tmp = chunk_runs ? grow(*runs, &runs_cap, *n_runs, n, sizeof(ItemRun)) : NULL;
+      if (!tmp) {
+        free(chunk_runs);
+        return -1;
+      }
+      *runs = tmp;
+      memcpy(*runs + *n_runs, chunk_runs, n * sizeof(ItemRun));
+      *n_runs += n;
+      free(chunk_runs);
+    } else {
+      size_t lines = 0;
+      for (size_t i = 0; i < len; i++)
+        if (data[i] == '\n') lines++;
+      // the last line of the file may have no newline
+      uint32_t* tmp = grow(*items, &items_cap, *n_items, lines + 1, sizeof(uint32_t));
+      if (!tmp)
+        return -1;
+      *items = tmp;
+      const char* p = data;
+      while (*p) {
+        char* next;
+        uint32_t key = (uint32_t)strtoul(p, &next, 10);
+        if (next == p) {  // blank line or trailing whitespace
+          p++;
+          continue;
+        }
+        // a line can hold more than one key
+        if (*n_items == items_cap) {
+          if (!(tmp = grow(*items, &items_cap, *n_items, 1, sizeof(uint32_t))))
+            return -1;
+          *items = tmp;
+        }
+        (*items)[(*n_items)++] = key;
+        p = next;
+      }
+    }
+    trace_end(TRACE_PARSE);
+  }
+  return status;
+}
+
+void chunk_queue_report(const ChunkQueue* q, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  unsigned long long claimed = q->claimed;
+  unsigned long long* all_claimed = NULL;
+  double* all_busy = NULL;
+  if (rank == 0) {
+    all_claimed = malloc(size * sizeof(unsigned long long));
+    all_busy = malloc(size * sizeof(double));
+  }
+  MPI_Gather(&claimed, 1, MPI_UNSIGNED_LONG_LONG, all_claimed, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+  MPI_Gather(&q->busy, 1, MPI_DOUBLE, all_busy, 1, MPI_DOUBLE, 0, comm);
+
+  if (rank == 0 && all_claimed && all_busy) {
+    printf("\n DYNAMIC CHUNKS \n");
+    printf("%llu chunks of %lld KB\n", (unsigned long long)q->n_chunks, (long long)(q->chunk_bytes / 1024));
+    double max_busy = 0.0, sum_busy = 0.0;
+    for (int r = 0; r < size; r++) {
+      printf("Rank %d: %llu chunks, busy %f s\n", r, all_claimed[r], all_busy[r]);
+      if (all_busy[r] > max_busy) max_busy = all_busy[r];
+      sum_busy += all_busy[r];
+    }
+    if (sum_busy > 0.0)
+      printf("Busy time imbalance (max/mean): %.2f\n", max_busy * size / sum_busy);
+  }
+  free(all_claimed);
+  free(all_busy);
+}
+
+void chunk_queue_free(ChunkQueue* q) {
+  MPI_Win_unlock_all(q->win);
+  MPI_Win_free(&q->win);
+  free(q->buf);
+  q->buf = NULL;
+  q->buf_cap = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CMS_CHUNKS_H
+#define CMS_CHUNKS_H
+
+#include <mpi.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_ingest.h"
+
+// Dynamic partitioning of the input file.
+// Instead of one file_size / comm_sz byte range per rank, the file is cut in
+// many fixed-size chunks and the ranks claim the next one with MPI_Fetch_and_op
+// on a counter hosted by rank 0, until none are left. A slow rank (busy node,
+// filesystem hiccup) simply claims fewer chunks instead of stalling the others.
+// A text line belongs to the chunk holding its first byte, so the chunks of a
+// rank can be read independently and in any order.
+
+typedef struct {
+  MPI_Win win;         // the shared counter, on rank 0
+  uint64_t* counter;
+  MPI_File fh;
+  MPI_Offset file_size;
+  MPI_Offset chunk_bytes;
+  uint64_t n_chunks;
+  int rle;             // fixed ItemRun records instead of text lines
+  char* buf;           // last chunk read, reused by the next one
+  size_t buf_cap;
+  uint64_t claimed;    // chunks processed by this rank
+  uint64_t bytes;      // bytes of those chunks
+  double t_start;
+  double busy;         // seconds until this rank found the queue empty
+} ChunkQueue;
+
+// collective over comm, fh must stay open until chunk_queue_free
+// chunk_bytes is rounded down to whole records for RLE files, returns 0 on success
+int chunk_queue_init(ChunkQueue* q, MPI_File fh, MPI_Offset chunk_bytes, int rle, MPI_Comm comm);
+
+// claim the next chunk and read it, returns 0 once the file is exhausted
+// text: *data is a NUL terminated buffer of the whole lines starting in the chunk
+// RLE: *data holds *len bytes of ItemRun records
+// the data stays valid until the next call
+int chunk_queue_next(ChunkQueue* q, char** data, size_t* len);
+
+// claim chunks until none are left, appending their keys to *items or, when
+// as_runs is set or the file is RLE, their runs to *runs (both grown with realloc)
+// returns 0 on success, -1 if out of memory
+int chunk_read_all(ChunkQueue* q, int as_runs, uint32_t** items, size_t* n_items,
+                   ItemRun** runs, size_t* n_runs);
+
+// gather the chunk counts and busy times on rank 0 and print them with the imbalance
+// collective over comm
+void chunk_queue_report(const ChunkQueue* q, MPI_Comm comm);
+
+// collective over comm
+void chunk_queue_free(ChunkQueue* q);
+
+#endif  // CMS_CHUNKS_H
@@ -0,0 +1,88 @@
+#include "cms_combiner.h"
+
+#include <stdlib.h>
+
+// Fibonacci hashing, the table index is taken from the high bits of the product
+static inline uint32_t combiner_slot(const Combiner* comb, uint32_t key) {
+  return (key * 2654435761u) >> comb->shift;
+}
+
+int combiner_init(Combiner* comb, uint32_t slots, CountMinSketch* cms, CmsUpdateFn update) {
+  comb->keys = comb->counts = NULL;
+  if (slots > COMBINER_MAX_SLOTS)
+    return -1;
+  uint32_t n = 16;
+  uint32_t bits = 4;
+  while (n < slots) {
+    n <<= 1;
+    bits++;
+  }
+
+  comb->keys = malloc(n * sizeof(uint32_t));
+  comb->counts = calloc(n, sizeof(uint32_t));
+  if (!comb->keys || !comb->counts) {
+    free(comb->keys);
+    free(comb->counts);
+    return -1;
+  }
+  comb->slots = n;
+  comb->shift = 32 - bits;
+  comb->size = 0;
+  comb->limit = n - n / 4;
+  comb->cms = cms;
+  comb->update = update;
+  return 0;
+}
+
+void combiner_add(Combiner* comb, uint32_t key, uint32_t count) {
+  // a zero count would look like an empty slot
+  if (count == 0)
+    return;
+  uint32_t mask = comb->slots - 1;
+  uint32_t i = combiner_slot(comb, key);
+
+  // linear probing
+  while (comb->counts[i] != 0) {
+    if (comb->keys[i] == key) {
+      if (comb->counts[i] <= UINT32_MAX - count) {
+        comb->counts[i] += count;
+        return;
+      }
+      // the aggregate would overflow: push it out and restart the key from here
+      comb->update(comb->cms, key, comb->counts[i]);
+      comb->counts[i] = count;
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+
+  if (comb->size == comb->limit) {
+    combiner_flush(comb);
+    i = combiner_slot(comb, key);
+  }
+  comb->keys[i] = key;
+  comb->counts[i] = count;
+  comb->size++;
+}
+
+void combiner_flush(Combiner* comb) {
+  if (comb->size == 0)
+    return;
+  for (uint32_t i = 0; i < comb->slots; i++) {
+    if (comb->counts[i] != 0) {
+      comb->update(comb->cms, comb->keys[i], comb->counts[i]);
+      comb->counts[i] = 0;
+    }
+  }
+  comb->size = 0;
+}
+
+void combiner_free(Combiner* comb) {
+  if (!comb->counts)
+    return;
+  combiner_flush(comb);
+  free(comb->keys);
+  free(comb->counts);
+  comb->keys = NULL;
+  comb->counts = NULL;
+}
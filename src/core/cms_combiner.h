@@ -0,0 +1,41 @@
+#ifndef CMS_COMBINER_H
+#define CMS_COMBINER_H
+
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// Local pre-aggregation stage in front of the sketch.
+// Each thread owns a small open-addressing table that sums (key -> count) and
+// flushes it with weighted updates when it fills up or at the end of the block.
+// On skewed data a hot key costs one update per flush instead of one per
+// occurrence, which in the shared atomic versions removes most contention.
+
+#define COMBINER_DEFAULT_SLOTS 4096  // 32 KB of keys + counts, fits in L1/L2
+#define COMBINER_MAX_SLOTS (1u << 24)  // 128 MB per thread, far past any cache
+
+typedef struct {
+  uint32_t* keys;
+  uint32_t* counts;  // 0 marks an empty slot
+  uint32_t slots;    // power of two
+  uint32_t shift;    // 32 - log2(slots)
+  uint32_t size;     // occupied slots
+  uint32_t limit;    // flush threshold (load factor 3/4)
+  CountMinSketch* cms;
+  CmsUpdateFn update;
+} Combiner;
+
+// allocate a combiner with at least `slots` slots that flushes into cms through update
+// returns 0 on success, -1 if out of memory or slots > COMBINER_MAX_SLOTS
+int combiner_init(Combiner* comb, uint32_t slots, CountMinSketch* cms, CmsUpdateFn update);
+
+// add count occurrences of key, flushing first if the table is full; count 0 is a no-op
+void combiner_add(Combiner* comb, uint32_t key, uint32_t count);
+
+// apply every aggregated (key, count) to the sketch and empty the table
+void combiner_flush(Combiner* comb);
+
+// flush and free
+void combiner_free(Combiner* comb);
+
+#endif  // CMS_COMBINER_H
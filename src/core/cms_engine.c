@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include "cms_engine.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cms_alloc.h"
+#include "cms_merge.h"
+
+void engine_cache_sizes(size_t* l1, size_t* l2) {
+  long a = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  long b = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  *l1 = a > 0 ? (size_t)a : 32 * 1024;
+  *l2 = b > 0 ? (size_t)b : 1024 * 1024;
+}
+
+// same dimensions and hashes as base, zeroed contiguous table of its own
+static int sketch_like(CountMinSketch* dst, const CountMinSketch* base) {
+  size_t cells = (size_t)base->depth * base->width;
+  *dst = *base;
+  dst->total = 0;
+  dst->hashFunctions = malloc(base->depth * sizeof(UniversalHash));
+  dst->table = malloc(base->depth * sizeof(uint32_t*));
+  if (!dst->hashFunctions || !dst->table)
+    return -1;
+  memcpy(dst->hashFunctions, base->hashFunctions, base->depth * sizeof(UniversalHash));
+  dst->table[0] = cms_buffer_alloc(cells * sizeof(uint32_t));
+  if (!dst->table[0])
+    return -1;
+  for (uint32_t d = 1; d < base->depth; d++)
+    dst->table[d] = dst->table[0] + (size_t)d * base->width;
+  return 0;
+}
+
+static void sketch_like_free(CountMinSketch* s) {
+  if (s->table)
+    cms_buffer_free(s->table[0]);
+  free(s->table);
+  free(s->hashFunctions);
+  s->table = NULL;
+  s->hashFunctions = NULL;
+}
+
+// buffers of the selected strategy
+static int engine_setup(CmsEngine* eng) {
+  if (eng->strategy == CMS_STRATEGY_PRIVATE) {
+    eng->copies = calloc(eng->threads, sizeof(CountMinSketch));
+    eng->slots = malloc(eng->threads * sizeof(CountMinSketch*));
+    if (!eng->copies || !eng->slots)
+      return -1;
+    for (int t = 0; t < eng->threads; t++)
+      if (sketch_like(&eng->copies[t], eng->cms) != 0)
+        return -1;
+  } else if (eng->strategy == CMS_STRATEGY_PARTITIONED) {
+    if (owner_init_batch(&eng->op, eng->cms, eng->threads, eng->batch) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+static void engine_teardown(CmsEngine* eng) {
+  if (eng->copies)
+    for (int t = 0; t < eng->threads; t++)
+      sketch_like_free(&eng->copies[t]);
+  free(eng->copies);
+  free(eng->slots);
+  eng->copies = NULL;
+  eng->slots = NULL;
+  if (eng->strategy == CMS_STRATEGY_PARTITIONED && eng->op.part)
+    owner_free(&eng->op);
+  memset(&eng->op, 0, sizeof(eng->op));
+}
+
+// exactly one of items and runs is non-NULL
+static void engine_update(CmsEngine* eng, const uint32_t* items, const ItemRun* runs, size_t n) {
+  if (n == 0)
+    return;
+  CountMinSketch* cms = eng->cms;
+  size_t cells = (size_t)cms->depth * cms->width;
+  size_t batch = eng->batch;
+
+  if (eng->strategy == CMS_STRATEGY_PARTITIONED) {
+#pragma omp parallel num_threads(eng->threads)
+    {
+      if (runs)
+        owner_update_runs(&eng->op, runs, n);
+      else
+        owner_update_items(&eng->op, items, n);
+    }
+  } else if (eng->strategy == CMS_STRATEGY_ATOMIC) {
+    uint32_t* table = cms->table[0];
+    uint32_t total = 0;
+#pragma omp parallel for num_threads(eng->threads) schedule(dynamic, batch) reduction(+ : total)
+    for (size_t i = 0; i < n; i++) {
+      uint32_t key = runs ? runs[i].key : items[i];
+      uint32_t count = runs ? runs[i].count : 1;
+      for (uint32_t d = 0; d < cms->depth; d++) {
+        size_t cell = (size_t)d * cms->width + cms_column(&cms->hashFunctions[d], key);
+#pragma omp atomic
+        table[cell] += count;
+      }
+      total += count;
+    }
+    cms->total += total;
+  } else {
+#pragma omp parallel num_threads(eng->threads)
+    {
+      CountMinSketch* mine = &eng->copies[omp_get_thread_num()];
+      // zeroed by its thread: first touch on the thread's node, and the tree merge left scratch in it
+      memset(mine->table[0], 0, cells * sizeof(uint32_t));
+      mine->total = 0;
+      const CmsKernels* kern = eng->kernels;
+
+      // a batch per call, the kernel keeps the hashes in registers across it
+#pragma omp for schedule(dynamic)
+      for (size_t lo = 0; lo < n; lo += batch) {
+        size_t hi = lo + batch < n ? lo + batch : n;
+        if (runs) {
+          for (size_t i = lo; i < hi; i++)
+            kern->update(mine, runs[i].key, runs[i].count);
+        } else {
+          kern->update_items(mine, items + lo, hi - lo);
+        }
+      }
+
+      cms_merge_private(cms, eng->slots, mine, eng->merge);
+    }
+  }
+}
+
+void engine_update_items(CmsEngine* eng, const uint32_t* items, size_t n) {
+  engine_update(eng, items, NULL, n);
+}
+
+void engine_update_runs(CmsEngine* eng, const ItemRun* runs, size_t n) {
+  engine_update(eng, NULL, runs, n);
+}
+
+// batch sizes worth trying: a round of updates filling L1, L2 and four times L2
+static int tune_batches(const CountMinSketch* cms, size_t n, size_t* out) {
+  size_t l1, l2;
+  engine_cache_sizes(&l1, &l2);
+  size_t per_item = cms->depth * sizeof(CellUpdate);
+  size_t wanted[3] = {l1 / per_item, l2 / per_item, 4 * l2 / per_item};
+  int k = 0;
+  for (int i = 0; i < 3; i++) {
+    size_t b = 256;
+    while (b * 2 <= wanted[i] && b * 2 <= n)
+      b *= 2;
+    if (k == 0 || out[k - 1] != b)
+      out[k++] = b;
+  }
+  return k;
+}
+
+// time every strategy and batch on the sample (items or runs) into a scratch sketch, keep the fastest
+static int engine_tune(CmsEngine* eng, const uint32_t* items, const ItemRun* runs, size_t n, size_t batch) {
+  if (n > ENGINE_TUNE_SAMPLE)
+    n = ENGINE_TUNE_SAMPLE;
+  size_t batches[3];
+  int n_batches = 1;
+  if (batch)
+    batches[0] = batch;
+  else
+    n_batches = tune_batches(eng->cms, n, batches);
+
+  CountMinSketch scratch;
+  if (sketch_like(&scratch, eng->cms) != 0) {
+    sketch_like_free(&scratch);
+    return -1;
+  }
+
+  double best = -1.0;
+  for (int s = CMS_STRATEGY_PRIVATE; s <= CMS_STRATEGY_PARTITIONED; s++) {
+    for (int b = 0; b < n_batches && eng->n_trials < ENGINE_TUNE_MAX; b++) {
+      CmsEngine trial;
+      memset(&trial, 0, sizeof(trial));
+      trial.cms = &scratch;
+      trial.strategy = (CmsStrategy)s;
+      trial.batch = batches[b];
+      trial.merge = eng->merge;
+      trial.threads = eng->threads;
+      trial.kernels = eng->kernels;
+      if (engine_setup(&trial) != 0) {
+        engine_teardown(&trial);
+        continue;
+      }
+
+      // first pass warms the caches and the thread pool, the second one is timed
+      engine_update(&trial, items, runs, n);
+      double t0 = omp_get_wtime();
+      engine_update(&trial, items, runs, n);
+      double elapsed = omp_get_wtime() - t0;
+      engine_teardown(&trial);
+
+      EngineTrial* rec = &eng->trials[eng->n_trials++];
+      rec->strategy = trial.strategy;
+      rec->batch = trial.batch;
+      rec->rate = elapsed > 0 ? n / elapsed : 0;
+      if (rec->rate > best) {
+        best = rec->rate;
+        eng->strategy = rec->strategy;
+        eng->batch = rec->batch;
+      }
+    }
+  }
+  sketch_like_free(&scratch);
+  return 0;
+}
+
+int engine_init(CmsEngine* eng, CountMinSketch* cms, CmsStrategy strategy, size_t batch,
+                CmsMergeMode merge, const uint32_t* sample_items, const ItemRun* sample_runs, size_t n) {
+  memset(eng, 0, sizeof(*eng));
+  eng->cms = cms;
+  eng->merge = merge;
+  eng->threads = omp_get_max_threads();
+  eng->strategy = strategy;
+  eng->batch = batch ? batch : OWNER_BATCH;
+  eng->kernels = cms_kernels_select(cms);
+
+  if (strategy == CMS_STRATEGY_AUTO) {
+    // without a sample the private copies are the safe default
+    eng->strategy = CMS_STRATEGY_PRIVATE;
+    if ((sample_items || sample_runs) && n > 0 && engine_tune(eng, sample_items, sample_runs, n, batch) != 0)
+      return -1;
+  }
+  return engine_setup(eng);
+}
+
+void engine_free(CmsEngine* eng) {
+  engine_teardown(eng);
+}
@@ -0,0 +1,65 @@
+#ifndef CMS_ENGINE_H
+#define CMS_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_ingest.h"
+#include "cms_kernels.h"
+#include "cms_options.h"
+#include "cms_owner.h"
+#include "cms_types.h"
+
+// Unified update engine (libcms).
+// The parallel update strategies that used to live in separate binaries sit
+// behind one interface over a single sketch with a contiguous table:
+//   private      every thread fills its own copy, merged column-parallel per call
+//   atomic       every thread increments the shared table with atomics
+//   partitioned  every thread owns a column slice of the shared table (cms_owner.h)
+// The batch is the number of items a thread takes at a time: the dynamic
+// scheduling chunk of private and atomic, the round size of partitioned.
+//
+// CMS_STRATEGY_AUTO runs the auto-tuner first: every strategy and a few batch
+// sizes derived from the cache sizes update a sample of the input into a scratch
+// sketch with the current thread count, and the fastest combination is kept.
+
+#define ENGINE_TUNE_SAMPLE (1u << 18)  // items of the input used by each calibration run
+#define ENGINE_TUNE_MAX 16             // calibration runs recorded
+
+typedef struct {
+  CmsStrategy strategy;
+  size_t batch;
+  double rate;  // updates per second on the sample
+} EngineTrial;
+
+typedef struct {
+  CountMinSketch* cms;      // the sketch updated by every call
+  CmsStrategy strategy;     // never CMS_STRATEGY_AUTO once initialized
+  size_t batch;
+  CmsMergeMode merge;       // how the private copies are merged
+  int threads;              // omp_get_max_threads() at init
+  const CmsKernels* kernels;  // specialized on the shape of cms, used by private
+  CountMinSketch* copies;   // private: one per thread, reused by every call
+  CountMinSketch** slots;   // private: merge scratch
+  OwnerPartition op;        // partitioned: per-thread buffers
+  EngineTrial trials[ENGINE_TUNE_MAX];  // filled by the auto-tuner
+  int n_trials;
+} CmsEngine;
+
+// cms must have a contiguous table (cms_init); batch 0 picks the default or the tuned one
+// with CMS_STRATEGY_AUTO the first min(n, ENGINE_TUNE_SAMPLE) entries of the input calibrate the
+// engine: sample_items for item input, sample_runs for run input (at most one non-NULL), so the
+// trials time the updates the engine will actually run. Returns 0 on success
+int engine_init(CmsEngine* eng, CountMinSketch* cms, CmsStrategy strategy, size_t batch,
+                CmsMergeMode merge, const uint32_t* sample_items, const ItemRun* sample_runs, size_t n);
+
+// add items (count 1 each) or weighted runs to the sketch, called outside any parallel region
+void engine_update_items(CmsEngine* eng, const uint32_t* items, size_t n);
+void engine_update_runs(CmsEngine* eng, const ItemRun* runs, size_t n);
+
+void engine_free(CmsEngine* eng);
+
+// L1d and L2 sizes of the calling CPU in bytes, defaults when the system does not tell
+void engine_cache_sizes(size_t* l1, size_t* l2);
+
+#endif  // CMS_ENGINE_H
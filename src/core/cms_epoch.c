@@ -0,0 +1,242 @@
+#define _DEFAULT_SOURCE
+#include "cms_epoch.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "cms_alloc.h"
+
+// MPI_SUM of uint32 cells that saturates like the global table
+static void sum_sat(void* in, void* inout, int* len, MPI_Datatype* type) {
+  (void)type;
+  const uint32_t* a = in;
+  uint32_t* b = inout;
+  for (int i = 0; i < *len; i++)
+    b[i] = cms_add_sat(a[i], b[i]);
+}
+
+int epoch_init(EpochSketch* es, const CountMinSketch* local, int n_meta,
+               CmsReduceStrategy strategy, MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  memset(es, 0, sizeof(*es));
+  es->sum_op = MPI_OP_NULL;
+  if (strategy != CMS_REDUCE_ROOT && strategy != CMS_REDUCE_ALL)
+    return -1;
+  MPI_Op_create(sum_sat, 1, &es->sum_op);
+  es->strategy = strategy;
+  es->comm = comm;
+  es->n_meta = n_meta;
+  es->has_table = strategy == CMS_REDUCE_ALL || rank == 0;
+
+  size_t cells = (size_t)local->depth * local->width;
+  es->count = cells;
+  es->buf = cms_buffer_alloc(es->count * sizeof(uint32_t));
+  es->sums = calloc(1 + n_meta, sizeof(uint64_t));
+  es->meta = calloc(n_meta > 0 ? n_meta : 1, sizeof(uint64_t));
+  if (!es->buf || !es->sums || !es->meta)
+    return -1;
+
+  es->global.depth = local->depth;
+  es->global.width = local->width;
+  es->global.total = 0;
+  es->global.epsilon = local->epsilon;
+  es->global.delta = local->delta;
+  es->global.hashFunctions = malloc(local->depth * sizeof(UniversalHash));
+  es->global.table = malloc(local->depth * sizeof(uint32_t*));
+  if (!es->global.hashFunctions || !es->global.table)
+    return -1;
+  memcpy(es->global.hashFunctions, local->hashFunctions, local->depth * sizeof(UniversalHash));
+
+  // only the ranks that answer queries keep a global table
+  uint32_t* block = es->has_table ? cms_buffer_alloc(cells * sizeof(uint32_t)) : NULL;
+  if (es->has_table && !block)
+    return -1;
+  for (uint32_t d = 0; d < local->depth; d++)
+    es->global.table[d] = block ? block + (size_t)d * local->width : NULL;
+  return 0;
+}
+
+void epoch_commit(EpochSketch* es, CountMinSketch* local, uint32_t* meta) {
+  int rank;
+  MPI_Comm_rank(es->comm, &rank);
+  size_t cells = (size_t)local->depth * local->width;
+
+  memcpy(es->buf, local->table[0], cells * sizeof(uint32_t));
+  // summed over the ranks, the total and the counters can pass 2^32 within one epoch
+  es->sums[0] = local->total;
+  for (int m = 0; m < es->n_meta; m++)
+    es->sums[1 + m] = meta[m];
+
+  // MPI counts are int: larger buffers are combined in INT_MAX sized pieces
+  for (size_t done = 0; done < es->count; done += INT_MAX) {
+    int n = (es->count - done) > INT_MAX ? INT_MAX : (int)(es->count - done);
+    if (es->strategy == CMS_REDUCE_ALL)
+      MPI_Allreduce(MPI_IN_PLACE, es->buf + done, n, MPI_UINT32_T, es->sum_op, es->comm);
+    else
+      MPI_Reduce(rank == 0 ? MPI_IN_PLACE : es->buf + done, es->buf + done, n,
+                 MPI_UINT32_T, es->sum_op, 0, es->comm);
+  }
+  if (es->strategy == CMS_REDUCE_ALL)
+    MPI_Allreduce(MPI_IN_PLACE, es->sums, 1 + es->n_meta, MPI_UINT64_T, MPI_SUM, es->comm);
+  else
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : es->sums, es->sums, 1 + es->n_meta, MPI_UINT64_T, MPI_SUM, 0,
+               es->comm);
+
+  if (es->has_table) {
+    uint32_t* global = es->global.table[0];
+    // the global sketch outlives any number of epochs, its cells saturate like its total
+    for (size_t i = 0; i < cells; i++)
+      global[i] = cms_add_sat(global[i], es->buf[i]);
+    es->total += es->sums[0];
+    es->global.total = es->total > UINT32_MAX ? UINT32_MAX : (uint32_t)es->total;
+    for (int m = 0; m < es->n_meta; m++)
+      es->meta[m] += es->sums[1 + m];
+  }
+  es->epochs++;
+
+  // the local tables start the next epoch empty, same memory
+  memset(local->table[0], 0, cells * sizeof(uint32_t));
+  local->total = 0;
+  memset(meta, 0, es->n_meta * sizeof(uint32_t));
+}
+
+void epoch_free(EpochSketch* es) {
+  if (es->global.table)
+    cms_buffer_free(es->global.table[0]);
+  free(es->global.table);
+  free(es->global.hashFunctions);
+  cms_buffer_free(es->buf);
+  free(es->sums);
+  free(es->meta);
+  if (es->sum_op != MPI_OP_NULL)
+    MPI_Op_free(&es->sum_op);
+}
+
+int path_list_add(PathList* list, const char* path) {
+  if (list->n == list->cap) {
+    size_t cap = list->cap ? list->cap * 2 : 16;
+    char** tmp = realloc(list->paths, cap * sizeof(char*));
+    if (!tmp)
+      return -1;
+    list->paths = tmp;
+    list->cap = cap;
+  }
+  char* copy = malloc(strlen(path) + 1);
+  if (!copy)
+    return -1;
+  strcpy(copy, path);
+  list->paths[list->n++] = copy;
+  return 0;
+}
+
+int path_list_contains(const PathList* list, const char* path) {
+  for (size_t i = 0; i < list->n; i++)
+    if (strcmp(list->paths[i], path) == 0)
+      return 1;
+  return 0;
+}
+
+void path_list_free(PathList* list) {
+  for (size_t i = 0; i < list->n; i++)
+    free(list->paths[i]);
+  free(list->paths);
+  list->paths = NULL;
+  list->n = list->cap = 0;
+}
+
+static int cmp_paths(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int epoch_scan(const char* source, const PathList* seen, PathList* out) {
+  struct stat st;
+  if (stat(source, &st) != 0)
+    return -1;
+  if (!S_ISDIR(st.st_mode)) {
+    if (!path_list_contains(seen, source))
+      return path_list_add(out, source);
+    return 0;
+  }
+
+  DIR* dir = opendir(source);
+  if (!dir)
+    return -1;
+  size_t first = out->n;
+  size_t len = strlen(source);
+  const char* sep = len > 0 && source[len - 1] == '/' ? "" : "/";
+  struct dirent* entry;
+  int status = 0;
+  while (status == 0 && (entry = readdir(dir))) {
+    size_t name_len = strlen(entry->d_name);
+    if (entry->d_name[0] == '.' || (name_len > 4 && strcmp(entry->d_name + name_len - 4, ".tmp") == 0))
+      continue;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s%s", source, sep, entry->d_name);
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || path_list_contains(seen, path))
+      continue;
+    status = path_list_add(out, path);
+  }
+  closedir(dir);
+  qsort(out->paths + first, out->n - first, sizeof(char*), cmp_paths);
+  return status;
+}
+
+static int file_state(const char* path, int64_t* size, int64_t* mtime) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return -1;
+  *size = st.st_size;
+  *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  return 0;
+}
+
+int epoch_settle(PathList* files, FileStates* pending) {
+  FileStates next = {{NULL, 0, 0}, NULL, NULL};
+  if (files->n > 0) {
+    next.sizes = malloc(files->n * sizeof(int64_t));
+    next.mtimes = malloc(files->n * sizeof(int64_t));
+    if (!next.sizes || !next.mtimes) {
+      file_states_free(&next);
+      return -1;
+    }
+  }
+
+  size_t kept = 0;
+  int status = 0;
+  for (size_t i = 0; i < files->n; i++) {
+    int64_t size, mtime;
+    int settled = 0;
+    if (file_state(files->paths[i], &size, &mtime) == 0) {
+      for (size_t j = 0; j < pending->list.n; j++)
+        if (strcmp(pending->list.paths[j], files->paths[i]) == 0)
+          settled = pending->sizes[j] == size && pending->mtimes[j] == mtime;
+      if (!settled && status == 0) {
+        next.sizes[next.list.n] = size;
+        next.mtimes[next.list.n] = mtime;
+        status = path_list_add(&next.list, files->paths[i]);
+      }
+    }
+    if (settled)
+      files->paths[kept++] = files->paths[i];
+    else
+      free(files->paths[i]);
+  }
+  files->n = kept;
+
+  file_states_free(pending);
+  *pending = next;
+  return status;
+}
+
+void file_states_free(FileStates* states) {
+  path_list_free(&states->list);
+  free(states->sizes);
+  free(states->mtimes);
+  states->sizes = NULL;
+  states->mtimes = NULL;
+}
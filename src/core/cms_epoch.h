@@ -0,0 +1,75 @@
+#ifndef CMS_EPOCH_H
+#define CMS_EPOCH_H
+
+#include <mpi.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_options.h"
+#include "cms_types.h"
+
+// Continuous ingestion in epochs.
+// A long-running job ingests a sequence of files or directories. After each
+// epoch the local sketches hold only the delta of that epoch: it is summed into
+// a running global sketch and the local tables are zeroed for the next epoch,
+// without reallocating anything. The global sketch stays queryable between
+// epochs on rank 0 (CMS_REDUCE_ROOT) or on every rank (CMS_REDUCE_ALL).
+
+typedef struct {
+  CountMinSketch global;  // sum of the committed epochs, rows are views into one block, cells saturate
+  int has_table;          // 0 on the non-root ranks with CMS_REDUCE_ROOT
+  uint32_t* buf;          // delta table, reused by every epoch
+  size_t count;           // cells of buf
+  MPI_Op sum_op;          // saturating sum of the delta cells over the ranks
+  uint64_t* sums;         // delta total and meta of the epoch, reduced in 64 bits
+  uint64_t total;         // items of the committed epochs, global.total saturates at UINT32_MAX
+  uint64_t* meta;         // running sums of the n_meta extra counters
+  int n_meta;
+  uint64_t epochs;        // committed so far
+  CmsReduceStrategy strategy;
+  MPI_Comm comm;
+} EpochSketch;
+
+// collective over comm, local gives the dimensions and the hashes (identical on every rank)
+// only CMS_REDUCE_ROOT and CMS_REDUCE_ALL are supported, returns 0 on success
+int epoch_init(EpochSketch* es, const CountMinSketch* local, int n_meta,
+               CmsReduceStrategy strategy, MPI_Comm comm);
+
+// collective: add the local deltas and the n_meta counters of every rank to the
+// global sketch, then zero local and meta for the next epoch
+void epoch_commit(EpochSketch* es, CountMinSketch* local, uint32_t* meta);
+
+void epoch_free(EpochSketch* es);
+
+// a growable list of paths
+typedef struct {
+  char** paths;
+  size_t n;
+  size_t cap;
+} PathList;
+
+// append a copy of path, returns 0 on success
+int path_list_add(PathList* list, const char* path);
+int path_list_contains(const PathList* list, const char* path);
+void path_list_free(PathList* list);
+
+// append to out the input files of source not yet in seen: source itself if it is a
+// regular file, otherwise the regular files of the directory sorted by name, without
+// hidden files and *.tmp files (written under a temporary name, then renamed)
+// returns 0 on success, -1 if source cannot be read
+int epoch_scan(const char* source, const PathList* seen, PathList* out);
+
+// files found by a watch poll, with the size and mtime they had then
+typedef struct {
+  PathList list;
+  int64_t* sizes;
+  int64_t* mtimes;  // ns
+} FileStates;
+
+// a watched file may still be being written: keep in files only those whose size and
+// mtime are the same as at the previous call, remember the others in pending with their
+// current size and mtime. Files that disappeared are dropped. Returns 0 on success
+int epoch_settle(PathList* files, FileStates* pending);
+void file_states_free(FileStates* states);
+
+#endif  // CMS_EPOCH_H
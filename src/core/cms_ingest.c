@@ -0,0 +1,131 @@
+#include "cms_ingest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int is_rle_file(const char* filename) {
+  size_t len = strlen(filename);
+  return len >= 4 && strcmp(filename + len - 4, ".rle") == 0;
+}
+
+size_t collapse_runs(const uint32_t* items, size_t n, ItemRun* runs) {
+  size_t n_runs = 0;
+  for (size_t i = 0; i < n; i++) {
+    // a run is closed early if its counter would overflow
+    if (n_runs > 0 && runs[n_runs - 1].key == items[i] && runs[n_runs - 1].count < UINT32_MAX) {
+      runs[n_runs - 1].count++;
+    } else {
+      runs[n_runs].key = items[i];
+      runs[n_runs].count = 1;
+      n_runs++;
+    }
+  }
+  return n_runs;
+}
+
+ItemRun* parse_runs(const char* buffer, size_t* n_runs) {
+  return parse_runs_marked(buffer, n_runs, 0, 0, NULL);
+}
+
+ItemRun* parse_runs_marked(const char* buffer, size_t* n_runs, uint64_t every, uint64_t base, uint64_t** marks) {
+  size_t cap = 1024;
+  size_t n = 0;
+  size_t mark_cap = 0;
+  int failed = 0;
+  ItemRun* runs = malloc(cap * sizeof(ItemRun));
+  if (!runs)
+    return NULL;
+  if (marks)
+    *marks = NULL;
+
+  const char* p = buffer;
+  while (*p) {
+    char* end;
+    uint32_t key = (uint32_t)strtoul(p, &end, 10);
+    if (end == p) {  // blank line or trailing whitespace
+      p++;
+      continue;
+    }
+    const char* line = p;
+    p = end;
+
+    if (n > 0 && runs[n - 1].key == key && runs[n - 1].count < UINT32_MAX) {
+      runs[n - 1].count++;
+      continue;
+    }
+    if (n == cap) {
+      cap *= 2;
+      ItemRun* tmp = realloc(runs, cap * sizeof(ItemRun));
+      if (!tmp) {
+        failed = 1;
+        break;
+      }
+      runs = tmp;
+    }
+    // parsing again from line gives the same runs from here on
+    if (marks && n % every == 0) {
+      size_t k = n / every;
+      if (k == mark_cap) {
+        mark_cap = mark_cap ? 2 * mark_cap : 64;
+        uint64_t* tmp = realloc(*marks, mark_cap * sizeof(uint64_t));
+        if (!tmp) {
+          failed = 1;
+          break;
+        }
+        *marks = tmp;
+      }
+      (*marks)[k] = base + (uint64_t)(line - buffer);
+    }
+    runs[n].key = key;
+    runs[n].count = 1;
+    n++;
+  }
+
+  if (failed) {
+    free(runs);
+    if (marks) {
+      free(*marks);
+      *marks = NULL;
+    }
+    return NULL;
+  }
+  *n_runs = n;
+  return runs;
+}
+
+uint64_t runs_total(const ItemRun* runs, size_t n_runs) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < n_runs; i++)
+    total += runs[i].count;
+  return total;
+}
+
+void rle_partition(uint64_t n_records, int part, int n_parts, uint64_t* first, uint64_t* count) {
+  uint64_t base = n_records / n_parts;
+  uint64_t remainder = n_records % n_parts;
+  *count = base + ((uint64_t)part < remainder ? 1 : 0);
+  *first = part * base + ((uint64_t)part < remainder ? (uint64_t)part : remainder);
+}
+
+ItemRun* load_runs_rle(const char* filename, size_t* n_runs) {
+  FILE* fp = fopen(filename, "rb");
+  if (!fp)
+    return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  long fsize = ftell(fp);
+  rewind(fp);
+
+  size_t n = (size_t)fsize / sizeof(ItemRun);
+  ItemRun* runs = malloc((n > 0 ? n : 1) * sizeof(ItemRun));
+  if (!runs || fread(runs, sizeof(ItemRun), n, fp) != n) {
+    free(runs);
+    fclose(fp);
+    return NULL;
+  }
+  fclose(fp);
+
+  *n_runs = n;
+  return runs;
+}
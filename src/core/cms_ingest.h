@@ -0,0 +1,45 @@
+#ifndef CMS_INGEST_H
+#define CMS_INGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Run-length aware ingestion.
+// Sorted datasets are made of long runs of identical keys: instead of one
+// update per line, each run becomes a single cms_update_int(cms, key, count).
+// Since the sketch is linear, a run split across ranks or threads simply turns
+// into two weighted updates whose sum is the original one, so the partitioning
+// never has to look at the neighbours.
+
+// a run of consecutive equal keys, also the on-disk record of the binary RLE format
+// (.rle files are a flat array of little-endian uint32_t key, count pairs)
+typedef struct {
+  uint32_t key;
+  uint32_t count;
+} ItemRun;
+
+// return 1 if filename has the .rle extension
+int is_rle_file(const char* filename);
+
+// collapse consecutive equal items into runs, runs must have room for n entries
+// returns the number of runs written
+size_t collapse_runs(const uint32_t* items, size_t n, ItemRun* runs);
+
+// parse a NUL terminated buffer of newline separated keys directly into runs
+// without materializing the items, the returned array must be freed by the caller
+ItemRun* parse_runs(const char* buffer, size_t* n_runs);
+
+// parse_runs that also returns in *marks the offset where every every-th run starts,
+// base + its position in buffer: marks[k] for run k * every, to be freed by the caller
+ItemRun* parse_runs_marked(const char* buffer, size_t* n_runs, uint64_t every, uint64_t base, uint64_t** marks);
+
+// total number of items represented by the runs
+uint64_t runs_total(const ItemRun* runs, size_t n_runs);
+
+// split n_records RLE records into n_parts contiguous ranges, sets the range of part
+void rle_partition(uint64_t n_records, int part, int n_parts, uint64_t* first, uint64_t* count);
+
+// read a whole binary RLE file, the returned array must be freed by the caller
+ItemRun* load_runs_rle(const char* filename, size_t* n_runs);
+
+#endif  // CMS_INGEST_H
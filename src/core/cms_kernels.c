@@ -0,0 +1,160 @@
+#include "cms_kernels.h"
+
+#include "count_min_sketch.h"  // EPSILON and PRIME
+
+// ceil(e / EPSILON) as a constant, the width cms_init computes
+#define E_OVER_EPSILON (2.718281828459045 / EPSILON)
+#define CMS_BUILD_WIDTH ((uint32_t)E_OVER_EPSILON + ((double)(uint32_t)E_OVER_EPSILON < E_OVER_EPSILON))
+
+/* ---------- generic loops ---------- */
+
+static void generic_update(CountMinSketch* cms, uint32_t item, uint32_t c) {
+  cms->total += c;
+  for (uint32_t d = 0; d < cms->depth; d++)
+    cms->table[d][cms_column(&cms->hashFunctions[d], item)] += c;
+}
+
+static void generic_update_atomic(CountMinSketch* cms, uint32_t item, uint32_t c) {
+  __atomic_fetch_add(&cms->total, c, __ATOMIC_RELAXED);
+  for (uint32_t d = 0; d < cms->depth; d++)
+    __atomic_fetch_add(&cms->table[d][cms_column(&cms->hashFunctions[d], item)], c, __ATOMIC_RELAXED);
+}
+
+static uint32_t generic_query(const CountMinSketch* cms, uint32_t item) {
+  uint32_t min = UINT32_MAX;
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    uint32_t v = cms->table[d][cms_column(&cms->hashFunctions[d], item)];
+    if (v < min)
+      min = v;
+  }
+  return min;
+}
+
+static void generic_update_items(CountMinSketch* cms, const uint32_t* items, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    for (uint32_t d = 0; d < cms->depth; d++)
+      cms->table[d][cms_column(&cms->hashFunctions[d], items[i])]++;
+  cms->total += (uint32_t)n;
+}
+
+// row by row, each row stays in cache for the whole batch
+static void generic_query_batch(const CountMinSketch* cms, const uint32_t* keys, size_t n, uint32_t* out) {
+  for (size_t i = 0; i < n; i++)
+    out[i] = UINT32_MAX;
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    const UniversalHash* hash = &cms->hashFunctions[d];
+    const uint32_t* row = cms->table[d];
+    for (size_t i = 0; i < n; i++) {
+      uint32_t v = row[cms_column(hash, keys[i])];
+      if (v < out[i])
+        out[i] = v;
+    }
+  }
+}
+
+/* ---------- specialized variants ---------- */
+
+// row d of a kernel: hash constants and row pointer in locals
+#define ROW_LOCALS(d)                                                                  \
+  const uint32_t a##d = cms->hashFunctions[d].a, b##d = cms->hashFunctions[d].b; \
+  uint32_t* const row##d = cms->table[d];
+
+#define ROWS_3(X) X(0) X(1) X(2)
+#define ROWS_4(X) ROWS_3(X) X(3)
+#define ROWS_5(X) ROWS_4(X) X(4)
+
+// column of item in row d for each width class, same formula as cms_column
+#define COLUMN_build(x) ((x) % CMS_BUILD_WIDTH)
+#define COLUMN_pow2(x) ((x) & mask)
+#define COLUMN_any(x) ((x) % width)
+
+#define UPDATE_ROW(d) row##d[COLUMN((a##d * item + b##d) % (uint32_t)PRIME)] += c;
+#define ATOMIC_ROW(d) __atomic_fetch_add(&row##d[COLUMN((a##d * item + b##d) % (uint32_t)PRIME)], c, __ATOMIC_RELAXED);
+#define QUERY_ROW(d)                                                   \
+  {                                                                    \
+    uint32_t v = row##d[COLUMN((a##d * item + b##d) % (uint32_t)PRIME)]; \
+    if (v < min)                                                       \
+      min = v;                                                         \
+  }
+
+// the five kernels of depth D and width class W
+#define DEFINE_VARIANT(D, W)                                                                          \
+  static void update_d##D##_##W(CountMinSketch* cms, uint32_t item, uint32_t c) {                     \
+    const uint32_t width = cms->width, mask = width - 1;                                              \
+    (void)width, (void)mask;                                                                          \
+    ROWS_##D(ROW_LOCALS) ROWS_##D(UPDATE_ROW) cms->total += c;                                        \
+  }                                                                                                   \
+  static void update_atomic_d##D##_##W(CountMinSketch* cms, uint32_t item, uint32_t c) {              \
+    const uint32_t width = cms->width, mask = width - 1;                                              \
+    (void)width, (void)mask;                                                                          \
+    ROWS_##D(ROW_LOCALS) ROWS_##D(ATOMIC_ROW) __atomic_fetch_add(&cms->total, c, __ATOMIC_RELAXED);   \
+  }                                                                                                   \
+  static uint32_t query_d##D##_##W(const CountMinSketch* cms, uint32_t item) {                        \
+    const uint32_t width = cms->width, mask = width - 1;                                              \
+    (void)width, (void)mask;                                                                          \
+    uint32_t min = UINT32_MAX;                                                                        \
+    ROWS_##D(ROW_LOCALS) ROWS_##D(QUERY_ROW) return min;                                              \
+  }                                                                                                   \
+  static void update_items_d##D##_##W(CountMinSketch* cms, const uint32_t* items, size_t n) {         \
+    const uint32_t width = cms->width, mask = width - 1, c = 1;                                       \
+    (void)width, (void)mask;                                                                          \
+    ROWS_##D(ROW_LOCALS) for (size_t i = 0; i < n; i++) {                                             \
+      const uint32_t item = items[i];                                                                 \
+      ROWS_##D(UPDATE_ROW)                                                                            \
+    }                                                                                                 \
+    cms->total += (uint32_t)n;                                                                        \
+  }                                                                                                   \
+  static void query_batch_d##D##_##W(const CountMinSketch* cms, const uint32_t* keys, size_t n,       \
+                                     uint32_t* out) {                                                 \
+    const uint32_t width = cms->width, mask = width - 1;                                              \
+    (void)width, (void)mask;                                                                          \
+    ROWS_##D(ROW_LOCALS) for (size_t i = 0; i < n; i++) {                                             \
+      const uint32_t item = keys[i];                                                                  \
+      uint32_t min = UINT32_MAX;                                                                      \
+      ROWS_##D(QUERY_ROW)                                                                             \
+      out[i] = min;                                                                                   \
+    }                                                                                                 \
+  }
+
+#define DEFINE_WIDTH_CLASS(W) DEFINE_VARIANT(3, W) DEFINE_VARIANT(4, W) DEFINE_VARIANT(5, W)
+
+#define COLUMN COLUMN_build
+DEFINE_WIDTH_CLASS(build)
+#undef COLUMN
+#define COLUMN COLUMN_pow2
+DEFINE_WIDTH_CLASS(pow2)
+#undef COLUMN
+#define COLUMN COLUMN_any
+DEFINE_WIDTH_CLASS(any)
+#undef COLUMN
+
+#define VARIANT(D, W) \
+  {"d" #D "_" #W, update_d##D##_##W, update_atomic_d##D##_##W, query_d##D##_##W, update_items_d##D##_##W, query_batch_d##D##_##W}
+
+#define MIN_DEPTH 3
+#define MAX_DEPTH 5
+
+// by depth, then width class
+static const CmsKernels VARIANTS[MAX_DEPTH - MIN_DEPTH + 1][3] = {
+    {VARIANT(3, build), VARIANT(3, pow2), VARIANT(3, any)},
+    {VARIANT(4, build), VARIANT(4, pow2), VARIANT(4, any)},
+    {VARIANT(5, build), VARIANT(5, pow2), VARIANT(5, any)},
+};
+
+static const CmsKernels GENERIC = {"generic", generic_update, generic_update_atomic, generic_query,
+                                   generic_update_items, generic_query_batch};
+
+const CmsKernels* cms_kernels_select(const CountMinSketch* cms) {
+  if (cms->depth < MIN_DEPTH || cms->depth > MAX_DEPTH || cms->width == 0)
+    return &GENERIC;
+  // the variants assume what cms_column reads from each hash
+  for (uint32_t d = 0; d < cms->depth; d++)
+    if (cms->hashFunctions[d].prime != PRIME || cms->hashFunctions[d].width != cms->width)
+      return &GENERIC;
+  int w = cms->width == CMS_BUILD_WIDTH ? 0 : (cms->width & (cms->width - 1)) == 0 ? 1 : 2;
+  return &VARIANTS[cms->depth - MIN_DEPTH][w];
+}
+
+const CmsKernels* cms_kernels_generic(void) {
+  return &GENERIC;
+}
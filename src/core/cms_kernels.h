@@ -0,0 +1,43 @@
+#ifndef CMS_KERNELS_H
+#define CMS_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// Update and query kernels specialized on the shape of the sketch.
+// Every driver builds depth ceil(ln(1/DELTA)) x width ceil(e/EPSILON) with the
+// prime PRIME, yet the generic loops run over a runtime depth, reload each hash
+// through a pointer and divide by a runtime prime and width. The variants are
+// generated by macro for depths 3 to 5 and three width classes:
+//   build  width == CMS_BUILD_WIDTH, the modulo is by a constant
+//   pow2   power-of-two width, the modulo is a mask
+//   any    any other width, kept in a register
+// fully unrolled, with the hash constants in locals and the prime a constant.
+// Anything else (other depths or primes) gets the generic loops, which compute
+// exactly what the core does.
+//
+// A variant depends on the shape only, so the one selected for a sketch also
+// serves its private copies and replicas.
+
+typedef uint32_t (*CmsQueryFn)(const CountMinSketch* cms, uint32_t item);
+typedef void (*CmsUpdateItemsFn)(CountMinSketch* cms, const uint32_t* items, size_t n);
+typedef void (*CmsQueryBatchFn)(const CountMinSketch* cms, const uint32_t* keys, size_t n, uint32_t* out);
+
+typedef struct {
+  const char* name;             // "d3_build", ..., "generic"
+  CmsUpdateFn update;           // like cms_update_int
+  CmsUpdateFn update_atomic;    // like cms_update_int with atomic cells and total
+  CmsQueryFn query;             // like cms_point_query_int
+  CmsUpdateItemsFn update_items;  // n items of count 1
+  CmsQueryBatchFn query_batch;  // n estimates
+} CmsKernels;
+
+// the fastest kernels valid for the shape of cms, never NULL
+const CmsKernels* cms_kernels_select(const CountMinSketch* cms);
+
+// the generic loops, for comparison
+const CmsKernels* cms_kernels_generic(void);
+
+#endif  // CMS_KERNELS_H
@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include "cms_live.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cms_alloc.h"
+
+#define WRITER_IDLE UINT64_MAX
+#define READER_IDLE UINT32_MAX
+
+// the publisher waits on threads that may share its core
+static void relax(unsigned* spins) {
+  if (++*spins % 64 == 0)
+    sched_yield();
+}
+
+static uint32_t* writer_delta(const CmsLive* live, int writer, uint64_t epoch) {
+  return live->delta + ((size_t)writer * 2 + (epoch & 1)) * live->cells;
+}
+
+static int make_table(CountMinSketch* pub, const CountMinSketch* cms) {
+  *pub = *cms;
+  pub->table = malloc(cms->depth * sizeof(uint32_t*));
+  if (!pub->table)
+    return -1;
+  pub->table[0] = cms_buffer_alloc((size_t)cms->depth * cms->width * sizeof(uint32_t));
+  if (!pub->table[0])
+    return -1;
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    if (d > 0)
+      pub->table[d] = pub->table[0] + (size_t)d * cms->width;
+    memcpy(pub->table[d], cms->table[d], cms->width * sizeof(uint32_t));
+  }
+  return 0;
+}
+
+int live_init(CmsLive* live, const CountMinSketch* cms, int writers, int readers) {
+  memset(live, 0, sizeof(*live));
+  if (writers <= 0 || readers < 0)
+    return -1;
+  live->n_writers = writers;
+  live->n_readers = readers;
+  live->cells = (size_t)cms->depth * cms->width;
+  live->total[0] = live->total[1] = cms->total;
+
+  void* w = NULL;
+  void* r = NULL;
+  if (make_table(&live->pub[0], cms) != 0 || make_table(&live->pub[1], cms) != 0 ||
+      posix_memalign(&w, 64, writers * sizeof(LiveWriter)) != 0 ||
+      posix_memalign(&r, 64, (readers > 0 ? readers : 1) * sizeof(LiveReader)) != 0 ||
+      !(live->delta = cms_buffer_alloc((size_t)writers * 2 * live->cells * sizeof(uint32_t)))) {
+    free(w);
+    free(r);
+    live_free(live);
+    return -1;
+  }
+  live->writers = w;
+  live->readers = r;
+  memset(w, 0, writers * sizeof(LiveWriter));
+  for (int i = 0; i < writers; i++)
+    live->writers[i].epoch = WRITER_IDLE;
+  for (int i = 0; i < readers; i++)
+    live->readers[i].table = READER_IDLE;
+  return 0;
+}
+
+void live_free(CmsLive* live) {
+  for (int p = 0; p < 2; p++) {
+    if (live->pub[p].table)
+      cms_buffer_free(live->pub[p].table[0]);
+    free(live->pub[p].table);
+  }
+  cms_buffer_free(live->delta);
+  free(live->writers);
+  free(live->readers);
+  memset(live, 0, sizeof(*live));
+}
+
+void live_update(CmsLive* live, int writer, const uint32_t* items, size_t n) {
+  LiveWriter* w = &live->writers[writer];
+  // announce the epoch, then check it did not move meanwhile: a publisher that
+  // advanced it before seeing the announcement would not wait for this batch
+  uint64_t e = __atomic_load_n(&live->epoch, __ATOMIC_SEQ_CST);
+  for (;;) {
+    __atomic_store_n(&w->epoch, e, __ATOMIC_SEQ_CST);
+    uint64_t now = __atomic_load_n(&live->epoch, __ATOMIC_SEQ_CST);
+    if (now == e)
+      break;
+    e = now;
+  }
+
+  const CountMinSketch* shape = &live->pub[0];
+  uint32_t* delta = writer_delta(live, writer, e);
+  for (size_t i = 0; i < n; i++)
+    for (uint32_t d = 0; d < shape->depth; d++)
+      delta[(size_t)d * shape->width + cms_column(&shape->hashFunctions[d], items[i])]++;
+  w->items[e & 1] += n;
+
+  // publishes the increments to the publisher of epoch e
+  __atomic_store_n(&w->epoch, WRITER_IDLE, __ATOMIC_RELEASE);
+}
+
+uint64_t live_publish(CmsLive* live) {
+  uint64_t old = live->epoch;
+  __atomic_store_n(&live->epoch, old + 1, __ATOMIC_SEQ_CST);
+
+  // wait for the batches of the old epoch, new batches go to the other deltas
+  for (int i = 0; i < live->n_writers; i++) {
+    unsigned spins = 0;
+    while (__atomic_load_n(&live->writers[i].epoch, __ATOMIC_ACQUIRE) == old)
+      relax(&spins);
+  }
+
+  // grace period: no reader may still hold the table about to be rebuilt
+  uint32_t cur = live->published;
+  uint32_t next = cur ^ 1;
+  for (int i = 0; i < live->n_readers; i++) {
+    unsigned spins = 0;
+    while (__atomic_load_n(&live->readers[i].table, __ATOMIC_SEQ_CST) == next)
+      relax(&spins);
+  }
+
+  // next = cur + the old deltas, which are zeroed for epoch old + 2; the cells
+  // saturate, a wrap would make an estimate decrease
+  uint32_t* dst = live->pub[next].table[0];
+  memcpy(dst, live->pub[cur].table[0], live->cells * sizeof(uint32_t));
+  uint64_t total = live->total[cur];
+  for (int i = 0; i < live->n_writers; i++) {
+    uint32_t* delta = writer_delta(live, i, old);
+    for (size_t c = 0; c < live->cells; c++)
+      dst[c] = cms_add_sat(dst[c], delta[c]);
+    memset(delta, 0, live->cells * sizeof(uint32_t));
+    total += live->writers[i].items[old & 1];
+    live->writers[i].items[old & 1] = 0;
+  }
+  live->total[next] = total;
+  // the exact count is live->total, the sketch field saturates instead of wrapping
+  live->pub[next].total = total > UINT32_MAX ? UINT32_MAX : (uint32_t)total;
+
+  __atomic_store_n(&live->published, next, __ATOMIC_SEQ_CST);
+  return old + 1;
+}
+
+const CountMinSketch* live_read_begin(CmsLive* live, int reader) {
+  LiveReader* r = &live->readers[reader];
+  uint32_t p = __atomic_load_n(&live->published, __ATOMIC_SEQ_CST);
+  for (;;) {
+    // pin p, then check it is still current: the publisher scans the slots
+    // after swapping, so either it sees the pin or this check sees the swap
+    __atomic_store_n(&r->table, p, __ATOMIC_SEQ_CST);
+    uint32_t now = __atomic_load_n(&live->published, __ATOMIC_SEQ_CST);
+    if (now == p)
+      return &live->pub[p];
+    p = now;
+  }
+}
+
+void live_read_end(CmsLive* live, int reader) {
+  __atomic_store_n(&live->readers[reader].table, READER_IDLE, __ATOMIC_RELEASE);
+}
+
+uint32_t live_point_query(CmsLive* live, int reader, uint32_t key) {
+  const CountMinSketch* cms = live_read_begin(live, reader);
+  uint32_t min = UINT32_MAX;
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    uint32_t v = cms->table[d][cms_column(&cms->hashFunctions[d], key)];
+    if (v < min)
+      min = v;
+  }
+  live_read_end(live, reader);
+  return min;
+}
+
+void live_point_query_batch(CmsLive* live, int reader, const uint32_t* keys, size_t n, uint32_t* out) {
+  const CountMinSketch* cms = live_read_begin(live, reader);
+  for (size_t i = 0; i < n; i++)
+    out[i] = UINT32_MAX;
+  // row by row, each row stays in cache for the whole batch
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    const UniversalHash* hash = &cms->hashFunctions[d];
+    const uint32_t* row = cms->table[d];
+    for (size_t i = 0; i < n; i++) {
+      uint32_t v = row[cms_column(hash, keys[i])];
+      if (v < out[i])
+        out[i] = v;
+    }
+  }
+  live_read_end(live, reader);
+}
+
+uint64_t live_total(const CmsLive* live) {
+  return live->total[__atomic_load_n(&live->published, __ATOMIC_ACQUIRE)];
+}
@@ -0,0 +1,77 @@
+#ifndef CMS_LIVE_H
+#define CMS_LIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// Live sketch: point queries served while ingestion keeps running.
+//
+// Writers add batches to private delta tables, one pair per writer indexed by
+// the parity of the global epoch, with plain increments: no lock and no atomic
+// per item, only two stores per batch to announce the epoch and to go idle.
+// live_publish starts a new epoch, waits until no writer is still inside a
+// batch of the old one (batches are short), folds the old deltas into the
+// inactive published table and swaps it in. Readers pin the published table
+// they query in their own slot; the publisher only ever writes the table no
+// reader holds, so readers never wait for writers and never see a table
+// being built.
+//
+// Consistency: a query sees exactly the batches of the epochs published before
+// it started, never part of a batch, and its estimate never decreases from one
+// query to the next: the published cells saturate at UINT32_MAX. Staleness is bounded by the publish interval plus one batch.
+//
+// Threads: writer w calls live_update(live, w, ...) only from one thread at a
+// time, same for reader r. live_publish is called by one thread at a time,
+// which can be a writer between two of its batches but not a reader inside a
+// query.
+
+typedef struct {
+  uint64_t epoch;  // epoch of the batch in progress, UINT64_MAX between batches
+  uint64_t items[2];
+  char pad[40];    // one slot per cache line
+} LiveWriter;
+
+typedef struct {
+  uint32_t table;  // published table in use, UINT32_MAX between queries
+  char pad[60];
+} LiveReader;
+
+typedef struct {
+  CountMinSketch pub[2];  // published tables, share the hashes of the source
+  uint64_t total[2];      // items in each published table
+  uint32_t published;     // index of the current table
+  uint64_t epoch;
+  uint32_t* delta;        // writers x 2 x depth x width
+  LiveWriter* writers;
+  LiveReader* readers;
+  int n_writers;
+  int n_readers;
+  size_t cells;
+} CmsLive;
+
+// live sketch of the shape of cms, starting from its counts; the hashes are
+// shared, so cms must outlive it. Returns 0 on success
+int live_init(CmsLive* live, const CountMinSketch* cms, int writers, int readers);
+
+void live_free(CmsLive* live);
+
+// writer: add one batch of items, each with count 1
+void live_update(CmsLive* live, int writer, const uint32_t* items, size_t n);
+
+// make every finished batch visible to new queries, returns the new epoch
+uint64_t live_publish(CmsLive* live);
+
+// reader: pin the current published table, release it with live_read_end
+const CountMinSketch* live_read_begin(CmsLive* live, int reader);
+void live_read_end(CmsLive* live, int reader);
+
+// reader: estimates of one key or of n keys, on one consistent table
+uint32_t live_point_query(CmsLive* live, int reader, uint32_t key);
+void live_point_query_batch(CmsLive* live, int reader, const uint32_t* keys, size_t n, uint32_t* out);
+
+// items visible to queries, exact: the total of a published table saturates at UINT32_MAX
+uint64_t live_total(const CmsLive* live);
+
+#endif  // CMS_LIVE_H
@@ -0,0 +1,52 @@
+#include "cms_merge.h"
+
+#include <omp.h>
+#include <stddef.h>
+
+// cells are split in multiples of a cache line so threads never share one
+#define MERGE_ALIGN 16
+
+// [lo, hi) cell range of the calling thread
+static void thread_range(size_t cells, size_t* lo, size_t* hi) {
+  size_t n = (size_t)omp_get_num_threads();
+  size_t t = (size_t)omp_get_thread_num();
+  size_t chunk = (cells + n - 1) / n;
+  chunk = (chunk + MERGE_ALIGN - 1) / MERGE_ALIGN * MERGE_ALIGN;
+  *lo = t * chunk < cells ? t * chunk : cells;
+  *hi = *lo + chunk < cells ? *lo + chunk : cells;
+}
+
+static void add_cells(uint32_t* restrict dst, const uint32_t* restrict src, size_t lo, size_t hi) {
+#pragma omp simd
+  for (size_t c = lo; c < hi; c++)
+    dst[c] += src[c];
+}
+
+void cms_merge_private(CountMinSketch* dst, CountMinSketch** slots, CountMinSketch* mine, CmsMergeMode mode) {
+  int n = omp_get_num_threads();
+  size_t cells = (size_t)dst->depth * dst->width;
+  size_t lo, hi;
+  thread_range(cells, &lo, &hi);
+
+  slots[omp_get_thread_num()] = mine;
+#pragma omp barrier
+
+#pragma omp single
+  for (int t = 0; t < n; t++)
+    dst->total += slots[t]->total;
+
+  if (mode == CMS_MERGE_TREE) {
+    // log2(n) levels of pairwise adds, every thread on its own cells of every
+    // pair: the levels need no barrier and the critical path stays one range
+    for (int stride = 1; stride < n; stride *= 2)
+      for (int t = 0; t < n - stride; t += 2 * stride)
+        add_cells(slots[t]->table[0], slots[t + stride]->table[0], lo, hi);
+    add_cells(dst->table[0], slots[0]->table[0], lo, hi);
+  } else {
+    for (int t = 0; t < n; t++)
+      add_cells(dst->table[0], slots[t]->table[0], lo, hi);
+  }
+
+  // nobody may free its copy while others are still reading it
+#pragma omp barrier
+}
@@ -0,0 +1,26 @@
+#ifndef CMS_MERGE_H
+#define CMS_MERGE_H
+
+#include <stdint.h>
+
+#include "cms_options.h"
+#include "cms_types.h"
+
+// Merge of thread-private sketches into the shared one.
+// Instead of adding whole copies one thread at a time in a critical section,
+// after a barrier every thread sums a disjoint range of cells across all the
+// private copies (a transposed reduction), so the merge takes about one copy's
+// worth of additions per thread whatever the number of threads.
+// The tables must be contiguous (table[0] holds depth * width cells).
+
+// CmsMergeMode (cms_options.h) selects the plain column split or a pairwise
+// tree over the copies followed by one add; both split every add by cell range,
+// the tree only changes the order in which a thread adds the copies.
+
+// must be called by every thread of the enclosing parallel region with its own copy
+// slots is a shared array with room for one pointer per thread
+// with CMS_MERGE_TREE the private tables are used as scratch space
+// returns once the merge is complete, the copies can be freed afterwards
+void cms_merge_private(CountMinSketch* dst, CountMinSketch** slots, CountMinSketch* mine, CmsMergeMode mode);
+
+#endif  // CMS_MERGE_H
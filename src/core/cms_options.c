@@ -0,0 +1,279 @@
+#include "cms_options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cms_combiner.h"
+
+// parse the value of --name=value as a positive integer, returns 0 if missing or invalid
+static unsigned long option_uint(const char* arg) {
+  const char* eq = strchr(arg, '=');
+  if (!eq || !eq[1])
+    return 0;
+  char* end;
+  unsigned long v = strtoul(eq + 1, &end, 10);
+  return *end ? 0 : v;
+}
+
+static const char* REDUCE_NAMES[] = {"reduce", "allreduce", "scatter"};
+
+// every flag with its group and usage line, the line may print one unsigned default
+typedef struct {
+  const char* name;
+  uint32_t group;
+  const char* usage;
+  unsigned value;
+} OptionInfo;
+
+static const OptionInfo OPTIONS[] = {
+    {"--runs", CMS_OPT_RUNS, "  --runs              collapse consecutive equal keys into weighted updates (sorted datasets)\n", 0},
+    {"--combiner", CMS_OPT_COMBINER,
+     "  --combiner[=slots]  pre-aggregate keys in a per-thread table before updating (default %u slots)\n",
+     COMBINER_DEFAULT_SLOTS},
+    {"--reduce", CMS_OPT_REDUCE,
+     "  --reduce=strategy   reduce (to rank 0), allreduce (on every rank) or scatter (column slices)\n", 0},
+    {"--hierarchical", CMS_OPT_HIERARCHICAL,
+     "  --hierarchical      sum the sketches of each node in shared memory, only node leaders communicate\n", 0},
+    {"--merge", CMS_OPT_MERGE, "  --merge=mode        merge of per-thread sketches: columns (default) or tree\n", 0},
+    {"--update", CMS_OPT_UPDATE,
+     "  --update=mode       shared sketch updates: atomic (default) or owner (per-thread column slices)\n", 0},
+    {"--numa", CMS_OPT_NUMA, "  --numa              pin threads, first-touch data on their node, one shared sketch per node\n", 0},
+    {"--huge-pages", CMS_OPT_HUGE_PAGES,
+     "  --huge-pages        back the sketch and input buffers with 2 MB/1 GB pages when available\n", 0},
+    {"--dynamic", CMS_OPT_DYNAMIC,
+     "  --dynamic[=kb]      ranks claim fixed-size chunks of the file from a shared counter (default %u KB)\n",
+     DYNAMIC_DEFAULT_CHUNK_KB},
+    {"--epsilon", CMS_OPT_EPSILON, "  --epsilon=value     accuracy of the sharded sketch (mpiV4), width = e / epsilon\n", 0},
+    {"--exchange", CMS_OPT_EXCHANGE,
+     "  --exchange=mode     sharded sketch updates: alltoall (default) or accumulate (one-sided)\n", 0},
+    {"--watch", CMS_OPT_WATCH,
+     "  --watch[=secs]      keep polling the epoch directories for new files until a STOP file appears (default %u s)\n",
+     WATCH_DEFAULT_SECONDS},
+    {"--checkpoint", CMS_OPT_CHECKPOINT,
+     "  --checkpoint=file   save the local sketches and input offsets to file while updating\n", 0},
+    {"--checkpoint-every", CMS_OPT_CHECKPOINT, "  --checkpoint-every=n  local items between checkpoints (default %u)\n",
+     CHECKPOINT_DEFAULT_ITEMS},
+    {"--restart", CMS_OPT_CHECKPOINT, "  --restart           resume from the checkpoint file instead of starting from zero\n", 0},
+    {"--strategy", CMS_OPT_STRATEGY,
+     "  --strategy=name     engine updates: private, atomic, partitioned or auto (default, calibrated)\n", 0},
+    {"--batch", CMS_OPT_BATCH, "  --batch=n           items a thread takes at a time in the engine (default: tuned)\n", 0},
+    {"--report", CMS_OPT_REPORT,
+     "  --report=file       append a JSON record of per-rank, per-thread phase times to file (- = stdout)\n", 0},
+    {"--trace", CMS_OPT_TRACE,
+     "  --trace=file        write a Chrome trace (Perfetto) of the read/parse/update/merge/reduce phases to file\n", 0},
+    {"--accuracy", CMS_OPT_ACCURACY,
+     "  --accuracy=truth    evaluate the sketch against the exact counts of cms_count (text or .bin)\n", 0},
+    {"--accuracy-out", CMS_OPT_ACCURACY,
+     "  --accuracy-out=file append the JSON accuracy record to file (default - = stdout)\n", 0},
+    {"--snapshot", CMS_OPT_SNAPSHOT, "  --snapshot=file     write the final sketch to file, served by cms_serve\n", 0},
+    {"--pipeline", CMS_OPT_PIPELINE,
+     "  --pipeline[=segs]   non-blocking reduction in segments, started without waiting for the other ranks (default %u)\n",
+     PIPELINE_DEFAULT_SEGMENTS},
+};
+
+#define N_OPTIONS (sizeof(OPTIONS) / sizeof(OPTIONS[0]))
+
+// the flag of arg, with or without its =value, NULL if there is no such flag
+static const OptionInfo* find_option(const char* arg) {
+  size_t len = strcspn(arg, "=");
+  for (size_t i = 0; i < N_OPTIONS; i++)
+    if (strlen(OPTIONS[i].name) == len && strncmp(arg, OPTIONS[i].name, len) == 0)
+      return &OPTIONS[i];
+  return NULL;
+}
+
+const char* cms_reduce_strategy_name(CmsReduceStrategy strategy) {
+  return REDUCE_NAMES[strategy];
+}
+
+static const char* STRATEGY_NAMES[] = {"private", "atomic", "partitioned", "auto"};
+
+const char* cms_strategy_name(CmsStrategy strategy) {
+  return STRATEGY_NAMES[strategy];
+}
+
+void cms_options_default(CmsOptions* opts) {
+  opts->runs = 0;
+  opts->combiner = 0;
+  opts->reduce = CMS_REDUCE_ROOT;
+  opts->hierarchical = 0;
+  opts->pipeline = 0;
+  opts->merge = CMS_MERGE_COLUMNS;
+  opts->owner = 0;
+  opts->numa = 0;
+  opts->huge_pages = 0;
+  opts->dynamic = 0;
+  opts->epsilon = 0.0;
+  opts->exchange = CMS_SHARD_ALLTOALL;
+  opts->watch = 0;
+  opts->checkpoint = NULL;
+  opts->checkpoint_every = CHECKPOINT_DEFAULT_ITEMS;
+  opts->restart = 0;
+  opts->strategy = CMS_STRATEGY_AUTO;
+  opts->batch = 0;
+  opts->report = NULL;
+  opts->trace = NULL;
+  opts->accuracy = NULL;
+  opts->accuracy_out = "-";
+  opts->snapshot = NULL;
+}
+
+int cms_parse_options(int argc, char* argv[], uint32_t supported, CmsOptions* opts) {
+  cms_options_default(opts);
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0)
+      continue;  // positional argument
+
+    const OptionInfo* info = find_option(arg);
+    if (info && !(supported & info->group)) {
+      fprintf(stderr, "Error: %s is not supported by %s\n", info->name, argv[0]);
+      return -1;
+    }
+    if (strcmp(arg, "--runs") == 0) {
+      opts->runs = 1;
+    } else if (strcmp(arg, "--combiner") == 0) {
+      opts->combiner = COMBINER_DEFAULT_SLOTS;
+    } else if (strncmp(arg, "--combiner=", 11) == 0) {
+      unsigned long slots = option_uint(arg);
+      if (slots == 0 || slots > COMBINER_MAX_SLOTS) {
+        fprintf(stderr, "Error: --combiner expects a number of slots between 1 and %u\n", COMBINER_MAX_SLOTS);
+        return -1;
+      }
+      opts->combiner = (uint32_t)slots;
+    } else if (strcmp(arg, "--hierarchical") == 0) {
+      opts->hierarchical = 1;
+    } else if (strcmp(arg, "--pipeline") == 0) {
+      opts->pipeline = PIPELINE_DEFAULT_SEGMENTS;
+    } else if (strncmp(arg, "--pipeline=", 11) == 0) {
+      opts->pipeline = (int)option_uint(arg);
+      if (opts->pipeline <= 0) {
+        fprintf(stderr, "Error: --pipeline expects a positive number of segments\n");
+        return -1;
+      }
+    } else if (strcmp(arg, "--merge=columns") == 0) {
+      opts->merge = CMS_MERGE_COLUMNS;
+    } else if (strcmp(arg, "--merge=tree") == 0) {
+      opts->merge = CMS_MERGE_TREE;
+    } else if (strcmp(arg, "--update=atomic") == 0) {
+      opts->owner = 0;
+    } else if (strcmp(arg, "--update=owner") == 0) {
+      opts->owner = 1;
+    } else if (strcmp(arg, "--numa") == 0) {
+      opts->numa = 1;
+    } else if (strcmp(arg, "--huge-pages") == 0) {
+      opts->huge_pages = 1;
+    } else if (strcmp(arg, "--dynamic") == 0) {
+      opts->dynamic = DYNAMIC_DEFAULT_CHUNK_KB;
+    } else if (strncmp(arg, "--dynamic=", 10) == 0) {
+      unsigned long kb = option_uint(arg);
+      if (kb == 0 || kb > (1ul << 20)) {
+        fprintf(stderr, "Error: --dynamic expects a chunk size between 1 and 1048576 KB\n");
+        return -1;
+      }
+      opts->dynamic = (uint32_t)kb;
+    } else if (strncmp(arg, "--epsilon=", 10) == 0) {
+      char* end;
+      opts->epsilon = strtod(arg + 10, &end);
+      if (*end || opts->epsilon <= 0.0 || opts->epsilon >= 1.0) {
+        fprintf(stderr, "Error: --epsilon expects a value between 0 and 1 (exclusive)\n");
+        return -1;
+      }
+    } else if (strcmp(arg, "--exchange=alltoall") == 0) {
+      opts->exchange = CMS_SHARD_ALLTOALL;
+    } else if (strcmp(arg, "--exchange=accumulate") == 0) {
+      opts->exchange = CMS_SHARD_ACCUMULATE;
+    } else if (strcmp(arg, "--watch") == 0) {
+      opts->watch = WATCH_DEFAULT_SECONDS;
+    } else if (strncmp(arg, "--watch=", 8) == 0) {
+      opts->watch = (int)option_uint(arg);
+      if (opts->watch <= 0) {
+        fprintf(stderr, "Error: --watch expects a positive number of seconds\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--checkpoint=", 13) == 0 && arg[13]) {
+      opts->checkpoint = arg + 13;
+    } else if (strncmp(arg, "--checkpoint-every=", 19) == 0) {
+      opts->checkpoint_every = option_uint(arg);
+      if (opts->checkpoint_every == 0) {
+        fprintf(stderr, "Error: --checkpoint-every expects a positive number of items\n");
+        return -1;
+      }
+    } else if (strcmp(arg, "--restart") == 0) {
+      opts->restart = 1;
+    } else if (strncmp(arg, "--reduce=", 9) == 0) {
+      int found = 0;
+      for (int s = CMS_REDUCE_ROOT; s <= CMS_REDUCE_SCATTER; s++) {
+        if (strcmp(arg + 9, REDUCE_NAMES[s]) == 0) {
+          opts->reduce = (CmsReduceStrategy)s;
+          found = 1;
+        }
+      }
+      if (!found) {
+        fprintf(stderr, "Error: --reduce expects reduce, allreduce or scatter\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--strategy=", 11) == 0) {
+      int found = 0;
+      for (int s = CMS_STRATEGY_PRIVATE; s <= CMS_STRATEGY_AUTO; s++) {
+        if (strcmp(arg + 11, STRATEGY_NAMES[s]) == 0) {
+          opts->strategy = (CmsStrategy)s;
+          found = 1;
+        }
+      }
+      if (!found) {
+        fprintf(stderr, "Error: --strategy expects private, atomic, partitioned or auto\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--batch=", 8) == 0) {
+      opts->batch = (uint32_t)option_uint(arg);
+      if (opts->batch == 0) {
+        fprintf(stderr, "Error: --batch expects a positive number of items\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--report=", 9) == 0 && arg[9]) {
+      opts->report = arg + 9;
+    } else if (strncmp(arg, "--trace=", 8) == 0 && arg[8]) {
+      opts->trace = arg + 8;
+    } else if (strncmp(arg, "--accuracy=", 11) == 0 && arg[11]) {
+      opts->accuracy = arg + 11;
+    } else if (strncmp(arg, "--accuracy-out=", 15) == 0 && arg[15]) {
+      opts->accuracy_out = arg + 15;
+    } else if (strncmp(arg, "--snapshot=", 11) == 0 && arg[11]) {
+      opts->snapshot = arg + 11;
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", arg);
+      return -1;
+    }
+  }
+  if (opts->owner && opts->combiner) {
+    fprintf(stderr, "Error: --combiner and --update=owner cannot be combined\n");
+    return -1;
+  }
+  if (opts->restart && !opts->checkpoint) {
+    fprintf(stderr, "Error: --restart needs --checkpoint=file\n");
+    return -1;
+  }
+  if (opts->checkpoint && opts->dynamic) {
+    // the chunks a rank claims change from run to run, its offsets would not match
+    fprintf(stderr, "Error: --checkpoint needs the static partition, not --dynamic\n");
+    return -1;
+  }
+  if (opts->pipeline && opts->hierarchical) {
+    fprintf(stderr, "Error: --pipeline and --hierarchical cannot be combined\n");
+    return -1;
+  }
+  return 0;
+}
+
+void cms_print_options_usage(const char* prog, uint32_t supported) {
+  fprintf(stderr, "Usage: %s <input_file> [folder]%s\n", prog, supported ? " [options]" : "");
+  if (supported)
+    fprintf(stderr, "Options:\n");
+  for (size_t i = 0; i < N_OPTIONS; i++)
+    if (supported & OPTIONS[i].group)
+      fprintf(stderr, OPTIONS[i].usage, OPTIONS[i].value);
+  if (supported & CMS_OPT_RUNS)
+    fprintf(stderr, "Input files ending in .rle are read as binary (key, count) runs.\n");
+}
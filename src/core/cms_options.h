@@ -0,0 +1,104 @@
+#ifndef CMS_OPTIONS_H
+#define CMS_OPTIONS_H
+
+#include <stdint.h>
+
+// how the per-rank sketches are combined, see cms_reduce.h
+typedef enum {
+  CMS_REDUCE_ROOT,     // MPI_Reduce: the global sketch lives on rank 0
+  CMS_REDUCE_ALL,      // MPI_Allreduce: every rank can answer queries
+  CMS_REDUCE_SCATTER,  // MPI_Reduce_scatter_block: each rank owns a column slice
+} CmsReduceStrategy;
+
+// how thread-private sketches are merged, see cms_merge.h
+typedef enum {
+  CMS_MERGE_COLUMNS,  // every thread sums a disjoint range of cells over all copies
+  CMS_MERGE_TREE,     // pairwise tree over the copies
+} CmsMergeMode;
+
+// how the column-sharded sketch routes the increments to the owners, see cms_shard.h
+typedef enum {
+  CMS_SHARD_ALLTOALL,    // MPI_Alltoallv rounds, every rank takes part in each one
+  CMS_SHARD_ACCUMULATE,  // one-sided MPI_Accumulate into the owner's window, no rendezvous
+} CmsShardExchange;
+
+// how the threads of the unified engine update one sketch, see cms_engine.h
+typedef enum {
+  CMS_STRATEGY_PRIVATE,      // thread-private copies merged at the end of each call
+  CMS_STRATEGY_ATOMIC,       // one shared table, atomic increments
+  CMS_STRATEGY_PARTITIONED,  // one shared table, each thread owns a column slice
+  CMS_STRATEGY_AUTO,         // calibrated at startup by the auto-tuner
+} CmsStrategy;
+
+// Runtime options shared by the drivers.
+// They are given as --flag or --flag=value after the positional arguments, e.g.
+//   mpirun -np 4 ./mpiV2 data/dataset_500000_sorted.txt data/ --runs
+typedef struct {
+  int runs;           // collapse runs of equal keys into a single weighted update
+  uint32_t combiner;  // slots of the per-thread pre-aggregation table, 0 = disabled
+  CmsReduceStrategy reduce;
+  int hierarchical;   // reduce within each node through shared memory first
+  int pipeline;       // segments of the non-blocking reduction, 0 = blocking
+  CmsMergeMode merge;
+  int owner;          // ownership-partitioned updates instead of atomics (shared sketch drivers)
+  int numa;           // pin threads, first-touch placement, one shared sketch per node
+  int huge_pages;     // back sketch tables and input buffers with huge pages
+  uint32_t dynamic;   // chunk size in KB of the dynamic file partitioning, 0 = one range per rank
+  double epsilon;     // accuracy of the sharded sketch (mpiV4), 0 = EPSILON of the build
+  CmsShardExchange exchange;
+  int watch;          // seconds between polls of the epoch directories for new files, 0 = off
+  const char* checkpoint;     // checkpoint file (points into argv), NULL = no checkpoints
+  uint64_t checkpoint_every;  // local items (or runs) between checkpoints
+  int restart;                // resume from the checkpoint file if it exists
+  CmsStrategy strategy;       // update strategy of the unified engine
+  uint32_t batch;             // items a thread takes at a time in the engine, 0 = tuned or default
+  const char* report;         // JSON timing report appended to this file ("-" = stdout), NULL = none
+  const char* trace;          // Chrome trace JSON written to this file, NULL = no tracing
+  const char* accuracy;       // ground truth (total_<dataset>) to evaluate the sketch against, NULL = none
+  const char* accuracy_out;   // JSON accuracy record appended to this file ("-" = stdout)
+  const char* snapshot;       // final sketch written to this file for cms_serve, NULL = none
+} CmsOptions;
+
+// groups of flags, each driver passes the ones it implements to cms_parse_options
+#define CMS_OPT_RUNS (1u << 0)          // --runs
+#define CMS_OPT_COMBINER (1u << 1)      // --combiner
+#define CMS_OPT_REDUCE (1u << 2)        // --reduce
+#define CMS_OPT_HIERARCHICAL (1u << 3)  // --hierarchical
+#define CMS_OPT_PIPELINE (1u << 4)      // --pipeline
+#define CMS_OPT_MERGE (1u << 5)         // --merge
+#define CMS_OPT_UPDATE (1u << 6)        // --update
+#define CMS_OPT_NUMA (1u << 7)          // --numa
+#define CMS_OPT_HUGE_PAGES (1u << 8)    // --huge-pages
+#define CMS_OPT_DYNAMIC (1u << 9)       // --dynamic
+#define CMS_OPT_EPSILON (1u << 10)      // --epsilon
+#define CMS_OPT_EXCHANGE (1u << 11)     // --exchange
+#define CMS_OPT_WATCH (1u << 12)        // --watch
+#define CMS_OPT_CHECKPOINT (1u << 13)   // --checkpoint, --checkpoint-every and --restart
+#define CMS_OPT_STRATEGY (1u << 14)     // --strategy
+#define CMS_OPT_BATCH (1u << 15)        // --batch
+#define CMS_OPT_REPORT (1u << 16)       // --report
+#define CMS_OPT_TRACE (1u << 17)        // --trace
+#define CMS_OPT_ACCURACY (1u << 18)     // --accuracy and --accuracy-out
+#define CMS_OPT_SNAPSHOT (1u << 19)     // --snapshot
+
+#define PIPELINE_DEFAULT_SEGMENTS 8
+#define DYNAMIC_DEFAULT_CHUNK_KB 512
+#define WATCH_DEFAULT_SECONDS 5
+#define CHECKPOINT_DEFAULT_ITEMS (1u << 22)
+
+// set every option to its default value
+void cms_options_default(CmsOptions* opts);
+
+// parse the --flags in argv, positional arguments are skipped; supported is the
+// CMS_OPT_* groups of the driver, any other flag is an error
+// returns 0 on success, -1 on an unknown, unsupported or malformed flag
+int cms_parse_options(int argc, char* argv[], uint32_t supported, CmsOptions* opts);
+
+// name of a reduction strategy as accepted by --reduce
+const char* cms_reduce_strategy_name(CmsReduceStrategy strategy);
+const char* cms_strategy_name(CmsStrategy strategy);
+
+// print the flags of the supported groups
+void cms_print_options_usage(const char* prog, uint32_t supported);
+
+#endif  // CMS_OPTIONS_H
@@ -0,0 +1,129 @@
+#include "cms_owner.h"
+
+#include <omp.h>
+#include <stdlib.h>
+
+int owner_init(OwnerPartition* op, CountMinSketch* cms, int max_threads) {
+  return owner_init_batch(op, cms, max_threads, OWNER_BATCH);
+}
+
+int owner_init_batch(OwnerPartition* op, CountMinSketch* cms, int max_threads, size_t batch) {
+  op->cms = cms;
+  op->max_threads = max_threads;
+  op->batch = batch;
+  op->part = calloc(max_threads, sizeof(CellUpdate*));
+  op->scratch = calloc(max_threads, sizeof(CellUpdate*));
+  op->offsets = calloc(max_threads, sizeof(size_t*));
+  if (!op->part || !op->scratch || !op->offsets)
+    return -1;
+
+  size_t cap = batch * cms->depth;
+  for (int t = 0; t < max_threads; t++) {
+    op->part[t] = malloc(cap * sizeof(CellUpdate));
+    op->scratch[t] = malloc(cap * sizeof(CellUpdate));
+    op->offsets[t] = malloc((max_threads + 1) * sizeof(size_t));
+    if (!op->part[t] || !op->scratch[t] || !op->offsets[t])
+      return -1;
+  }
+  return 0;
+}
+
+void owner_free(OwnerPartition* op) {
+  for (int t = 0; t < op->max_threads; t++) {
+    if (op->part) free(op->part[t]);
+    if (op->scratch) free(op->scratch[t]);
+    if (op->offsets) free(op->offsets[t]);
+  }
+  free(op->part);
+  free(op->scratch);
+  free(op->offsets);
+}
+
+// hash one batch of the calling thread into its owner-partitioned buffer
+// exactly one of items and runs is non-NULL
+static void partition_batch(OwnerPartition* op, const uint32_t* items, const ItemRun* runs,
+                            size_t n, int tid, int n_threads, uint32_t slice) {
+  CountMinSketch* cms = op->cms;
+  CellUpdate* scratch = op->scratch[tid];
+  CellUpdate* part = op->part[tid];
+  size_t* offsets = op->offsets[tid];
+
+  for (int o = 0; o <= n_threads; o++)
+    offsets[o] = 0;
+
+  // pass 1: hash and count the updates per owner
+  size_t k = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t key = runs ? runs[i].key : items[i];
+    uint32_t count = runs ? runs[i].count : 1;
+    for (uint32_t d = 0; d < cms->depth; d++) {
+      uint32_t col = cms_column(&cms->hashFunctions[d], key);
+      scratch[k].cell = d * cms->width + col;
+      scratch[k].count = count;
+      offsets[col / slice + 1]++;
+      k++;
+    }
+  }
+
+  // pass 2: prefix sums and scatter into the owner groups
+  for (int o = 0; o < n_threads; o++)
+    offsets[o + 1] += offsets[o];
+  size_t pos[n_threads];
+  for (int o = 0; o < n_threads; o++)
+    pos[o] = offsets[o];
+  for (size_t j = 0; j < k; j++) {
+    uint32_t col = scratch[j].cell % cms->width;
+    part[pos[col / slice]++] = scratch[j];
+  }
+}
+
+// the calling thread applies the updates of every thread addressed to its columns
+static void apply_owned(OwnerPartition* op, int tid, int n_threads) {
+  uint32_t* table = op->cms->table[0];
+  for (int t = 0; t < n_threads; t++) {
+    const CellUpdate* part = op->part[t];
+    for (size_t j = op->offsets[t][tid]; j < op->offsets[t][tid + 1]; j++)
+      table[part[j].cell] += part[j].count;
+  }
+}
+
+static void owner_update(OwnerPartition* op, const uint32_t* items, const ItemRun* runs, size_t n) {
+  int tid = omp_get_thread_num();
+  int n_threads = omp_get_num_threads();
+  uint32_t slice = (op->cms->width + n_threads - 1) / n_threads;
+
+  // static blocks, every thread runs the same number of rounds
+  size_t block = (n + n_threads - 1) / n_threads;
+  size_t lo = (size_t)tid * block < n ? (size_t)tid * block : n;
+  size_t hi = lo + block < n ? lo + block : n;
+  size_t batch = op->batch;
+  size_t rounds = (block + batch - 1) / batch;
+
+  uint32_t total = 0;
+  for (size_t r = 0; r < rounds; r++) {
+    size_t first = lo + r * batch;
+    size_t len = first < hi ? (hi - first < batch ? hi - first : batch) : 0;
+    for (size_t i = 0; i < len; i++)
+      total += runs ? runs[first + i].count : 1;
+
+    partition_batch(op, runs ? NULL : items + first, runs ? runs + first : NULL,
+                    len, tid, n_threads, slice);
+#pragma omp barrier
+    apply_owned(op, tid, n_threads);
+    // the buffers are refilled in the next round
+#pragma omp barrier
+  }
+
+#pragma omp atomic
+  op->cms->total += total;
+}
+
+void owner_update_items(OwnerPartition* op, const uint32_t* items, size_t n) {
+  if (n > 0)
+    owner_update(op, items, NULL, n);
+}
+
+void owner_update_runs(OwnerPartition* op, const ItemRun* runs, size_t n) {
+  if (n > 0)
+    owner_update(op, NULL, runs, n);
+}
@@ -0,0 +1,45 @@
+#ifndef CMS_OWNER_H
+#define CMS_OWNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_ingest.h"
+#include "cms_types.h"
+
+// Ownership-partitioned updates of a single shared sketch.
+// Thread t owns the same contiguous column slice of every row. Items are processed
+// in rounds: each thread hashes a batch of its items and radix-partitions the
+// resulting (cell, count) updates by owner, then after a barrier every owner applies
+// the updates addressed to it from all the threads. No atomics and no private
+// copies: one sketch per process, every cell written by a single thread.
+
+#define OWNER_BATCH 8192  // items hashed per thread and round
+
+typedef struct {
+  uint32_t cell;   // flat index into table[0]
+  uint32_t count;
+} CellUpdate;
+
+typedef struct {
+  CountMinSketch* cms;  // contiguous table
+  int max_threads;
+  size_t batch;         // items hashed per thread and round
+  CellUpdate** part;    // per thread, updates grouped by owner
+  CellUpdate** scratch; // per thread, updates in input order
+  size_t** offsets;     // per thread, start of each owner's group (max_threads + 1)
+} OwnerPartition;
+
+// allocate the buffers for up to max_threads threads, returns 0 on success
+int owner_init(OwnerPartition* op, CountMinSketch* cms, int max_threads);
+// same with rounds of batch items instead of OWNER_BATCH
+int owner_init_batch(OwnerPartition* op, CountMinSketch* cms, int max_threads, size_t batch);
+
+// must be called by every thread of the enclosing parallel region,
+// each one gets a static block of the input
+void owner_update_items(OwnerPartition* op, const uint32_t* items, size_t n);
+void owner_update_runs(OwnerPartition* op, const ItemRun* runs, size_t n);
+
+void owner_free(OwnerPartition* op);
+
+#endif  // CMS_OWNER_H
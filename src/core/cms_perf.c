@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include "cms_perf.h"
+
+#ifdef CMS_PERF
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const char* EVENT_NAMES[PERF_N_EVENTS] = {"cycles", "instructions", "LLC misses", "dTLB misses",
+                                                 "stalled cycles"};
+
+#define CACHE_READ_MISS(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// counter of the calling thread on any CPU, user space only, -1 if refused
+static int open_event(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // the kernel may multiplex the counters: the times let us scale the readings
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters perf_begin(void) {
+  PerfCounters pc;
+  pc.fd[PERF_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  pc.fd[PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  pc.fd[PERF_LLC_MISSES] = open_event(PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL));
+  if (pc.fd[PERF_LLC_MISSES] < 0)
+    pc.fd[PERF_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  pc.fd[PERF_DTLB_MISSES] = open_event(PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB));
+  pc.fd[PERF_STALLED_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+  if (pc.fd[PERF_STALLED_CYCLES] < 0)
+    pc.fd[PERF_STALLED_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND);
+
+  for (int e = 0; e < PERF_N_EVENTS; e++) {
+    if (pc.fd[e] >= 0) {
+      ioctl(pc.fd[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(pc.fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  return pc;
+}
+
+void perf_end(PerfCounters* pc, PerfPhase* phase) {
+  uint64_t missing = 0;
+  for (int e = 0; e < PERF_N_EVENTS; e++) {
+    if (pc->fd[e] < 0) {
+      missing |= 1u << e;
+      continue;
+    }
+    ioctl(pc->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t v[3];  // value, time enabled, time running
+    if (read(pc->fd[e], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0) {
+      uint64_t scaled = v[2] < v[1] ? (uint64_t)((double)v[0] * v[1] / v[2]) : v[0];
+      __atomic_fetch_add(&phase->count[e], scaled, __ATOMIC_RELAXED);
+    } else {
+      missing |= 1u << e;
+    }
+    close(pc->fd[e]);
+    pc->fd[e] = -1;
+  }
+  __atomic_fetch_or(&phase->missing, missing, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&phase->threads, 1, __ATOMIC_RELAXED);
+}
+
+void perf_print(const char* name, const PerfPhase* phase, uint64_t items) {
+  if (phase->threads == 0)
+    return;
+  int has[PERF_N_EVENTS];
+  for (int e = 0; e < PERF_N_EVENTS; e++)
+    has[e] = !(phase->missing & (1u << e));
+
+  printf("PERF %s (%llu threads):", name, (unsigned long long)phase->threads);
+  for (int e = 0; e < PERF_N_EVENTS; e++) {
+    const char* sep = e + 1 < PERF_N_EVENTS ? "," : "";
+    if (has[e])
+      printf(" %s %.3e%s", EVENT_NAMES[e], (double)phase->count[e], sep);
+    else
+      printf(" %s n/a%s", EVENT_NAMES[e], sep);
+  }
+  printf("\n");
+
+  const uint64_t* c = phase->count;
+  printf("PERF %s derived:", name);
+  if (has[PERF_CYCLES] && has[PERF_INSTRUCTIONS] && c[PERF_CYCLES] > 0)
+    printf(" IPC %.2f", (double)c[PERF_INSTRUCTIONS] / c[PERF_CYCLES]);
+  else
+    printf(" IPC n/a");
+  if (has[PERF_STALLED_CYCLES] && has[PERF_CYCLES] && c[PERF_CYCLES] > 0)
+    printf(", stalled %.1f%%", 100.0 * c[PERF_STALLED_CYCLES] / c[PERF_CYCLES]);
+  if (items > 0) {
+    if (has[PERF_CYCLES])
+      printf(", cycles/item %.2f", (double)c[PERF_CYCLES] / items);
+    if (has[PERF_LLC_MISSES])
+      printf(", LLC misses/item %.4f", (double)c[PERF_LLC_MISSES] / items);
+    if (has[PERF_DTLB_MISSES])
+      printf(", dTLB misses/item %.4f", (double)c[PERF_DTLB_MISSES] / items);
+  }
+  printf("\n");
+}
+#endif
@@ -0,0 +1,79 @@
+#ifndef CMS_PERF_H
+#define CMS_PERF_H
+
+#include <stdint.h>
+
+// Hardware performance counters per phase (perf_event_open).
+// Compiled in only with -DCMS_PERF (make PERF=1): otherwise every call below is
+// an empty inline function and the drivers carry no instrumentation at all.
+// Each thread opens its own counters around its part of a phase and adds the
+// readings into the shared PerfPhase; perf_reduce sums the phases of every rank.
+// Events the CPU or the kernel (perf_event_paranoid) refuses are reported as n/a.
+
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  PERF_STALLED_CYCLES,  // backend stalls, frontend when the backend event is missing
+  PERF_N_EVENTS,
+} PerfEvent;
+
+// readings of a phase, summed over threads (and ranks after perf_reduce)
+typedef struct {
+  uint64_t count[PERF_N_EVENTS];
+  uint64_t threads;  // threads that measured the phase
+  uint64_t missing;  // bit e set if event e could not be counted on some thread
+} PerfPhase;
+
+// counters of the calling thread, between perf_begin and perf_end
+typedef struct {
+  int fd[PERF_N_EVENTS];
+} PerfCounters;
+
+#ifdef CMS_PERF
+#define PERF_ENABLED 1
+
+// open, reset and start the counters of the calling thread
+PerfCounters perf_begin(void);
+// stop them and add the readings into phase (safe from concurrent threads)
+void perf_end(PerfCounters* pc, PerfPhase* phase);
+// phase totals and derived metrics (IPC, misses per item), items may be 0
+void perf_print(const char* name, const PerfPhase* phase, uint64_t items);
+
+#else
+#define PERF_ENABLED 0
+
+static inline PerfCounters perf_begin(void) {
+  PerfCounters pc = {{0}};
+  return pc;
+}
+static inline void perf_end(PerfCounters* pc, PerfPhase* phase) {
+  (void)pc;
+  (void)phase;
+}
+static inline void perf_print(const char* name, const PerfPhase* phase, uint64_t items) {
+  (void)name;
+  (void)phase;
+  (void)items;
+}
+#endif
+
+// MPI drivers: sum the phase of every rank of comm on rank 0
+#ifdef MPI_VERSION
+static inline void perf_reduce(PerfPhase* phase, MPI_Comm comm) {
+#ifdef CMS_PERF
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : phase->count, phase->count, PERF_N_EVENTS, MPI_UINT64_T,
+             MPI_SUM, 0, comm);
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &phase->threads, &phase->threads, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &phase->missing, &phase->missing, 1, MPI_UINT64_T, MPI_BOR, 0, comm);
+#else
+  (void)phase;
+  (void)comm;
+#endif
+}
+#endif
+
+#endif  // CMS_PERF_H
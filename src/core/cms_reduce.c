@@ -0,0 +1,472 @@
+#include "cms_reduce.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cms_alloc.h"
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) {
+  return a < b ? a : b;
+}
+
+// MPI counts are int: larger buffers are combined in INT_MAX sized pieces
+static void allreduce_in_place(uint32_t* buf, size_t count, MPI_Op op, MPI_Comm comm) {
+  for (size_t done = 0; done < count; done += INT_MAX) {
+    int n = (count - done) > INT_MAX ? INT_MAX : (int)(count - done);
+    MPI_Allreduce(MPI_IN_PLACE, buf + done, n, MPI_UINT32_T, op, comm);
+  }
+}
+
+static void reduce_in_place(uint32_t* buf, size_t count, int rank, MPI_Comm comm) {
+  for (size_t done = 0; done < count; done += INT_MAX) {
+    int n = (count - done) > INT_MAX ? INT_MAX : (int)(count - done);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : buf + done, buf + done, n,
+               MPI_UINT32_T, MPI_SUM, 0, comm);
+  }
+}
+
+// make dst a sketch with the parameters and hashes of src whose rows are views into block
+static int sketch_over_block(CountMinSketch* dst, const CountMinSketch* src, uint32_t* block, uint32_t width) {
+  dst->depth = src->depth;
+  dst->width = width;
+  dst->total = 0;
+  dst->epsilon = src->epsilon;
+  dst->delta = src->delta;
+  dst->hashFunctions = malloc(src->depth * sizeof(UniversalHash));
+  dst->table = malloc(src->depth * sizeof(uint32_t*));
+  if (!dst->hashFunctions || !dst->table)
+    return -1;
+  memcpy(dst->hashFunctions, src->hashFunctions, src->depth * sizeof(UniversalHash));
+  for (uint32_t d = 0; d < src->depth; d++)
+    dst->table[d] = block + (size_t)d * width;
+  return 0;
+}
+
+// every rank gets `slice` columns of each row plus a copy of the summed metadata,
+// the last slices are zero padded (send is zeroed) so that all blocks have the same size
+static void pack_scatter_blocks(uint32_t* send, const CountMinSketch* local, const uint32_t* meta, int n_meta,
+                                int size, uint32_t slice, size_t block) {
+  for (int r = 0; r < size; r++) {
+    uint32_t* dst = send + (size_t)r * block;
+    uint32_t first = min_u32((uint32_t)r * slice, local->width);
+    uint32_t last = min_u32(first + slice, local->width);
+    for (uint32_t d = 0; d < local->depth; d++)
+      memcpy(dst + (size_t)d * slice, local->table[d] + first, (last - first) * sizeof(uint32_t));
+    dst[(size_t)local->depth * slice] = local->total;
+    memcpy(dst + (size_t)local->depth * slice + 1, meta, n_meta * sizeof(uint32_t));
+  }
+}
+
+// turn the received block into the owned slice of the global sketch
+static int scatter_result(const CountMinSketch* local, ReducedSketch* out, uint32_t* recv,
+                          uint32_t* meta, int n_meta, int rank, uint32_t slice) {
+  out->col_start = min_u32((uint32_t)rank * slice, local->width);
+  out->col_end = min_u32(out->col_start + slice, local->width);
+  out->has_table = 1;
+  if (sketch_over_block(&out->cms, local, recv, slice) != 0)
+    return -1;
+  out->cms.total = recv[(size_t)local->depth * slice];
+  memcpy(meta, recv + (size_t)local->depth * slice + 1, n_meta * sizeof(uint32_t));
+  return 0;
+}
+
+static int reduce_scatter(const CountMinSketch* local, ReducedSketch* out, uint32_t* meta, int n_meta,
+                          int rank, int size, MPI_Comm comm) {
+  uint32_t slice = (local->width + size - 1) / size;
+  size_t block = (size_t)local->depth * slice + 1 + n_meta;
+  if (block > INT_MAX)
+    return -1;
+
+  uint32_t* send = calloc(block * size, sizeof(uint32_t));
+  uint32_t* recv = cms_buffer_alloc(block * sizeof(uint32_t));
+  if (!send || !recv) {
+    free(send);
+    cms_buffer_free(recv);
+    return -1;
+  }
+  pack_scatter_blocks(send, local, meta, n_meta, size, slice, block);
+
+  MPI_Reduce_scatter_block(send, recv, (int)block, MPI_UINT32_T, MPI_SUM, comm);
+  free(send);
+  return scatter_result(local, out, recv, meta, n_meta, rank, slice);
+}
+
+// [ table | total | meta ] in one buffer
+static uint32_t* pack_flat(const CountMinSketch* local, const uint32_t* meta, int n_meta) {
+  size_t cells = (size_t)local->depth * local->width;
+  uint32_t* buf = cms_buffer_alloc((cells + 1 + n_meta) * sizeof(uint32_t));
+  if (!buf)
+    return NULL;
+  memcpy(buf, local->table[0], cells * sizeof(uint32_t));
+  buf[cells] = local->total;
+  memcpy(buf + cells + 1, meta, n_meta * sizeof(uint32_t));
+  return buf;
+}
+
+// the reduced buffer becomes the table of the global sketch, no extra copy
+static int flat_result(const CountMinSketch* local, ReducedSketch* out, uint32_t* buf,
+                       uint32_t* meta, int n_meta, int rank) {
+  size_t cells = (size_t)local->depth * local->width;
+  out->has_table = (out->strategy == CMS_REDUCE_ALL || rank == 0);
+  if (!out->has_table) {
+    cms_buffer_free(buf);
+    return 0;
+  }
+  out->col_start = 0;
+  out->col_end = local->width;
+  if (sketch_over_block(&out->cms, local, buf, local->width) != 0)
+    return -1;
+  out->cms.total = buf[cells];
+  memcpy(meta, buf + cells + 1, n_meta * sizeof(uint32_t));
+  return 0;
+}
+
+static void reduced_init(ReducedSketch* out, CmsReduceStrategy strategy, MPI_Comm comm) {
+  memset(out, 0, sizeof(*out));
+  out->strategy = strategy;
+  out->comm = comm;
+  out->win = MPI_WIN_NULL;
+}
+
+int cms_reduce(const CountMinSketch* local, ReducedSketch* out, uint32_t* meta, int n_meta,
+               CmsReduceStrategy strategy, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  reduced_init(out, strategy, comm);
+
+  if (strategy == CMS_REDUCE_SCATTER)
+    return reduce_scatter(local, out, meta, n_meta, rank, size, comm);
+
+  uint32_t* buf = pack_flat(local, meta, n_meta);
+  if (!buf)
+    return -1;
+  size_t count = (size_t)local->depth * local->width + 1 + n_meta;
+  if (strategy == CMS_REDUCE_ALL)
+    allreduce_in_place(buf, count, MPI_SUM, comm);
+  else
+    reduce_in_place(buf, count, rank, comm);
+  return flat_result(local, out, buf, meta, n_meta, rank);
+}
+
+int cms_ireduce_begin(const CountMinSketch* local, int n_meta, CmsReduceStrategy strategy, int segments,
+                      MPI_Comm comm, PendingReduce* p) {
+  int size;
+  memset(p, 0, sizeof(*p));
+  MPI_Comm_rank(comm, &p->rank);
+  MPI_Comm_size(comm, &size);
+  p->local = local;
+  p->n_meta = n_meta;
+  p->strategy = strategy;
+  p->comm = comm;
+
+  if (strategy == CMS_REDUCE_SCATTER) {
+    // a single non-blocking reduce-scatter, the blocks are already one per rank
+    p->slice = (local->width + size - 1) / size;
+    size_t block = (size_t)local->depth * p->slice + 1 + n_meta;
+    if (block > INT_MAX)
+      return -1;
+    p->count = block;
+    p->seg = block;
+    p->buf = calloc(block * size, sizeof(uint32_t));
+    p->recv = cms_buffer_alloc(block * sizeof(uint32_t));
+    p->n_reqs = 1;
+  } else {
+    // one collective per segment of the packed buffer, each at most INT_MAX cells
+    p->count = (size_t)local->depth * local->width + 1 + n_meta;
+    size_t n_seg = segments > 0 ? (size_t)segments : 1;
+    if (n_seg > p->count)
+      n_seg = p->count;
+    p->seg = (p->count + n_seg - 1) / n_seg;
+    if (p->seg > INT_MAX)
+      p->seg = INT_MAX;
+    p->n_reqs = (int)((p->count + p->seg - 1) / p->seg);
+    p->buf = cms_buffer_alloc(p->count * sizeof(uint32_t));
+  }
+  p->reqs = malloc(p->n_reqs * sizeof(MPI_Request));
+  if (!p->buf || (strategy == CMS_REDUCE_SCATTER && !p->recv) || !p->reqs)
+    return -1;
+  // not posted yet: MPI_Testall takes them as complete
+  for (int s = 0; s < p->n_reqs; s++)
+    p->reqs[s] = MPI_REQUEST_NULL;
+  return 0;
+}
+
+void cms_ireduce_post(PendingReduce* p, uint32_t rows, const uint32_t* meta) {
+  const CountMinSketch* local = p->local;
+  size_t cells = (size_t)local->depth * local->width;
+  int last = rows >= local->depth;
+
+  if (p->strategy == CMS_REDUCE_SCATTER) {
+    if (!last || p->posted > 0)
+      return;
+    int size;
+    MPI_Comm_size(p->comm, &size);
+    pack_scatter_blocks(p->buf, local, meta, p->n_meta, size, p->slice, p->count);
+    p->t_first_post = MPI_Wtime();
+    MPI_Ireduce_scatter_block(p->buf, p->recv, (int)p->count, MPI_UINT32_T, MPI_SUM, p->comm, p->reqs);
+    p->posted = 1;
+    return;
+  }
+
+  // segments are posted in order, a segment once all its cells are final
+  size_t ready = last ? p->count : (size_t)rows * local->width;
+  while (p->posted < p->n_reqs) {
+    size_t lo = (size_t)p->posted * p->seg;
+    size_t hi = lo + p->seg < p->count ? lo + p->seg : p->count;
+    if (hi > ready)
+      break;
+    if (lo < cells)
+      memcpy(p->buf + lo, local->table[0] + lo, ((hi < cells ? hi : cells) - lo) * sizeof(uint32_t));
+    if (hi > cells) {
+      p->buf[cells] = local->total;
+      memcpy(p->buf + cells + 1, meta, p->n_meta * sizeof(uint32_t));
+    }
+    if (p->posted == 0)
+      p->t_first_post = MPI_Wtime();
+    uint32_t* part = p->buf + lo;
+    int n = (int)(hi - lo);
+    if (p->strategy == CMS_REDUCE_ALL)
+      MPI_Iallreduce(MPI_IN_PLACE, part, n, MPI_UINT32_T, MPI_SUM, p->comm, &p->reqs[p->posted]);
+    else
+      MPI_Ireduce(p->rank == 0 ? MPI_IN_PLACE : part, part, n, MPI_UINT32_T, MPI_SUM, 0, p->comm,
+                  &p->reqs[p->posted]);
+    p->posted++;
+  }
+  if (!last)
+    p->early = p->posted;
+}
+
+int cms_ireduce(const CountMinSketch* local, const uint32_t* meta, int n_meta,
+                CmsReduceStrategy strategy, int segments, MPI_Comm comm, PendingReduce* p) {
+  if (cms_ireduce_begin(local, n_meta, strategy, segments, comm, p) != 0)
+    return -1;
+  cms_ireduce_post(p, local->depth, meta);
+  return 0;
+}
+
+int cms_ireduce_test(PendingReduce* p) {
+  int done;
+  MPI_Testall(p->n_reqs, p->reqs, &done, MPI_STATUSES_IGNORE);
+  return done;
+}
+
+int cms_ireduce_wait(PendingReduce* p, ReducedSketch* out, uint32_t* meta) {
+  MPI_Waitall(p->n_reqs, p->reqs, MPI_STATUSES_IGNORE);
+  free(p->reqs);
+  p->reqs = NULL;
+  reduced_init(out, p->strategy, p->comm);
+
+  if (p->strategy == CMS_REDUCE_SCATTER) {
+    free(p->buf);
+    return scatter_result(p->local, out, p->recv, meta, p->n_meta, p->rank, p->slice);
+  }
+  return flat_result(p->local, out, p->buf, meta, p->n_meta, p->rank);
+}
+
+// make stores to the shared window visible to the other ranks of the node
+static void node_sync(MPI_Win win, MPI_Comm node_comm) {
+  MPI_Win_sync(win);
+  MPI_Barrier(node_comm);
+  MPI_Win_sync(win);
+}
+
+// segment of a rank of the node in a shared window
+static uint32_t* shared_segment(MPI_Win win, int node_rank) {
+  MPI_Aint size;
+  int disp_unit;
+  uint32_t* base;
+  MPI_Win_shared_query(win, node_rank, &size, &disp_unit, &base);
+  return base;
+}
+
+int cms_reduce_hierarchical(const CountMinSketch* local, ReducedSketch* out, uint32_t* meta, int n_meta,
+                            CmsReduceStrategy strategy, MPI_Comm comm) {
+  int rank, node_rank, node_size;
+  MPI_Comm node_comm, leader_comm;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+  // ordered by rank, so rank 0 of comm is the leader of its node and of leader_comm
+  MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+
+  reduced_init(out, strategy, comm);
+
+  size_t cells = (size_t)local->depth * local->width;
+  size_t count = cells + 1 + n_meta;
+  MPI_Aint bytes = (MPI_Aint)(count * sizeof(uint32_t));
+
+  // staging: every rank publishes its packed [ table | total | meta ],
+  // the node sketch is a single buffer owned by the leader
+  uint32_t *mine, *node_buf;
+  MPI_Win stage_win, win;
+  MPI_Win_allocate_shared(bytes, sizeof(uint32_t), MPI_INFO_NULL, node_comm, &mine, &stage_win);
+  MPI_Win_allocate_shared(node_rank == 0 ? bytes : 0, sizeof(uint32_t), MPI_INFO_NULL, node_comm, &node_buf, &win);
+  node_buf = shared_segment(win, 0);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, stage_win);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+  memcpy(mine, local->table[0], cells * sizeof(uint32_t));
+  mine[cells] = local->total;
+  memcpy(mine + cells + 1, meta, n_meta * sizeof(uint32_t));
+  node_sync(stage_win, node_comm);
+
+  // each rank sums its slice of the buffer over all the ranks of the node
+  size_t lo = count * node_rank / node_size;
+  size_t hi = count * (node_rank + 1) / node_size;
+  memcpy(node_buf + lo, shared_segment(stage_win, 0) + lo, (hi - lo) * sizeof(uint32_t));
+  for (int r = 1; r < node_size; r++) {
+    const uint32_t* seg = shared_segment(stage_win, r);
+    for (size_t i = lo; i < hi; i++)
+      node_buf[i] += seg[i];
+  }
+  node_sync(win, node_comm);
+  MPI_Win_unlock_all(stage_win);
+  MPI_Win_free(&stage_win);
+
+  int status = 0;
+  if (leader_comm != MPI_COMM_NULL) {
+    int leader_rank, n_leaders;
+    MPI_Comm_rank(leader_comm, &leader_rank);
+    MPI_Comm_size(leader_comm, &n_leaders);
+    if (strategy == CMS_REDUCE_SCATTER) {
+      // the leaders keep column slices in private memory, the other ranks own none
+      CountMinSketch node_cms;
+      status = sketch_over_block(&node_cms, local, node_buf, local->width);
+      if (status == 0) {
+        node_cms.total = node_buf[cells];
+        memcpy(meta, node_buf + cells + 1, n_meta * sizeof(uint32_t));
+        status = reduce_scatter(&node_cms, out, meta, n_meta, leader_rank, n_leaders, leader_comm);
+        memcpy(node_buf + cells + 1, meta, n_meta * sizeof(uint32_t));
+      }
+      free(node_cms.table);
+      free(node_cms.hashFunctions);
+    } else if (strategy == CMS_REDUCE_ALL) {
+      allreduce_in_place(node_buf, count, MPI_SUM, leader_comm);
+    } else {
+      reduce_in_place(node_buf, count, leader_rank, leader_comm);
+    }
+    MPI_Comm_free(&leader_comm);
+  }
+  node_sync(win, node_comm);
+  MPI_Comm_free(&node_comm);
+
+  if (strategy == CMS_REDUCE_SCATTER) {
+    memcpy(meta, node_buf + cells + 1, n_meta * sizeof(uint32_t));
+    out->cms.depth = local->depth;
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+    return status;
+  }
+
+  // the global sketch stays in the window, shared by the ranks of the node
+  out->win = win;
+  out->has_table = (strategy == CMS_REDUCE_ALL || rank == 0);
+  if (!out->has_table)
+    return status;
+  out->col_start = 0;
+  out->col_end = local->width;
+  if (sketch_over_block(&out->cms, local, node_buf, local->width) != 0)
+    return -1;
+  out->cms.total = node_buf[cells];
+  memcpy(meta, node_buf + cells + 1, n_meta * sizeof(uint32_t));
+  return status;
+}
+
+// min over the rows whose column is owned by this rank, UINT_MAX if none
+static uint32_t partial_point_query(const ReducedSketch* rs, uint32_t item) {
+  uint32_t min_count = UINT_MAX;
+  if (rs->col_start == rs->col_end)
+    return min_count;
+  for (uint32_t d = 0; d < rs->cms.depth; d++) {
+    uint32_t col = cms_column(&rs->cms.hashFunctions[d], item);
+    if (col >= rs->col_start && col < rs->col_end) {
+      uint32_t v = rs->cms.table[d][col - rs->col_start];
+      if (v < min_count)
+        min_count = v;
+    }
+  }
+  return min_count;
+}
+
+uint32_t reduced_point_query(const ReducedSketch* rs, uint32_t item) {
+  if (rs->strategy == CMS_REDUCE_SCATTER) {
+    uint32_t partial = partial_point_query(rs, item);
+    allreduce_in_place(&partial, 1, MPI_MIN, rs->comm);
+    return partial;
+  }
+  return rs->has_table ? partial_point_query(rs, item) : 0;
+}
+
+void reduced_point_query_batch(const ReducedSketch* rs, const uint32_t* items, uint32_t n, uint32_t* out) {
+  if (!rs->has_table && rs->strategy != CMS_REDUCE_SCATTER) {
+    memset(out, 0, n * sizeof(uint32_t));
+    return;
+  }
+  for (uint32_t i = 0; i < n; i++)
+    out[i] = partial_point_query(rs, items[i]);
+  if (rs->strategy == CMS_REDUCE_SCATTER)
+    allreduce_in_place(out, n, MPI_MIN, rs->comm);
+}
+
+uint32_t reduced_range_query(const ReducedSketch* rs, int start, int end) {
+  if (end < start)
+    return 0;
+  uint32_t n = (uint32_t)(end - start) + 1;
+  uint32_t* items = malloc(n * sizeof(uint32_t));
+  uint32_t* est = malloc(n * sizeof(uint32_t));
+  for (uint32_t i = 0; i < n; i++)
+    items[i] = (uint32_t)(start + (int)i);
+
+  // one collective for the whole range
+  reduced_point_query_batch(rs, items, n, est);
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < n; i++)
+    total += est[i];
+
+  free(items);
+  free(est);
+  return total;
+}
+
+uint32_t reduced_inner_product(const ReducedSketch* a, const ReducedSketch* b) {
+  if (a->cms.depth != b->cms.depth || a->cms.width != b->cms.width)
+    return 0;
+  if (!a->has_table && a->strategy != CMS_REDUCE_SCATTER)
+    return 0;
+
+  uint32_t depth = a->cms.depth;
+  uint32_t* row_dot = calloc(depth, sizeof(uint32_t));
+  for (uint32_t d = 0; d < depth; d++)
+    for (uint32_t w = 0; w < a->col_end - a->col_start; w++)
+      row_dot[d] += a->cms.table[d][w] * b->cms.table[d][w];
+
+  // the partial row products of the slices add up to the full ones
+  if (a->strategy == CMS_REDUCE_SCATTER)
+    allreduce_in_place(row_dot, depth, MPI_SUM, a->comm);
+
+  uint32_t result = UINT_MAX;
+  for (uint32_t d = 0; d < depth; d++)
+    if (row_dot[d] < result)
+      result = row_dot[d];
+  free(row_dot);
+  return result;
+}
+
+void reduced_free(ReducedSketch* rs) {
+  if (rs->has_table) {
+    if (rs->win == MPI_WIN_NULL)
+      cms_buffer_free(rs->cms.table[0]);
+    free(rs->cms.table);
+    free(rs->cms.hashFunctions);
+    rs->cms.table = NULL;
+    rs->cms.hashFunctions = NULL;
+    rs->has_table = 0;
+  }
+  if (rs->win != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(rs->win);
+    MPI_Win_free(&rs->win);
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef CMS_REDUCE_H
+#define CMS_REDUCE_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+#include "cms_options.h"
+#include "cms_types.h"
+
+// Reduction of the per-rank sketches.
+// The flat table, the total and a few extra counters (e.g. the ground truth of
+// the test items) are packed in one buffer and summed with a single collective
+// instead of one MPI_Reduce per row plus one per counter.
+
+typedef struct {
+  CountMinSketch cms;  // reduced sketch, only the owned columns with CMS_REDUCE_SCATTER
+  uint32_t col_start;  // first owned column
+  uint32_t col_end;    // one past the last owned column
+  int has_table;       // 0 on the ranks that received nothing (non-root with CMS_REDUCE_ROOT)
+  CmsReduceStrategy strategy;
+  MPI_Comm comm;
+  MPI_Win win;  // node-shared window holding the table (hierarchical mode), MPI_WIN_NULL otherwise
+} ReducedSketch;
+
+// sum the local sketches and the n_meta counters of every rank of comm
+// meta is overwritten with the global sums on the ranks that have the table
+// (with CMS_REDUCE_SCATTER every rank gets them), returns 0 on success
+int cms_reduce(const CountMinSketch* local, ReducedSketch* out, uint32_t* meta, int n_meta,
+               CmsReduceStrategy strategy, MPI_Comm comm);
+
+// two level reduction for many ranks per node:
+// the ranks of a node sum their sketches into one node-shared sketch
+// (MPI_Win_allocate_shared), each rank adding up a slice of the columns, then only
+// the node leaders run the strategy over the network, so the inter-node traffic
+// scales with the number of nodes instead of the number of ranks.
+// With CMS_REDUCE_ALL every rank of a node reads the same shared copy.
+// Collective over comm, same semantics as cms_reduce
+int cms_reduce_hierarchical(const CountMinSketch* local, ReducedSketch* out, uint32_t* meta, int n_meta,
+                            CmsReduceStrategy strategy, MPI_Comm comm);
+
+// Pipelined variant: the packed buffer is split in segments and a non-blocking
+// MPI_Ireduce/MPI_Iallreduce is posted for each one without waiting for the other
+// ranks. A segment can be posted as soon as its cells are final: a driver that
+// completes its sketch one row at a time posts the segments of a row with
+// cms_ireduce_post and keeps updating the next rows while they progress, calling
+// cms_ireduce_test now and then. CMS_REDUCE_SCATTER blocks hold columns of every
+// row, so its single MPI_Ireduce_scatter_block is posted with the last row.
+#define IREDUCE_PROGRESS_EVERY 65536  // updates between two cms_ireduce_test calls
+
+typedef struct {
+  uint32_t* buf;   // packed send buffer, reduced in place for reduce/allreduce
+  uint32_t* recv;  // owned block with CMS_REDUCE_SCATTER
+  MPI_Request* reqs;
+  int n_reqs;
+  int posted;      // segments posted so far, in order on every rank
+  int early;       // segments posted before the last row was final
+  double t_first_post;
+  size_t count;    // cells of the packed buffer (one block with CMS_REDUCE_SCATTER)
+  size_t seg;      // cells per segment
+  int n_meta;
+  int rank;
+  uint32_t slice;
+  CmsReduceStrategy strategy;
+  MPI_Comm comm;
+  const CountMinSketch* local;  // must stay alive until cms_ireduce_wait
+} PendingReduce;
+
+// set up the segments of local (its shape and n_meta counters), nothing is posted yet
+int cms_ireduce_begin(const CountMinSketch* local, int n_meta, CmsReduceStrategy strategy, int segments,
+                      MPI_Comm comm, PendingReduce* p);
+// post every segment lying in the first rows rows of local, which must be final; with
+// rows == depth the rest, total and meta (copied) included. Called in the same order on every rank
+void cms_ireduce_post(PendingReduce* p, uint32_t rows, const uint32_t* meta);
+// begin and post everything: local is final, meta is copied so it can change afterwards
+int cms_ireduce(const CountMinSketch* local, const uint32_t* meta, int n_meta,
+                CmsReduceStrategy strategy, int segments, MPI_Comm comm, PendingReduce* p);
+// drive progress, returns nonzero once every posted segment is reduced
+int cms_ireduce_test(PendingReduce* p);
+// wait for the remaining segments and build the reduced sketch, as cms_reduce
+int cms_ireduce_wait(PendingReduce* p, ReducedSketch* out, uint32_t* meta);
+
+// queries on the reduced sketch
+// with CMS_REDUCE_SCATTER they are collective over comm, every rank gets the answer
+// otherwise they are local and return 0 on ranks without the table
+uint32_t reduced_point_query(const ReducedSketch* rs, uint32_t item);
+void reduced_point_query_batch(const ReducedSketch* rs, const uint32_t* items, uint32_t n, uint32_t* out);
+uint32_t reduced_range_query(const ReducedSketch* rs, int start, int end);
+uint32_t reduced_inner_product(const ReducedSketch* a, const ReducedSketch* b);
+
+// collective over the node when the sketch lives in a shared window
+void reduced_free(ReducedSketch* rs);
+
+#endif  // CMS_REDUCE_H
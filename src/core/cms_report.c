@@ -0,0 +1,109 @@
+#include "cms_report.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* PHASE_NAMES[REPORT_N_PHASES] = {"io", "update", "merge", "reduce"};
+
+int report_init(CmsReport* rep, const char* driver, const char* input, int rank, int threads) {
+  memset(rep, 0, sizeof(*rep));
+  rep->driver = driver;
+  rep->input = input;
+  rep->ranks = 1;
+  rep->threads = threads;
+  rep->n_workers = threads;
+  rep->workers = calloc(threads > 0 ? threads : 1, sizeof(ReportWorker));
+  if (!rep->workers)
+    return -1;
+  for (int t = 0; t < threads; t++) {
+    rep->workers[t].rank = rank;
+    rep->workers[t].thread = t;
+    for (int p = 0; p < REPORT_N_PHASES; p++)
+      rep->workers[t].time[p] = -1.0;
+  }
+  return 0;
+}
+
+void report_free(CmsReport* rep) {
+  free(rep->workers);
+  rep->workers = NULL;
+  rep->n_workers = 0;
+}
+
+void report_write_string(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; s && *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+int report_write(const CmsReport* rep, const char* path) {
+  int to_stdout = strcmp(path, "-") == 0;
+  FILE* f = to_stdout ? stdout : fopen(path, "a");
+  if (!f)
+    return -1;
+
+  uint64_t items = 0, bytes = 0;
+  for (int w = 0; w < rep->n_workers; w++) {
+    items += rep->workers[w].items;
+    bytes += rep->workers[w].bytes;
+  }
+
+  fprintf(f, "{\"driver\":");
+  report_write_string(f, rep->driver);
+  fprintf(f, ",\"input\":");
+  report_write_string(f, rep->input);
+  fprintf(f, ",\"ranks\":%d,\"threads\":%d,\"workers\":%d,\"wall\":%.9f", rep->ranks, rep->threads,
+          rep->n_workers, rep->wall);
+  fprintf(f, ",\"items\":%llu,\"bytes\":%llu,\"items_per_s\":%.1f", (unsigned long long)items,
+          (unsigned long long)bytes, rep->wall > 0 ? items / rep->wall : 0.0);
+
+  // statistics over the workers that took part in each phase
+  fprintf(f, ",\"phases\":{");
+  int first = 1;
+  for (int p = 0; p < REPORT_N_PHASES; p++) {
+    double min = 0, max = 0, sum = 0;
+    int n = 0;
+    for (int w = 0; w < rep->n_workers; w++) {
+      double t = rep->workers[w].time[p];
+      if (t < 0)
+        continue;
+      if (n == 0 || t < min) min = t;
+      if (n == 0 || t > max) max = t;
+      sum += t;
+      n++;
+    }
+    if (n == 0)
+      continue;
+    double mean = sum / n;
+    fprintf(f, "%s\"%s\":{\"workers\":%d,\"min\":%.9f,\"max\":%.9f,\"mean\":%.9f,\"imbalance\":%.4f}",
+            first ? "" : ",", PHASE_NAMES[p], n, min, max, mean, mean > 0 ? max / mean : 1.0);
+    first = 0;
+  }
+  fprintf(f, "}");
+
+  fprintf(f, ",\"per_worker\":[");
+  for (int w = 0; w < rep->n_workers; w++) {
+    const ReportWorker* wk = &rep->workers[w];
+    double update = wk->time[REPORT_UPDATE];
+    fprintf(f, "%s{\"rank\":%d,\"thread\":%d,\"items\":%llu,\"bytes\":%llu,\"items_per_s\":%.1f", w ? "," : "",
+            wk->rank, wk->thread, (unsigned long long)wk->items, (unsigned long long)wk->bytes,
+            update > 0 ? wk->items / update : 0.0);
+    for (int p = 0; p < REPORT_N_PHASES; p++)
+      if (wk->time[p] >= 0)
+        fprintf(f, ",\"%s\":%.9f", PHASE_NAMES[p], wk->time[p]);
+    fprintf(f, "}");
+  }
+  fprintf(f, "]}\n");
+
+  if (to_stdout)
+    return fflush(f) == 0 ? 0 : -1;
+  return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,96 @@
+#ifndef CMS_REPORT_H
+#define CMS_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Structured timing report (--report=FILE).
+// Every worker, a thread of a rank, times its own share of each phase without
+// a barrier in front, so a slow rank or thread shows up as a long phase of its
+// own. report_gather collects the workers of every rank on rank 0 and
+// report_write appends a single JSON line for the run: per phase min/max/mean
+// and the max/mean imbalance, per worker the phase times, items, bytes and
+// items/s over its update phase.
+
+typedef enum {
+  REPORT_IO,      // reading and parsing the input
+  REPORT_UPDATE,  // sketch updates (checkpoints included)
+  REPORT_MERGE,   // merge of the thread-private copies, barrier wait included
+  REPORT_REDUCE,  // MPI reduction of the rank sketches
+  REPORT_N_PHASES,
+} ReportPhase;
+
+typedef struct {
+  int rank;
+  int thread;
+  double time[REPORT_N_PHASES];  // seconds, < 0 if the worker took no part in the phase
+  uint64_t items;                // updates applied, run weights included
+  uint64_t bytes;                // input bytes read
+} ReportWorker;
+
+typedef struct {
+  const char* driver;
+  const char* input;
+  int ranks;
+  int threads;            // workers per rank
+  int n_workers;
+  ReportWorker* workers;  // the threads of this rank, those of every rank on rank 0 after report_gather
+  double wall;            // total run time, set by the driver
+} CmsReport;
+
+// threads workers of the given rank, every phase unset
+// returns 0 on success, -1 if out of memory
+int report_init(CmsReport* rep, const char* driver, const char* input, int rank, int threads);
+
+// add seconds to a phase of a worker (phases may be timed in several pieces)
+static inline void report_add(ReportWorker* w, ReportPhase phase, double seconds) {
+  w->time[phase] = (w->time[phase] < 0 ? 0 : w->time[phase]) + seconds;
+}
+
+// append the JSON record to path ("-" for stdout), returns 0 on success
+int report_write(const CmsReport* rep, const char* path);
+
+// JSON string with quotes and backslashes escaped, for the other JSON writers
+void report_write_string(FILE* f, const char* s);
+
+void report_free(CmsReport* rep);
+
+// MPI drivers: gather the workers of every rank of comm on rank 0, collective over comm
+#ifdef MPI_VERSION
+static inline void report_gather(CmsReport* rep, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // thread counts may differ between ranks
+  int bytes = rep->n_workers * (int)sizeof(ReportWorker);
+  int* counts = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+  int* displs = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+  MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+
+  ReportWorker* all = NULL;
+  int total = 0;
+  if (rank == 0) {
+    for (int r = 0; counts && displs && r < size; r++) {
+      displs[r] = total;
+      total += counts[r];
+    }
+    all = malloc(total > 0 ? (size_t)total : 1);
+  }
+  if (rank == 0 && (!counts || !displs || !all))
+    MPI_Abort(comm, 99);
+  MPI_Gatherv(rep->workers, bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, comm);
+
+  rep->ranks = size;
+  if (rank == 0) {
+    free(rep->workers);
+    rep->workers = all;
+    rep->n_workers = total / (int)sizeof(ReportWorker);
+  }
+  free(counts);
+  free(displs);
+}
+#endif
+
+#endif  // CMS_REPORT_H
@@ -0,0 +1,342 @@
+#include "cms_shard.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cms_alloc.h"
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) {
+  return a < b ? a : b;
+}
+
+static inline uint32_t owned_cols(const ShardedSketch* ss) {
+  return ss->col_end - ss->col_start;
+}
+
+int shard_init(ShardedSketch* ss, double epsilon, double delta, uint32_t prime,
+               CmsShardExchange exchange, MPI_Comm comm) {
+  memset(ss, 0, sizeof(*ss));
+  ss->cell_type = MPI_DATATYPE_NULL;
+  ss->win = MPI_WIN_NULL;
+  ss->exchange = exchange;
+  if (epsilon <= 0.0 || epsilon >= 1.0 || delta <= 0.0 || delta >= 1.0)
+    return -1;
+  // columns past the prime are never hit, and the width must fit a uint32
+  if (ceil(exp(1.0) / epsilon) > prime)
+    return -1;
+  ss->comm = comm;
+  MPI_Comm_rank(comm, &ss->rank);
+  MPI_Comm_size(comm, &ss->size);
+
+  // same dimensions as cms_init
+  ss->epsilon = epsilon;
+  ss->delta = delta;
+  ss->width = ceil(exp(1.0) / epsilon);
+  ss->depth = ceil(log(1 / delta));
+  ss->slice = (ss->width + ss->size - 1) / ss->size;
+  ss->col_start = min_u32((uint32_t)ss->rank * ss->slice, ss->width);
+  ss->col_end = min_u32(ss->col_start + ss->slice, ss->width);
+
+  if (exchange == CMS_SHARD_ACCUMULATE) {
+    // memory allocated by MPI can always be exposed (and may be registered with the NIC),
+    // one passive-target epoch covers the whole lifetime, closed in shard_free
+    if (MPI_Win_allocate(shard_local_bytes(ss), sizeof(uint32_t), MPI_INFO_NULL, comm,
+                         &ss->cells, &ss->win) != MPI_SUCCESS)
+      return -1;
+    memset(ss->cells, 0, shard_local_bytes(ss));
+    MPI_Win_lock_all(0, ss->win);
+  } else {
+    ss->cells = cms_buffer_alloc(((size_t)ss->depth * owned_cols(ss) + 1) * sizeof(uint32_t));
+  }
+  ss->hashFunctions = malloc(ss->depth * sizeof(UniversalHash));
+  if (!ss->cells || !ss->hashFunctions)
+    return -1;
+
+  // the hashes of universal_hash_init, drawn once and shared
+  if (ss->rank == 0) {
+    for (uint32_t d = 0; d < ss->depth; d++) {
+      ss->hashFunctions[d].prime = prime;
+      ss->hashFunctions[d].width = ss->width;
+      ss->hashFunctions[d].a = rand() % (prime - 1) + 1;
+      ss->hashFunctions[d].b = rand() % prime;
+    }
+  }
+  MPI_Bcast(ss->hashFunctions, ss->depth * sizeof(UniversalHash), MPI_BYTE, 0, comm);
+
+  MPI_Type_contiguous(3, MPI_UINT32_T, &ss->cell_type);
+  MPI_Type_commit(&ss->cell_type);
+  // the zeroed slices are in place before anyone accumulates into them
+  if (exchange == CMS_SHARD_ACCUMULATE)
+    MPI_Barrier(comm);
+  return 0;
+}
+
+// per-owner counts and displacements of the exchange, plus the receive buffer
+typedef struct {
+  int* send_counts;
+  int* send_displs;
+  int* recv_counts;
+  int* recv_displs;
+  int* cursor;
+  ShardCell* send;
+  ShardCell* recv;
+  size_t recv_cap;
+} Exchange;
+
+static int exchange_init(Exchange* ex, const ShardedSketch* ss) {
+  memset(ex, 0, sizeof(*ex));
+  ex->send_counts = malloc(5 * ss->size * sizeof(int));
+  ex->send = malloc((size_t)ss->depth * SHARD_BATCH * sizeof(ShardCell));
+  if (!ex->send_counts || !ex->send)
+    return -1;
+  ex->send_displs = ex->send_counts + ss->size;
+  ex->recv_counts = ex->send_displs + ss->size;
+  ex->recv_displs = ex->recv_counts + ss->size;
+  ex->cursor = ex->recv_displs + ss->size;
+  return 0;
+}
+
+static void exchange_free(Exchange* ex) {
+  free(ex->send_counts);
+  free(ex->send);
+  free(ex->recv);
+}
+
+// bucket the cells of items[lo, hi) by owner in ex->send, ex->send_displs[r] is
+// the first cell of owner r and ex->send_counts[r] their number
+static void bucket_cells(const ShardedSketch* ss, Exchange* ex, const uint32_t* keys, const ItemRun* runs,
+                         size_t lo, size_t hi) {
+  memset(ex->send_counts, 0, ss->size * sizeof(int));
+  for (size_t i = lo; i < hi; i++) {
+    uint32_t key = keys ? keys[i] : runs[i].key;
+    for (uint32_t d = 0; d < ss->depth; d++)
+      ex->send_counts[cms_column(&ss->hashFunctions[d], key) / ss->slice]++;
+  }
+  int offset = 0;
+  for (int r = 0; r < ss->size; r++) {
+    ex->send_displs[r] = offset;
+    ex->cursor[r] = offset;
+    offset += ex->send_counts[r];
+  }
+  for (size_t i = lo; i < hi; i++) {
+    uint32_t key = keys ? keys[i] : runs[i].key;
+    uint32_t count = keys ? 1 : runs[i].count;
+    for (uint32_t d = 0; d < ss->depth; d++) {
+      uint32_t col = cms_column(&ss->hashFunctions[d], key);
+      ShardCell* c = &ex->send[ex->cursor[col / ss->slice]++];
+      c->row = d;
+      c->col = col;
+      c->count = count;
+    }
+  }
+}
+
+// bucket the cells of items[lo, hi) and send them, the owners receive theirs in
+// ex->recv, returns the number received or -1 if out of memory
+static long exchange_cells(ShardedSketch* ss, Exchange* ex, const uint32_t* keys, const ItemRun* runs,
+                           size_t lo, size_t hi) {
+  bucket_cells(ss, ex, keys, runs, lo, hi);
+  MPI_Alltoall(ex->send_counts, 1, MPI_INT, ex->recv_counts, 1, MPI_INT, ss->comm);
+  size_t n_recv = 0;
+  for (int r = 0; r < ss->size; r++) {
+    ex->recv_displs[r] = (int)n_recv;
+    n_recv += ex->recv_counts[r];
+  }
+  if (n_recv > ex->recv_cap) {
+    ShardCell* tmp = realloc(ex->recv, n_recv * sizeof(ShardCell));
+    if (!tmp)
+      return -1;
+    ex->recv = tmp;
+    ex->recv_cap = n_recv;
+  }
+  MPI_Alltoallv(ex->send, ex->send_counts, ex->send_displs, ss->cell_type,
+                ex->recv, ex->recv_counts, ex->recv_displs, ss->cell_type, ss->comm);
+  return (long)n_recv;
+}
+
+// every rank runs as many rounds as the rank with the most items
+static size_t exchange_rounds(const ShardedSketch* ss, size_t n) {
+  unsigned long long rounds = (n + SHARD_BATCH - 1) / SHARD_BATCH;
+  MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, ss->comm);
+  return (size_t)rounds;
+}
+
+static int cmp_cells(const void* a, const void* b) {
+  const ShardCell* x = a;
+  const ShardCell* y = b;
+  if (x->row != y->row) return x->row < y->row ? -1 : 1;
+  return x->col < y->col ? -1 : x->col > y->col;
+}
+
+// one-sided update: per batch, the cells of each owner are sorted, equal cells are
+// summed and the rest go out in a single MPI_Accumulate through an hindexed datatype
+// (the target entries of an accumulate must not overlap)
+static int shard_accumulate(ShardedSketch* ss, const uint32_t* keys, const ItemRun* runs, size_t n) {
+  Exchange ex;
+  size_t max_cells = (size_t)ss->depth * SHARD_BATCH;
+  uint32_t* values = malloc(max_cells * sizeof(uint32_t));
+  MPI_Aint* displs = malloc(max_cells * sizeof(MPI_Aint));
+  int status = exchange_init(&ex, ss) == 0 && values && displs ? 0 : -1;
+
+  for (size_t lo = 0; status == 0 && lo < n; lo += SHARD_BATCH) {
+    size_t hi = lo + SHARD_BATCH < n ? lo + SHARD_BATCH : n;
+    bucket_cells(ss, &ex, keys, runs, lo, hi);
+
+    for (int r = 0; r < ss->size; r++) {
+      if (ex.send_counts[r] == 0)
+        continue;
+      ShardCell* cells = ex.send + ex.send_displs[r];
+      qsort(cells, ex.send_counts[r], sizeof(ShardCell), cmp_cells);
+
+      uint32_t first_col = (uint32_t)r * ss->slice;
+      uint32_t owned = min_u32(first_col + ss->slice, ss->width) - first_col;
+      uint32_t* v = values + ex.send_displs[r];
+      MPI_Aint* disp = displs + ex.send_displs[r];
+      int k = -1;
+      for (int c = 0; c < ex.send_counts[r]; c++) {
+        if (k >= 0 && cells[c].row == cells[c - 1].row && cells[c].col == cells[c - 1].col) {
+          v[k] += cells[c].count;
+          continue;
+        }
+        k++;
+        v[k] = cells[c].count;
+        disp[k] = ((MPI_Aint)cells[c].row * owned + (cells[c].col - first_col)) * sizeof(uint32_t);
+      }
+
+      MPI_Datatype target;
+      MPI_Type_create_hindexed_block(k + 1, 1, disp, MPI_UINT32_T, &target);
+      MPI_Type_commit(&target);
+      MPI_Accumulate(v, k + 1, MPI_UINT32_T, r, 0, 1, target, MPI_SUM, ss->win);
+      MPI_Type_free(&target);  // the pending accumulate keeps its own reference
+    }
+    // values and displs are reused by the next batch
+    MPI_Win_flush_all(ss->win);
+    for (size_t i = lo; i < hi; i++)
+      ss->total += keys ? 1 : runs[i].count;
+  }
+
+  free(values);
+  free(displs);
+  exchange_free(&ex);
+  if (status != 0)
+    return -1;
+  // every increment has landed once all the ranks are past their last flush
+  MPI_Barrier(ss->comm);
+  MPI_Win_sync(ss->win);
+  return 0;
+}
+
+static int shard_update(ShardedSketch* ss, const uint32_t* keys, const ItemRun* runs, size_t n) {
+  if (ss->exchange == CMS_SHARD_ACCUMULATE)
+    return shard_accumulate(ss, keys, runs, n);
+
+  Exchange ex;
+  if (exchange_init(&ex, ss) != 0) {
+    exchange_free(&ex);
+    return -1;
+  }
+  size_t rounds = exchange_rounds(ss, n);
+  uint32_t owned = owned_cols(ss);
+
+  for (size_t round = 0; round < rounds; round++) {
+    size_t lo = round * SHARD_BATCH < n ? round * SHARD_BATCH : n;
+    size_t hi = lo + SHARD_BATCH < n ? lo + SHARD_BATCH : n;
+    long n_recv = exchange_cells(ss, &ex, keys, runs, lo, hi);
+    if (n_recv < 0) {
+      exchange_free(&ex);
+      return -1;
+    }
+    for (long k = 0; k < n_recv; k++) {
+      const ShardCell* c = &ex.recv[k];
+      ss->cells[(size_t)c->row * owned + (c->col - ss->col_start)] += c->count;
+    }
+    for (size_t i = lo; i < hi; i++)
+      ss->total += keys ? 1 : runs[i].count;
+  }
+  exchange_free(&ex);
+  return 0;
+}
+
+int shard_update_items(ShardedSketch* ss, const uint32_t* items, size_t n) {
+  return shard_update(ss, items, NULL, n);
+}
+
+int shard_update_runs(ShardedSketch* ss, const ItemRun* runs, size_t n) {
+  return shard_update(ss, NULL, runs, n);
+}
+
+int shard_query_batch(ShardedSketch* ss, const uint32_t* items, size_t n, uint32_t* out) {
+  Exchange ex;
+  ShardCell* replies = malloc((size_t)ss->depth * SHARD_BATCH * sizeof(ShardCell));
+  if (exchange_init(&ex, ss) != 0 || !replies) {
+    free(replies);
+    exchange_free(&ex);
+    return -1;
+  }
+  size_t rounds = exchange_rounds(ss, n);
+  uint32_t owned = owned_cols(ss);
+
+  for (size_t round = 0; round < rounds; round++) {
+    size_t lo = round * SHARD_BATCH < n ? round * SHARD_BATCH : n;
+    size_t hi = lo + SHARD_BATCH < n ? lo + SHARD_BATCH : n;
+    // the requests are cells whose count the owner fills in
+    long n_recv = exchange_cells(ss, &ex, items, NULL, lo, hi);
+    if (n_recv < 0) {
+      free(replies);
+      exchange_free(&ex);
+      return -1;
+    }
+    for (long k = 0; k < n_recv; k++) {
+      ShardCell* c = &ex.recv[k];
+      c->count = ss->cells[(size_t)c->row * owned + (c->col - ss->col_start)];
+    }
+    MPI_Alltoallv(ex.recv, ex.recv_counts, ex.recv_displs, ss->cell_type,
+                  replies, ex.send_counts, ex.send_displs, ss->cell_type, ss->comm);
+
+    // the replies of each owner come back in the order the requests were bucketed
+    for (int r = 0; r < ss->size; r++)
+      ex.cursor[r] = ex.send_displs[r];
+    for (size_t i = lo; i < hi; i++) {
+      uint32_t min_count = UINT32_MAX;
+      for (uint32_t d = 0; d < ss->depth; d++) {
+        uint32_t col = cms_column(&ss->hashFunctions[d], items[i]);
+        uint32_t v = replies[ex.cursor[col / ss->slice]++].count;
+        if (v < min_count) min_count = v;
+      }
+      out[i] = min_count;
+    }
+  }
+
+  free(replies);
+  exchange_free(&ex);
+  return 0;
+}
+
+uint32_t shard_point_query(ShardedSketch* ss, uint32_t item) {
+  uint32_t est = 0;
+  shard_query_batch(ss, &item, 1, &est);
+  return est;
+}
+
+uint64_t shard_total(const ShardedSketch* ss) {
+  unsigned long long total = ss->total;
+  MPI_Allreduce(MPI_IN_PLACE, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, ss->comm);
+  return total;
+}
+
+size_t shard_local_bytes(const ShardedSketch* ss) {
+  return (size_t)ss->depth * owned_cols(ss) * sizeof(uint32_t);
+}
+
+void shard_free(ShardedSketch* ss) {
+  if (ss->win != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(ss->win);
+    MPI_Win_free(&ss->win);  // also frees the cells
+  } else {
+    cms_buffer_free(ss->cells);
+  }
+  free(ss->hashFunctions);
+  if (ss->cell_type != MPI_DATATYPE_NULL)
+    MPI_Type_free(&ss->cell_type);
+}
@@ -0,0 +1,81 @@
+#ifndef CMS_SHARD_H
+#define CMS_SHARD_H
+
+#include <mpi.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_ingest.h"
+#include "cms_options.h"
+#include "cms_types.h"
+
+// Column-sharded distributed sketch.
+// No rank holds the whole depth x width table: rank r owns the columns
+// [r * slice, (r + 1) * slice) of every row, so the sketch size is bounded by
+// the memory of the cluster instead of the memory of one node.
+// Items are hashed where they are read, the resulting (row, column, count)
+// cells are routed to their owners with MPI_Alltoallv in batches and applied
+// there. Queries are routed the same way and the owners answer with the counters.
+// With CMS_SHARD_ACCUMULATE the slices are exposed in an MPI window instead and
+// every rank adds its cells with MPI_Accumulate under a passive-target epoch, one
+// call per owner and batch: no rank waits for the others until the update is over.
+
+// items hashed per exchange round, bounds the send and receive buffers
+#define SHARD_BATCH (1u << 16)
+
+// a counter increment routed to the owner of its column
+typedef struct {
+  uint32_t row;
+  uint32_t col;  // global column
+  uint32_t count;
+} ShardCell;
+
+typedef struct {
+  uint32_t depth;
+  uint32_t width;      // columns of the whole sketch
+  uint32_t slice;      // columns owned by each rank, the last slices may be shorter or empty
+  uint32_t col_start;  // first owned column
+  uint32_t col_end;    // one past the last owned column
+  uint32_t* cells;     // depth x slice owned counters, row major
+  uint64_t total;      // count ingested by this rank
+  double epsilon;
+  double delta;
+  UniversalHash* hashFunctions;  // same on every rank
+  MPI_Comm comm;
+  int rank;
+  int size;
+  MPI_Datatype cell_type;
+  CmsShardExchange exchange;
+  MPI_Win win;  // the owned counters, CMS_SHARD_ACCUMULATE only
+} ShardedSketch;
+
+// collective over comm: rank 0 draws the hash functions with rand() and broadcasts them,
+// every rank allocates only its slice, returns 0 on success. Fails when the width
+// ceil(e / epsilon) exceeds prime, so epsilon must be at least e / prime
+int shard_init(ShardedSketch* ss, double epsilon, double delta, uint32_t prime,
+               CmsShardExchange exchange, MPI_Comm comm);
+
+// collective: hash the local items (or weighted runs) and apply them on the owners,
+// the counters are final everywhere when they return
+// ranks may pass different n, returns 0 on success, -1 if out of memory
+// (the caller should MPI_Abort: the other ranks are left inside the exchange)
+int shard_update_items(ShardedSketch* ss, const uint32_t* items, size_t n);
+int shard_update_runs(ShardedSketch* ss, const ItemRun* runs, size_t n);
+
+// collective: point queries of the local items, every rank gets the estimates of its own
+// items in out, ranks may pass different n (0 to only serve the others), returns 0 on success
+int shard_query_batch(ShardedSketch* ss, const uint32_t* items, size_t n, uint32_t* out);
+
+// collective: estimate of item, each rank may ask for a different one
+uint32_t shard_point_query(ShardedSketch* ss, uint32_t item);
+
+// collective: count ingested by all the ranks
+uint64_t shard_total(const ShardedSketch* ss);
+
+// bytes of the counters owned by this rank
+size_t shard_local_bytes(const ShardedSketch* ss);
+
+// collective over comm
+void shard_free(ShardedSketch* ss);
+
+#endif  // CMS_SHARD_H
@@ -0,0 +1,113 @@
+#define _GNU_SOURCE
+#include "cms_snapshot.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = {'C', 'M', 'S', 'S', 'N', 'A', 'P', '1'};
+
+typedef struct {
+  char magic[8];
+  uint32_t depth;
+  uint32_t width;
+  uint64_t total;
+  double epsilon;
+  double delta;
+} SnapshotHeader;
+
+// the rows start on a cache line
+static size_t table_offset(uint32_t depth) {
+  size_t bytes = sizeof(SnapshotHeader) + (size_t)depth * sizeof(UniversalHash);
+  return (bytes + 63) & ~(size_t)63;
+}
+
+int snapshot_write(const char* path, const CountMinSketch* cms, uint64_t total) {
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE* f = fopen(tmp_path, "wb");
+  if (!f)
+    return -1;
+
+  SnapshotHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.depth = cms->depth;
+  h.width = cms->width;
+  h.total = total;
+  h.epsilon = cms->epsilon;
+  h.delta = cms->delta;
+  static const char zeros[64] = {0};
+  size_t header = sizeof(h) + cms->depth * sizeof(UniversalHash);
+
+  int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  ok = ok && fwrite(cms->hashFunctions, sizeof(UniversalHash), cms->depth, f) == cms->depth;
+  ok = ok && fwrite(zeros, 1, table_offset(cms->depth) - header, f) == table_offset(cms->depth) - header;
+  for (uint32_t d = 0; ok && d < cms->depth; d++)
+    ok = fwrite(cms->table[d], sizeof(uint32_t), cms->width, f) == cms->width;
+  if (fclose(f) != 0)
+    ok = 0;
+  if (!ok || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    return -1;
+  }
+  return 0;
+}
+
+int snapshot_map(const char* path, CmsSnapshot* snap) {
+  memset(snap, 0, sizeof(*snap));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    return -1;
+  }
+  size_t size = (size_t)st.st_size;
+  void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  const SnapshotHeader* h = map;
+  size_t offset = memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 ? table_offset(h->depth) : 0;
+  const UniversalHash* hashes = (const UniversalHash*)((char*)map + sizeof(SnapshotHeader));
+  int failed = offset == 0 || h->depth == 0 || h->width == 0 ||
+               size < offset + (size_t)h->depth * h->width * sizeof(uint32_t);
+  // every query divides by these, and the columns must fall inside the rows
+  for (uint32_t d = 0; !failed && d < h->depth; d++)
+    failed = hashes[d].prime == 0 || hashes[d].width != h->width;
+  uint32_t** rows = NULL;
+  if (failed || !(rows = malloc(h->depth * sizeof(uint32_t*)))) {
+    munmap(map, size);
+    return -1;
+  }
+  for (uint32_t d = 0; d < h->depth; d++)
+    rows[d] = (uint32_t*)((char*)map + offset) + (size_t)d * h->width;
+
+  snap->cms.table = rows;
+  snap->cms.depth = h->depth;
+  snap->cms.width = h->width;
+  snap->cms.total = (uint32_t)h->total;
+  snap->cms.epsilon = h->epsilon;
+  snap->cms.delta = h->delta;
+  snap->cms.hashFunctions = (UniversalHash*)hashes;
+  snap->total = h->total;
+  snap->map = map;
+  snap->size = size;
+  // the rows are read at random
+  madvise(map, size, MADV_WILLNEED);
+  return 0;
+}
+
+void snapshot_unmap(CmsSnapshot* snap) {
+  free(snap->cms.table);
+  if (snap->map)
+    munmap(snap->map, snap->size);
+  memset(snap, 0, sizeof(*snap));
+}
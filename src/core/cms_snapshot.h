@@ -0,0 +1,34 @@
+#ifndef CMS_SNAPSHOT_H
+#define CMS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// Snapshot of a finished sketch (--snapshot=FILE), loaded by cms_serve.
+// The file is written as path.tmp and renamed once complete, so readers never
+// see a partial snapshot. snapshot_map maps it read-only and points the rows
+// of the sketch into the mapping: loading costs no copy and the pages are
+// shared by every process serving the same file.
+//
+// layout: header (magic, depth, width, total, epsilon, delta), depth hashes,
+// padding to 64 bytes, then the rows one after the other
+
+typedef struct {
+  CountMinSketch cms;  // read-only, rows and hashes point into the mapping
+  uint64_t total;      // items in the sketch, not truncated to 32 bits
+  void* map;
+  size_t size;
+} CmsSnapshot;
+
+// write cms to path, total is the number of items it holds; returns 0 on success
+int snapshot_write(const char* path, const CountMinSketch* cms, uint64_t total);
+
+// map a snapshot, returns 0 on success, -1 if it cannot be read, is not a snapshot
+// or has a hash with a zero prime or a width other than the width of its rows
+int snapshot_map(const char* path, CmsSnapshot* snap);
+
+void snapshot_unmap(CmsSnapshot* snap);
+
+#endif  // CMS_SNAPSHOT_H
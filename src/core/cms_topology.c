@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include "cms_topology.h"
+
+#include <omp.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cms_alloc.h"
+
+int topo_num_nodes(void) {
+  // e.g. "0", "0-1" or "0,2-3": the highest id + 1
+  FILE* f = fopen("/sys/devices/system/node/online", "r");
+  if (!f)
+    return 1;
+  int max_id = 0, v;
+  while (fscanf(f, "%d", &v) == 1) {
+    if (v > max_id)
+      max_id = v;
+    fgetc(f);  // ',' or '-'
+  }
+  fclose(f);
+  return max_id + 1;
+}
+
+int topo_current_node(void) {
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    return 0;
+  int n = topo_num_nodes();
+  return (int)node < n ? (int)node : n - 1;
+}
+
+int topo_pin_threads(void) {
+  if (omp_get_proc_bind() != omp_proc_bind_false)
+    return 0;
+
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return 0;
+  int cpus[CPU_SETSIZE];
+  int n_cpus = 0;
+  for (int c = 0; c < CPU_SETSIZE; c++)
+    if (CPU_ISSET(c, &allowed))
+      cpus[n_cpus++] = c;
+  if (n_cpus == 0)
+    return 0;
+
+  // compact: consecutive threads on consecutive CPUs, hence on the same node
+  int pinned = 0;
+#pragma omp parallel reduction(+ : pinned)
+  {
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpus[omp_get_thread_num() % n_cpus], &one);
+    if (sched_setaffinity(0, sizeof(one), &one) == 0)
+      pinned++;
+  }
+  return pinned;
+}
+
+uint32_t* topo_rehome_items(uint32_t* items, size_t n) {
+  uint32_t* local = cms_buffer_alloc(n * sizeof(uint32_t));
+  if (!local)
+    return items;
+  // same static blocks as the update loops, the copy is the first touch
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    local[i] = items[i];
+  cms_buffer_free(items);
+  return local;
+}
+
+int replicas_init(NodeReplicas* nr, CountMinSketch* base) {
+  nr->base = base;
+  nr->n_nodes = topo_num_nodes();
+  nr->replicas = NULL;
+  if (nr->n_nodes == 1)
+    return 0;
+  nr->replicas = calloc(nr->n_nodes, sizeof(CountMinSketch));
+  return nr->replicas ? 0 : -1;
+}
+
+CountMinSketch* replicas_local(NodeReplicas* nr) {
+  if (!nr->replicas)
+    return nr->base;
+
+  CountMinSketch* r = &nr->replicas[topo_current_node()];
+#pragma omp critical(cms_replicas)
+  if (!r->table) {
+    // created and zeroed by a thread of the node: first touch
+    size_t cells = (size_t)nr->base->depth * nr->base->width;
+    *r = *nr->base;
+    r->total = 0;
+    r->hashFunctions = malloc(r->depth * sizeof(UniversalHash));
+    memcpy(r->hashFunctions, nr->base->hashFunctions, r->depth * sizeof(UniversalHash));
+    r->table = malloc(r->depth * sizeof(uint32_t*));
+    r->table[0] = cms_buffer_alloc(cells * sizeof(uint32_t));
+    memset(r->table[0], 0, cells * sizeof(uint32_t));
+    for (uint32_t d = 1; d < r->depth; d++)
+      r->table[d] = r->table[0] + (size_t)d * r->width;
+  }
+  return r;
+}
+
+void replicas_merge_free(NodeReplicas* nr) {
+  if (!nr->replicas)
+    return;
+  size_t cells = (size_t)nr->base->depth * nr->base->width;
+  for (int k = 0; k < nr->n_nodes; k++) {
+    CountMinSketch* r = &nr->replicas[k];
+    if (!r->table)
+      continue;
+    for (size_t c = 0; c < cells; c++)
+      nr->base->table[0][c] += r->table[0][c];
+    nr->base->total += r->total;
+    cms_buffer_free(r->table[0]);
+    free(r->table);
+    free(r->hashFunctions);
+  }
+  free(nr->replicas);
+  nr->replicas = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef CMS_TOPOLOGY_H
+#define CMS_TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cms_types.h"
+
+// NUMA placement for the OpenMP versions.
+// Threads are pinned to the CPUs the process may run on, in order, unless
+// OMP_PROC_BIND/OMP_PLACES already bind them. Memory is placed by first touch:
+// each thread writes the pages it will use, so they land on its own node.
+// No libnuma, only sched_setaffinity, getcpu and /sys.
+
+// number of online NUMA nodes, 1 when it cannot be determined
+int topo_num_nodes(void);
+
+// node of the CPU the calling thread runs on, in [0, topo_num_nodes())
+int topo_current_node(void);
+
+// pin the threads of the next parallel regions one per allowed CPU
+// returns the number of pinned threads, 0 if an OpenMP binding is already active
+int topo_pin_threads(void);
+
+// copy items into a buffer (cms_buffer_alloc) first-touched by the threads that
+// will process each static block (schedule(static) loops), frees the old buffer
+uint32_t* topo_rehome_items(uint32_t* items, size_t n);
+
+// one copy of a shared sketch per NUMA node for the atomic update modes:
+// the threads of a node update their node's copy, the copies are summed at the end
+typedef struct {
+  CountMinSketch* base;
+  CountMinSketch* replicas;  // n_nodes entries, tables created by a thread of the node
+  int n_nodes;
+} NodeReplicas;
+
+// with a single node every thread simply updates base
+int replicas_init(NodeReplicas* nr, CountMinSketch* base);
+// sketch to update from the calling thread, inside a parallel region
+CountMinSketch* replicas_local(NodeReplicas* nr);
+// add the replicas into base and free them, outside the parallel region
+void replicas_merge_free(NodeReplicas* nr);
+
+#endif  // CMS_TOPOLOGY_H
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include "cms_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char* TRACE_NAMES[TRACE_N_NAMES] = {"read", "parse", "update", "merge", "reduce"};
+
+typedef struct {
+  TraceEvent* events;
+  uint32_t n;
+  uint64_t dropped;
+} TraceBuffer;
+
+int trace_on = 0;
+static int trace_rank;
+static uint64_t origin_ticks, origin_ns;
+static int64_t shift_ns;  // from the origin of this process to the one of the timeline
+static TraceBuffer buffers[TRACE_MAX_THREADS];
+static int n_buffers;  // claimed with an atomic add
+
+// buffer of the calling thread, -1 until its first event, -2 if none could be had
+static __thread int my_buffer = -1;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// events are stamped with the invariant TSC where there is one, a few cycles
+// against tens of ns for clock_gettime in VMs, and converted to ns on collection
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t now_ticks(void) {
+  return __builtin_ia32_rdtsc();
+}
+#else
+static inline uint64_t now_ticks(void) {
+  return now_ns();
+}
+#endif
+
+static int claim_buffer(void) {
+  int b = __atomic_fetch_add(&n_buffers, 1, __ATOMIC_RELAXED);
+  if (b >= TRACE_MAX_THREADS)
+    return -2;
+  buffers[b].events = malloc(TRACE_EVENTS_PER_THREAD * sizeof(TraceEvent));
+  return buffers[b].events ? b : -2;
+}
+
+void trace_enable(int rank) {
+  trace_rank = rank;
+  origin_ns = now_ns();
+  origin_ticks = now_ticks();
+  if (my_buffer == -1)
+    my_buffer = claim_buffer();
+  trace_on = 1;
+}
+
+int64_t trace_now(void) {
+  return (int64_t)(now_ns() - origin_ns);
+}
+
+void trace_shift(int64_t ns) {
+  shift_ns = ns;
+}
+
+void trace_event(TraceName name, int begin) {
+  uint64_t t = now_ticks();
+  if (my_buffer == -1)
+    my_buffer = claim_buffer();
+  if (my_buffer < 0)
+    return;
+  TraceBuffer* buf = &buffers[my_buffer];
+  if (buf->n == TRACE_EVENTS_PER_THREAD) {
+    buf->dropped++;
+    return;
+  }
+  TraceEvent* e = &buf->events[buf->n++];
+  e->ns = t - origin_ticks;  // ticks until trace_collect
+  e->rank = (uint32_t)trace_rank;
+  e->thread = (uint16_t)my_buffer;
+  e->name = (uint8_t)name;
+  e->begin = (uint8_t)begin;
+}
+
+TraceEvent* trace_collect(size_t* n, uint64_t* dropped) {
+  int used = n_buffers < TRACE_MAX_THREADS ? n_buffers : TRACE_MAX_THREADS;
+  size_t total = 0;
+  *dropped = 0;
+  for (int b = 0; b < used; b++) {
+    total += buffers[b].n;
+    *dropped += buffers[b].dropped;
+  }
+  TraceEvent* all = malloc((total > 0 ? total : 1) * sizeof(TraceEvent));
+  *n = 0;
+  if (!all)
+    return NULL;
+  for (int b = 0; b < used; b++) {
+    if (buffers[b].n > 0)
+      memcpy(all + *n, buffers[b].events, buffers[b].n * sizeof(TraceEvent));
+    *n += buffers[b].n;
+  }
+
+  // tick rate measured over the whole run against the monotonic clock
+  uint64_t ticks = now_ticks() - origin_ticks;
+  uint64_t ns = now_ns() - origin_ns;
+  double ns_per_tick = ticks > 0 ? (double)ns / ticks : 1.0;
+  for (size_t i = 0; i < *n; i++) {
+    int64_t t = (int64_t)(all[i].ns * ns_per_tick) + shift_ns;
+    all[i].ns = t > 0 ? (uint64_t)t : 0;
+  }
+  return all;
+}
+
+int trace_write_events(const char* path, const TraceEvent* events, size_t n, uint64_t dropped) {
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return -1;
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu},\"traceEvents\":[",
+          (unsigned long long)dropped);
+  const char* sep = "";
+  // one process per rank in the viewer, the events come grouped by rank
+  for (size_t i = 0; i < n; i++) {
+    if (i == 0 || events[i].rank != events[i - 1].rank) {
+      fprintf(f, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"rank %u\"}}",
+              sep, events[i].rank, events[i].rank);
+      sep = ",";
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    const TraceEvent* e = &events[i];
+    // microseconds with ns resolution
+    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%u,\"tid\":%u}", sep,
+            TRACE_NAMES[e->name], e->begin ? 'B' : 'E', (unsigned long long)(e->ns / 1000),
+            (unsigned)(e->ns % 1000), e->rank, e->thread);
+    sep = ",";
+  }
+  fprintf(f, "]}\n");
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+int trace_write(const char* path) {
+  size_t n;
+  uint64_t dropped;
+  TraceEvent* events = trace_collect(&n, &dropped);
+  if (!events)
+    return -1;
+  int status = trace_write_events(path, events, n, dropped);
+  free(events);
+  return status;
+}
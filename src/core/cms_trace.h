@@ -0,0 +1,155 @@
+#ifndef CMS_TRACE_H
+#define CMS_TRACE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Timeline tracing (--trace=FILE), written as Chrome trace JSON for Perfetto
+// or chrome://tracing.
+// Every thread appends begin/end events to a buffer of its own, claimed with
+// one atomic add on its first event, so recording takes no lock: a branch on
+// trace_on, a TSC read and a store. Nothing is recorded until trace_enable.
+// A buffer holds TRACE_EVENTS_PER_THREAD events, later ones are counted and dropped.
+// Timestamps are nanoseconds since the origin taken in trace_enable. In the MPI
+// drivers every rank is then moved onto the timeline of rank 0, by the clock
+// offset trace_enable_all measures with round trips.
+
+#define TRACE_MAX_THREADS 256
+#define TRACE_EVENTS_PER_THREAD (1u << 16)
+#define TRACE_SYNC_ROUNDS 8  // round trips per rank, the fastest one gives the offset
+#define TRACE_SYNC_TAG 7309
+
+typedef enum {
+  TRACE_READ,    // file reads
+  TRACE_PARSE,   // text to keys or runs
+  TRACE_UPDATE,  // sketch updates
+  TRACE_MERGE,   // merge of thread-private copies
+  TRACE_REDUCE,  // MPI reduction of the rank sketches
+  TRACE_N_NAMES,
+} TraceName;
+
+typedef struct {
+  uint64_t ns;  // since the origin
+  uint32_t rank;
+  uint16_t thread;  // order in which the threads of the rank recorded their first event
+  uint8_t name;
+  uint8_t begin;  // 1 = begin, 0 = end
+} TraceEvent;
+
+extern int trace_on;
+
+// set the origin to now and start recording, the calling thread becomes thread 0
+void trace_enable(int rank);
+
+// ns since the origin on the clock of the events
+int64_t trace_now(void);
+
+// add ns to every event of this process when it is collected, the events that
+// would fall before the origin are clamped to it
+void trace_shift(int64_t ns);
+
+// record an event of the calling thread (called through the inlines below)
+void trace_event(TraceName name, int begin);
+
+static inline void trace_begin(TraceName name) {
+  if (trace_on) trace_event(name, 1);
+}
+static inline void trace_end(TraceName name) {
+  if (trace_on) trace_event(name, 0);
+}
+
+// copy the events of every thread of this process into a new array (free it),
+// call after the parallel regions, returns NULL if out of memory
+TraceEvent* trace_collect(size_t* n, uint64_t* dropped);
+
+// write the events as Chrome trace JSON to path, returns 0 on success
+int trace_write_events(const char* path, const TraceEvent* events, size_t n, uint64_t dropped);
+
+// single process: collect and write, returns 0 on success
+int trace_write(const char* path);
+
+// MPI drivers: trace_enable_all takes the origin of every rank of comm after a barrier,
+// then rank 0 answers TRACE_SYNC_ROUNDS pings of each rank in turn with its own time.
+// Over the fastest round trip t0 -> t1 a rank takes root - (t0 + t1) / 2 as the offset
+// of its timeline, which absorbs both the barrier exit skew and, across nodes, the clock
+// offset (Cristian's algorithm, within half a round trip).
+// trace_gather_write collects the events of every rank on rank 0, which writes the file.
+// Both are collective over comm, the write status is returned on rank 0.
+#ifdef MPI_VERSION
+static inline void trace_enable_all(MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  MPI_Barrier(comm);
+  trace_enable(rank);
+
+  if (rank == 0) {
+    for (int r = 1; r < size; r++) {
+      for (int k = 0; k < TRACE_SYNC_ROUNDS; k++) {
+        MPI_Recv(NULL, 0, MPI_BYTE, r, TRACE_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+        int64_t now = trace_now();
+        MPI_Send(&now, 1, MPI_INT64_T, r, TRACE_SYNC_TAG, comm);
+      }
+    }
+  } else {
+    int64_t best_rtt = INT64_MAX, offset = 0;
+    for (int k = 0; k < TRACE_SYNC_ROUNDS; k++) {
+      int64_t root, t0 = trace_now();
+      MPI_Send(NULL, 0, MPI_BYTE, 0, TRACE_SYNC_TAG, comm);
+      MPI_Recv(&root, 1, MPI_INT64_T, 0, TRACE_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+      int64_t t1 = trace_now();
+      if (t1 - t0 < best_rtt) {
+        best_rtt = t1 - t0;
+        offset = root - (t0 + t1) / 2;
+      }
+    }
+    trace_shift(offset);
+  }
+}
+
+static inline int trace_gather_write(const char* path, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  size_t n = 0;
+  uint64_t dropped = 0;
+  TraceEvent* mine = trace_collect(&n, &dropped);
+  int count = mine ? (int)n : 0;
+
+  // counted in whole events, byte counts of large traces would overflow an int
+  MPI_Datatype event_type;
+  MPI_Type_contiguous(sizeof(TraceEvent), MPI_BYTE, &event_type);
+  MPI_Type_commit(&event_type);
+
+  int* counts = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+  int* displs = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+  MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &dropped, &dropped, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+  TraceEvent* all = NULL;
+  int total = 0;
+  if (rank == 0) {
+    for (int r = 0; counts && displs && r < size; r++) {
+      displs[r] = total;
+      total += counts[r];
+    }
+    all = malloc((total > 0 ? (size_t)total : 1) * sizeof(TraceEvent));
+  }
+  if (rank == 0 && (!counts || !displs || !all))
+    MPI_Abort(comm, 99);
+  MPI_Gatherv(mine, count, event_type, all, counts, displs, event_type, 0, comm);
+  MPI_Type_free(&event_type);
+
+  int status = 0;
+  if (rank == 0)
+    status = trace_write_events(path, all, (size_t)total, dropped);
+  free(mine);
+  free(all);
+  free(counts);
+  free(displs);
+  return status;
+}
+#endif
+
+#endif  // CMS_TRACE_H
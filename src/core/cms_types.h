@@ -0,0 +1,46 @@
+#ifndef CMS_TYPES_H
+#define CMS_TYPES_H
+
+#include <stdint.h>
+
+// Data structures shared by every CMS core (count_min_sketch*.h) and by the
+// modules built on top of them, so a module can be linked with any version.
+
+typedef struct {
+  uint32_t a;
+  uint32_t b;
+  uint32_t prime;
+  uint32_t width;
+} UniversalHash;
+
+typedef struct {
+  uint32_t** table;  // array counters depth x width
+  uint32_t depth;    // depth
+  uint32_t width;    // width
+  uint32_t total;    // total counts
+  double epsilon;
+  double delta;
+  UniversalHash* hashFunctions;
+} CountMinSketch;
+
+// struct used to store the real count of items
+typedef struct {
+  uint32_t val;
+  uint32_t count;
+} RealCount;
+
+// signature of cms_update_int and of the update kernels (cms_kernels.h)
+typedef void (*CmsUpdateFn)(CountMinSketch* cms, uint32_t item, uint32_t count);
+
+// column of item in the row of hash, same formula as hash_val
+static inline uint32_t cms_column(const UniversalHash* hash, uint32_t item) {
+  return ((hash->a * item + hash->b) % hash->prime) % hash->width;
+}
+
+// a + b stuck at UINT32_MAX: a cell that outgrows 32 bits stays an overestimate instead of wrapping
+static inline uint32_t cms_add_sat(uint32_t a, uint32_t b) {
+  uint32_t s = a + b;
+  return s < a ? UINT32_MAX : s;
+}
+
+#endif  // CMS_TYPES_H
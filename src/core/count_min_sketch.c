@@ -1,5 +1,7 @@
 #include "count_min_sketch.h"
+#include "cms_alloc.h"
 #include <inttypes.h>
+#include <string.h>
 
 // update for an item represented as an integer
 void cms_update_int(CountMinSketch* cms, uint32_t item, uint32_t c) {
@@ -97,12 +99,11 @@ uint32_t cms_init(CountMinSketch* cms, double epsilon, double delta, uint32_t pr
   cms->delta = delta;
   cms->width = ceil(exp(1.0) / epsilon);
   cms->depth = ceil(log(1 / delta));
+  // rows are views into a single contiguous block, so the whole table can be reduced in one go
   cms->table = malloc(cms->depth * sizeof(uint32_t*));
-  for (uint32_t i = 0; i < cms->depth; i++) {
-    cms->table[i] = malloc(cms->width * sizeof(uint32_t));
-    for (uint32_t j = 0; j < cms->width; j++) {
-      cms->table[i][j] = 0;
-    }
+  cms->table[0] = cms_buffer_alloc((size_t)cms->depth * cms->width * sizeof(uint32_t));
+  for (uint32_t i = 1; i < cms->depth; i++) {
+    cms->table[i] = cms->table[0] + (size_t)i * cms->width;
   }
   cms->hashFunctions = malloc(cms->depth * sizeof(UniversalHash));
   universal_hash_array_init(cms->hashFunctions, prime, cms->width, cms->depth);
@@ -110,13 +111,35 @@ uint32_t cms_init(CountMinSketch* cms, double epsilon, double delta, uint32_t pr
 }
 
 void cms_free(CountMinSketch* cms) {
-  for (uint32_t i = 0; i < cms->depth; i++) {
-    free(cms->table[i]);
-  }
+  cms_buffer_free(cms->table[0]);
   free(cms->table);
   free(cms->hashFunctions);
 }
 
+// private copy of local_cms for one thread: same shape and hashes, zeroed contiguous table
+void cms_init_private(CountMinSketch* thread_cms, const CountMinSketch* local_cms) {
+  *thread_cms = *local_cms;
+  thread_cms->total = 0;
+  thread_cms->hashFunctions = malloc(local_cms->depth * sizeof(UniversalHash));
+  memcpy(thread_cms->hashFunctions, local_cms->hashFunctions, local_cms->depth * sizeof(UniversalHash));
+
+  thread_cms->table = malloc(local_cms->depth * sizeof(uint32_t*));
+  // zeroed by the calling thread: the pages are first touched on the node
+  // of the thread that owns the copy
+  size_t cells = (size_t)local_cms->depth * local_cms->width;
+  thread_cms->table[0] = cms_buffer_alloc(cells * sizeof(uint32_t));
+  memset(thread_cms->table[0], 0, cells * sizeof(uint32_t));
+  for (uint32_t i = 1; i < local_cms->depth; i++) {
+    thread_cms->table[i] = thread_cms->table[0] + (size_t)i * local_cms->width;
+  }
+}
+
+void cms_free_private(CountMinSketch* cms) {
+  cms_free(cms);
+  cms->table = NULL;
+  cms->hashFunctions = NULL;
+}
+
 // initialize UniversalHash
 void universal_hash_init(UniversalHash* hash, uint32_t prime, uint32_t width) {
   hash->prime = prime;
@@ -236,8 +259,8 @@ int test_cms_accuracy(CountMinSketch* cms, RealCount* ground_truth, uint32_t n_v
   printf("\nAccuracy Test Summary\n");
   printf("Avg absolute error: %.2f\n", (double)total_abs_error / n_values);
   printf("Max absolute error: %" PRIu64 "\n", max_abs_error);
-  printf("Exact matches: %" PRIu64 " over %u items (%.2f%%)\n", total_exact_matches, n_values, (double)(total_exact_matches / n_values) * 100);
-  printf("Within error bound: %" PRIu64 " over %u items (%.2f%%)\n\n", total_within_bound, n_values, (double)(total_within_bound / n_values) * 100);
+  printf("Exact matches: %" PRIu64 " over %u items (%.2f%%)\n", total_exact_matches, n_values, 100.0 * total_exact_matches / n_values);
+  printf("Within error bound: %" PRIu64 " over %u items (%.2f%%)\n\n", total_within_bound, n_values, 100.0 * total_within_bound / n_values);
   return 0;
 }
 
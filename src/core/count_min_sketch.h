@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "cms_types.h"
+
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 #define EPSILON 0.001  // should set this to 0.01 but with 0.1 the matrix is smaller, which is better for debugging
@@ -15,29 +17,6 @@
 #define PRIME 2147483647         // Mersenne's prime
 #define LONG_PRIME 4294967311UL  // used to improve the distribution of hashes
 
-typedef struct {
-  uint32_t a;
-  uint32_t b;
-  uint32_t prime;
-  uint32_t width;
-} UniversalHash;
-
-typedef struct {
-  uint32_t** table;  // array counters depth x width
-  uint32_t depth;    // depth
-  uint32_t width;    // width
-  uint32_t total;    // total counts
-  double epsilon;
-  double delta;
-  UniversalHash* hashFunctions;
-} CountMinSketch;
-
-// struct used to store the real count of items
-typedef struct {
-  uint32_t val;
-  uint32_t count;
-} RealCount;
-
 // update for an item represented as an integer
 void cms_update_int(CountMinSketch* cms, uint32_t item, uint32_t c);
 
@@ -68,6 +47,11 @@ uint32_t cms_init(CountMinSketch* cms, double epsilon, double delta, uint32_t pr
 // free dynamically allocated memory
 void cms_free(CountMinSketch* cms);
 
+// per-thread copy of local_cms (same hashes, zeroed table) and its release, for the
+// drivers that update private copies and merge them (cms_merge.h)
+void cms_init_private(CountMinSketch* thread_cms, const CountMinSketch* local_cms);
+void cms_free_private(CountMinSketch* cms);
+
 // initialize a single hash function
 void universal_hash_init(UniversalHash* hash, uint32_t prime, uint32_t width);
 
@@ -7,11 +7,17 @@
 #include <string.h>
 #include <time.h>
 
-#include "../core/count_min_sketch_hybridV3.h"
+#include "../core/cms_kernels.h"
+#include "../core/cms_merge.h"
+#include "../core/cms_options.h"
+#include "../core/cms_reduce.h"
+#include "../core/count_min_sketch.h"
 
 int main(int argc, char* argv[]) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+  // no flags: anything but the input file is rejected
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, 0, &opts) != 0) {
+    cms_print_options_usage(argv[0], 0);
     return 1;
   }
 
@@ -32,6 +38,8 @@ int main(int argc, char* argv[]) {
   cms_init(&local_cms, EPSILON, DELTA, PRIME);
 
   MPI_Bcast(local_cms.hashFunctions, local_cms.depth * sizeof(UniversalHash), MPI_BYTE, 0, MPI_COMM_WORLD);
+  // unrolled update for the shape of the sketch, it serves the private copies too
+  const CmsKernels* kern = cms_kernels_select(&local_cms);
 
   const char* FILENAME = argv[1];
 
@@ -107,6 +115,8 @@ int main(int argc, char* argv[]) {
 
   uint32_t local_123 = 0, local_456 = 0, local_range = 0;
 
+  CountMinSketch** merge_slots = malloc(omp_get_max_threads() * sizeof(CountMinSketch*));
+
 #pragma omp parallel
   {
     CountMinSketch thread_cms;
@@ -117,25 +127,25 @@ int main(int argc, char* argv[]) {
 #pragma omp for
     for (size_t i = 0; i < idx; i++) {
       uint32_t val = local_items[i];
-      cms_update_int_parallel(&thread_cms, val, 1);
+      kern->update(&thread_cms, val, 1);
       if (val == 123) local_123_private++;
       if (val == 456) local_456_private++;
       if (val >= 100 && val <= 110) local_range_private++;
     }
 
-#pragma omp critical
-    {
-      for (uint32_t d = 0; d < local_cms.depth; d++)
-        for (uint32_t w = 0; w < local_cms.width; w++)
-          local_cms.table[d][w] += thread_cms.table[d][w];
-      local_cms.total += thread_cms.total;
-      local_123 += local_123_private;
-      local_456 += local_456_private;
-      local_range += local_range_private;
-    }
+    // column-parallel merge of the private copies
+    cms_merge_private(&local_cms, merge_slots, &thread_cms, CMS_MERGE_COLUMNS);
+
+#pragma omp atomic
+    local_123 += local_123_private;
+#pragma omp atomic
+    local_456 += local_456_private;
+#pragma omp atomic
+    local_range += local_range_private;
 
     cms_free_private(&thread_cms);
   }
+  free(merge_slots);
 
   t_update_end = MPI_Wtime();
   free(local_items);
@@ -144,47 +154,23 @@ int main(int argc, char* argv[]) {
   MPI_Barrier(MPI_COMM_WORLD);
   t_reduce_start = MPI_Wtime();
 
-  CountMinSketch global_cms;
-  if (my_rank == 0) {
-    global_cms.depth = local_cms.depth;
-    global_cms.width = local_cms.width;
-    global_cms.total = 0;
-    global_cms.hashFunctions = malloc(global_cms.depth * sizeof(UniversalHash));
-    global_cms.table = malloc(global_cms.depth * sizeof(uint32_t*));
-    for (uint32_t d = 0; d < global_cms.depth; d++) {
-      global_cms.hashFunctions[d] = local_cms.hashFunctions[d];
-      global_cms.table[d] = calloc(global_cms.width, sizeof(uint32_t));
-    }
-  }
-
-  for (uint32_t d = 0; d < local_cms.depth; d++) {
-    MPI_Reduce(local_cms.table[d],
-               (my_rank == 0 ? global_cms.table[d] : NULL),
-               local_cms.width,
-               MPI_UINT32_T,
-               MPI_SUM,
-               0,
-               MPI_COMM_WORLD);
-  }
-
-  MPI_Reduce(&local_cms.total,
-             (my_rank == 0 ? &global_cms.total : NULL),
-             1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-
-  uint32_t true_123 = 0, true_456 = 0, true_range = 0;
-  MPI_Reduce(&local_123, &true_123, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_456, &true_456, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_range, &true_range, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  // sketch, total and ground-truth counters in a single collective
+  uint32_t true_counts[3] = {local_123, local_456, local_range};
+  ReducedSketch global;
+  if (cms_reduce(&local_cms, &global, true_counts, 3, CMS_REDUCE_ROOT, MPI_COMM_WORLD) != 0)
+    MPI_Abort(MPI_COMM_WORLD, 98);
+  uint32_t true_123 = true_counts[0], true_456 = true_counts[1], true_range = true_counts[2];
+  CountMinSketch* global_cms = &global.cms;
 
   MPI_Barrier(MPI_COMM_WORLD);
   t_reduce_end = MPI_Wtime();
 
   if (my_rank == 0) {
     printf("\n ITEM ESTIMATIONS \n");
-    printf("Item 123 → estimation: %u, real: %u\n", cms_point_query_int(&global_cms, 123), true_123);
-    printf("Item 456 → estimation: %u, real: %u\n", cms_point_query_int(&global_cms, 456), true_456);
-    printf("Item 999 → estimation: %u (expected: 0 or small)\n", cms_point_query_int(&global_cms, 999));
-    printf("Range 100–110 → estimation: %u, real: %u\n", cms_range_query_int_parallel(&global_cms, 100, 110), true_range);
+    printf("Item 123 → estimation: %u, real: %u\n", cms_point_query_int(global_cms, 123), true_123);
+    printf("Item 456 → estimation: %u, real: %u\n", cms_point_query_int(global_cms, 456), true_456);
+    printf("Item 999 → estimation: %u (expected: 0 or small)\n", cms_point_query_int(global_cms, 999));
+    printf("Range 100–110 → estimation: %u, real: %u\n", cms_range_query_int(global_cms, 100, 110), true_range);
 
     t_end = MPI_Wtime();
 
@@ -192,11 +178,11 @@ int main(int argc, char* argv[]) {
     printf("Total time: %f s\n", t_end - t_start);
     printf("I/O + parsing: %f s\n", t_io_end - t_io_start);
     printf("CMS update: %f s\n", t_update_end - t_update_start);
+    printf("Update kernel: %s\n", kern->name);
     printf("Reduction: %f s\n", t_reduce_end - t_reduce_start);
-
-    cms_free(&global_cms);
   }
 
+  reduced_free(&global);
   cms_free(&local_cms);
   MPI_Finalize();
   return 0;
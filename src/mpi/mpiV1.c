@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "../core/cms_kernels.h"
+#include "../core/cms_options.h"
+#include "../core/cms_reduce.h"
 #include "../core/count_min_sketch.h"
 
 int main(int argc, char* argv[]) {
@@ -12,6 +15,13 @@ int main(int argc, char* argv[]) {
   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
+  // no flags: anything but the input file is rejected
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, 0, &opts) != 0) {
+    if (my_rank == 0) cms_print_options_usage(argv[0], 0);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
   double t_start = MPI_Wtime();
   srand(time(NULL) + my_rank);
 
@@ -24,6 +34,8 @@ int main(int argc, char* argv[]) {
   MPI_Bcast(local_cms.hashFunctions,
             local_cms.depth * sizeof(UniversalHash),
             MPI_BYTE, 0, MPI_COMM_WORLD);
+  // unrolled update for the shape of the sketch
+  const CmsKernels* kern = cms_kernels_select(&local_cms);
 
   const char* FILENAME = argv[1];
 
@@ -108,41 +120,27 @@ int main(int argc, char* argv[]) {
   }
 
   for (int i = 0; i < send_counts[my_rank]; i++)
-    cms_update_int(&local_cms, local_items[i], 1);
+    kern->update(&local_cms, local_items[i], 1);
 
-  CountMinSketch global_cms;
-  if (my_rank == 0) {
-    if (cms_init(&global_cms, EPSILON, DELTA, PRIME) != 0) {
-      fprintf(stderr, "Error initializing global_cms\n");
-      MPI_Abort(MPI_COMM_WORLD, 5);
-    }
-    global_cms.total = 0;
-    for (uint32_t i = 0; i < global_cms.depth; i++)
-      global_cms.hashFunctions[i] = local_cms.hashFunctions[i];
+  // the ground truth is already on rank 0: only the sketch and its total are reduced
+  ReducedSketch global;
+  if (cms_reduce(&local_cms, &global, NULL, 0, CMS_REDUCE_ROOT, MPI_COMM_WORLD) != 0) {
+    fprintf(stderr, "Rank %d: reduction failed\n", my_rank);
+    MPI_Abort(MPI_COMM_WORLD, 5);
   }
-
-  for (uint32_t d = 0; d < local_cms.depth; d++) {
-    MPI_Reduce(local_cms.table[d],
-               (my_rank == 0 ? global_cms.table[d] : NULL),
-               local_cms.width, MPI_UINT32_T,
-               MPI_SUM, 0, MPI_COMM_WORLD);
-  }
-
-  MPI_Reduce(&local_cms.total,
-             (my_rank == 0 ? &global_cms.total : NULL),
-             1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  CountMinSketch* global_cms = &global.cms;
 
   if (my_rank == 0) {
     double t_point_start = MPI_Wtime();
-    test_basic_update_query(&global_cms, true_A_sum, true_B_sum);
+    test_basic_update_query(global_cms, true_A_sum, true_B_sum);
     double t_point_end = MPI_Wtime();
 
     double t_range_start = MPI_Wtime();
-    test_range_query(&global_cms, true_Range_sum);
+    test_range_query(global_cms, true_Range_sum);
     double t_range_end = MPI_Wtime();
 
     double t_inner_start = MPI_Wtime();
-    uint64_t inner_prod = cms_inner_product(&global_cms, &global_cms);
+    uint64_t inner_prod = cms_inner_product(global_cms, global_cms);
     double t_inner_end = MPI_Wtime();
 
     printf("\nInner Product Test\n");
@@ -152,10 +150,9 @@ int main(int argc, char* argv[]) {
     printf("Point query time:  %f s\n", t_point_end - t_point_start);
     printf("Range query time:  %f s\n", t_range_end - t_range_start);
     printf("Inner product time: %f s\n", t_inner_end - t_inner_start);
-
-    cms_free(&global_cms);
   }
 
+  reduced_free(&global);
   cms_free(&local_cms);
   free(local_items);
   free(send_counts);
@@ -164,6 +161,7 @@ int main(int argc, char* argv[]) {
   double t_end = MPI_Wtime();
   if (my_rank == 0) {
     printf("Total time: %f seconds\n", t_end - t_start);
+    printf("Update kernel: %s\n", kern->name);
     printf("\n --------------------------------------\n");
   }
 
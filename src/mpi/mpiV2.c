@@ -6,8 +6,26 @@
 #include <string.h>
 #include <time.h>
 
+#include "../core/cms_accuracy.h"
+#include "../core/cms_alloc.h"
+#include "../core/cms_checkpoint.h"
+#include "../core/cms_chunks.h"
+#include "../core/cms_ingest.h"
+#include "../core/cms_kernels.h"
+#include "../core/cms_options.h"
+#include "../core/cms_perf.h"
+#include "../core/cms_reduce.h"
+#include "../core/cms_report.h"
+#include "../core/cms_snapshot.h"
+#include "../core/cms_trace.h"
 #include "../core/count_min_sketch.h"
 
+// the flags this driver implements
+#define DRIVER_OPTIONS \
+  (CMS_OPT_RUNS | CMS_OPT_REDUCE | CMS_OPT_HIERARCHICAL | CMS_OPT_PIPELINE | \
+   CMS_OPT_HUGE_PAGES | CMS_OPT_DYNAMIC | CMS_OPT_CHECKPOINT | CMS_OPT_REPORT | \
+   CMS_OPT_TRACE | CMS_OPT_ACCURACY | CMS_OPT_SNAPSHOT)
+
 int main(int argc, char* argv[]) {
   int comm_sz, my_rank;
   MPI_Init(&argc, &argv);
@@ -17,9 +35,24 @@ int main(int argc, char* argv[]) {
   MPI_Barrier(MPI_COMM_WORLD);
   double t_start = MPI_Wtime();
 
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, DRIVER_OPTIONS, &opts) != 0) {
+    if (my_rank == 0) cms_print_options_usage(argv[0], DRIVER_OPTIONS);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
   srand(time(NULL) + my_rank);
   const char* FILENAME = argv[1];
 
+  // phase times of this rank, gathered on rank 0 for --report
+  CmsReport report;
+  if (report_init(&report, "mpiV2", FILENAME, my_rank, 1) != 0)
+    MPI_Abort(MPI_COMM_WORLD, 99);
+  ReportWorker* worker = &report.workers[0];
+
+  // sketch tables and large input buffers on huge pages when asked
+  cms_alloc_use_huge_pages(opts.huge_pages);
+
   //  CMS initialization
   CountMinSketch local_cms;
   if (cms_init(&local_cms, EPSILON, DELTA, PRIME) != 0) {
@@ -27,14 +60,22 @@ int main(int argc, char* argv[]) {
       fprintf(stderr, "Error initializing CMS\n");
     MPI_Abort(MPI_COMM_WORLD, 1);
   }
+  // unrolled update for the shape of the sketch
+  const CmsKernels* kern = cms_kernels_select(&local_cms);
 
   MPI_Bcast(local_cms.hashFunctions,
             local_cms.depth * sizeof(UniversalHash),
             MPI_BYTE, 0, MPI_COMM_WORLD);
 
+  // timeline of every rank from a common origin, taken behind a barrier
+  if (opts.trace)
+    trace_enable_all(MPI_COMM_WORLD);
+
   // MPI-I/O
   MPI_Barrier(MPI_COMM_WORLD);
   double t_io_start = MPI_Wtime();
+  PerfPhase perf_io = {{0}, 0, 0}, perf_update = {{0}, 0, 0}, perf_reduce_phase = {{0}, 0, 0};
+  PerfCounters perf = perf_begin();
 
   MPI_File fh;
   MPI_File_open(MPI_COMM_WORLD, FILENAME, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
@@ -42,50 +83,173 @@ int main(int argc, char* argv[]) {
   MPI_Offset file_size;
   MPI_File_get_size(fh, &file_size);
 
-  MPI_Offset approx_chunk = file_size / comm_sz;
-  MPI_Offset my_start = my_rank * approx_chunk;
-  MPI_Offset my_end = (my_rank == comm_sz - 1) ? (file_size - 1) : (my_start + approx_chunk - 1);
-
-  if (my_rank != 0) {
-    char c;
-    MPI_File_read_at(fh, my_start - 1, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
-    while (c != '\n' && my_start < my_end) {
-      my_start++;
-      MPI_File_read_at(fh, my_start - 1, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+  // Restart: the sketch, the counters and the position of the last checkpoint,
+  // each rank then reads only the part of its range not yet in the sketch
+  int mode = (opts.runs || is_rle_file(FILENAME)) ? CHECKPOINT_RUNS : CHECKPOINT_ITEMS;
+  uint32_t local_123 = 0, local_456 = 0, local_range = 0;
+  CheckpointPosition pos = {0, 0, 0, 0};
+  int resuming = 0;
+  double t_restart = 0;
+  if (opts.restart) {
+    double t0 = MPI_Wtime();
+    uint32_t restored[3];
+    int status = checkpoint_read(opts.checkpoint, &local_cms, restored, 3, mode, &pos, file_size, MPI_COMM_WORLD);
+    if (status < 0) {
+      if (my_rank == 0)
+        fprintf(stderr, "Error: %s does not match this input, ingest mode and rank count\n", opts.checkpoint);
+      MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    if (status == 0) {
+      local_123 = restored[0];
+      local_456 = restored[1];
+      local_range = restored[2];
+      resuming = 1;
+    } else if (my_rank == 0) {
+      printf("No checkpoint in %s, starting from zero\n", opts.checkpoint);
+    }
+    t_restart = MPI_Wtime() - t0;
   }
 
-  MPI_Offset my_chunk_size = my_end - my_start + 1;
-  char* buffer = malloc((size_t)my_chunk_size + 1);
-  if (!buffer) MPI_Abort(MPI_COMM_WORLD, 99);
+  // with --checkpoint: offset of every every-th item or run, where a checkpoint can resume
+  uint64_t every = opts.checkpoint ? opts.checkpoint_every : UINT64_MAX;
+  uint64_t* marks = NULL;
 
-  MPI_Offset remaining = my_chunk_size;
-  MPI_Offset offset = my_start;
-  char* ptr = buffer;
+  uint32_t* local_items = NULL;
+  ItemRun* local_runs = NULL;
+  size_t idx = 0;
+  size_t n_runs = 0;
+  size_t local_line_count = 0;
 
-  while (remaining > 0) {
-    int to_read = remaining > INT_MAX ? INT_MAX : (int)remaining;
-    MPI_File_read_at(fh, offset, ptr, to_read, MPI_CHAR, MPI_STATUS_IGNORE);
-    remaining -= to_read;
-    offset += to_read;
-    ptr += to_read;
-  }
-  buffer[my_chunk_size] = '\0';
-
-  if (my_rank != comm_sz - 1) {
-    char* last_nl = strrchr(buffer, '\n');
-    if (last_nl)
-      *(last_nl + 1) = '\0';
-    else
-      buffer[0] = '\0';
-  }
+  ChunkQueue queue;
+  if (opts.dynamic) {
+    // ranks claim fixed-size chunks from a counter on rank 0 until the file is exhausted
+    if (chunk_queue_init(&queue, fh, (MPI_Offset)opts.dynamic * 1024, is_rle_file(FILENAME), MPI_COMM_WORLD) != 0 ||
+        chunk_read_all(&queue, opts.runs, &local_items, &idx, &local_runs, &n_runs) < 0)
+      MPI_Abort(MPI_COMM_WORLD, 99);
+    worker->bytes = queue.bytes;
+    MPI_File_close(&fh);
+    local_line_count = idx + runs_total(local_runs, n_runs);
+  } else if (is_rle_file(FILENAME)) {
+    // fixed size records: every rank reads its own range, no boundary search needed
+    uint64_t first_run, run_count;
+    if (resuming) {
+      first_run = pos.next / sizeof(ItemRun);
+      run_count = (pos.end - pos.next) / sizeof(ItemRun);
+    } else {
+      rle_partition(file_size / sizeof(ItemRun), my_rank, comm_sz, &first_run, &run_count);
+    }
+    pos.end = (first_run + run_count) * sizeof(ItemRun);
+    if (opts.checkpoint) {
+      marks = malloc((run_count / every + 1) * sizeof(uint64_t));
+      if (!marks) MPI_Abort(MPI_COMM_WORLD, 99);
+      for (uint64_t k = 0; k * every < run_count; k++)
+        marks[k] = (first_run + k * every) * sizeof(ItemRun);
+    }
 
-  MPI_File_close(&fh);
+    local_runs = malloc((run_count > 0 ? run_count : 1) * sizeof(ItemRun));
+    if (!local_runs) MPI_Abort(MPI_COMM_WORLD, 99);
 
-  // Count lines in local chunk
-  size_t local_line_count = 0;
-  for (char* p = buffer; *p; p++)
-    if (*p == '\n') local_line_count++;
+    MPI_Offset remaining = run_count * sizeof(ItemRun);
+    MPI_Offset offset = first_run * sizeof(ItemRun);
+    char* ptr = (char*)local_runs;
+
+    trace_begin(TRACE_READ);
+    while (remaining > 0) {
+      int to_read = remaining > INT_MAX ? INT_MAX : (int)remaining;
+      MPI_File_read_at(fh, offset, ptr, to_read, MPI_BYTE, MPI_STATUS_IGNORE);
+      remaining -= to_read;
+      offset += to_read;
+      ptr += to_read;
+    }
+    trace_end(TRACE_READ);
+    MPI_File_close(&fh);
+
+    n_runs = run_count;
+    worker->bytes = run_count * sizeof(ItemRun);
+    local_line_count = runs_total(local_runs, n_runs);
+  } else {
+    MPI_Offset my_start, my_end;
+    if (resuming) {
+      // the checkpoint was taken at a line boundary of a range that ends with one
+      my_start = pos.next;
+      my_end = pos.end - 1;
+    } else {
+      MPI_Offset approx_chunk = file_size / comm_sz;
+      my_start = my_rank * approx_chunk;
+      my_end = (my_rank == comm_sz - 1) ? (file_size - 1) : (my_start + approx_chunk - 1);
+
+      if (my_rank != 0) {
+        char c;
+        MPI_File_read_at(fh, my_start - 1, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+        while (c != '\n' && my_start < my_end) {
+          my_start++;
+          MPI_File_read_at(fh, my_start - 1, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+        }
+      }
+    }
+
+    MPI_Offset my_chunk_size = my_end - my_start + 1;
+    char* buffer = malloc((size_t)my_chunk_size + 1);
+    if (!buffer) MPI_Abort(MPI_COMM_WORLD, 99);
+    worker->bytes = my_chunk_size;
+
+    MPI_Offset remaining = my_chunk_size;
+    MPI_Offset offset = my_start;
+    char* ptr = buffer;
+
+    trace_begin(TRACE_READ);
+    while (remaining > 0) {
+      int to_read = remaining > INT_MAX ? INT_MAX : (int)remaining;
+      MPI_File_read_at(fh, offset, ptr, to_read, MPI_CHAR, MPI_STATUS_IGNORE);
+      remaining -= to_read;
+      offset += to_read;
+      ptr += to_read;
+    }
+    buffer[my_chunk_size] = '\0';
+    trace_end(TRACE_READ);
+
+    if (my_rank != comm_sz - 1) {
+      char* last_nl = strrchr(buffer, '\n');
+      if (last_nl)
+        *(last_nl + 1) = '\0';
+      else
+        buffer[0] = '\0';
+    }
+    pos.end = my_start + strlen(buffer);
+
+    MPI_File_close(&fh);
+
+    trace_begin(TRACE_PARSE);
+    // Count lines in local chunk
+    for (char* p = buffer; *p; p++)
+      if (*p == '\n') local_line_count++;
+
+    if (opts.runs) {
+      // sorted input: a run cut by the chunk boundary becomes two weighted updates
+      local_runs = parse_runs_marked(buffer, &n_runs, every, my_start, opts.checkpoint ? &marks : NULL);
+      if (!local_runs) MPI_Abort(MPI_COMM_WORLD, 99);
+    } else {
+      local_items = cms_buffer_alloc(local_line_count * sizeof(uint32_t));
+      if (!local_items) MPI_Abort(MPI_COMM_WORLD, 99);
+      if (opts.checkpoint) {
+        marks = malloc(((local_line_count + 1) / every + 1) * sizeof(uint64_t));
+        if (!marks) MPI_Abort(MPI_COMM_WORLD, 99);
+      }
+
+      char* token = strtok(buffer, "\n");
+      while (token) {
+        if (marks && idx % every == 0)
+          marks[idx / every] = my_start + (token - buffer);
+        local_items[idx++] = (uint32_t)strtoul(token, NULL, 10);
+        token = strtok(NULL, "\n");
+      }
+    }
+    trace_end(TRACE_PARSE);
+    free(buffer);
+  }
+
+  // before any collective: a rank slow to read shows up in its own time
+  report_add(worker, REPORT_IO, MPI_Wtime() - t_io_start);
 
   size_t total_items = 0;
   MPI_Reduce(&local_line_count, &total_items, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
@@ -108,118 +272,257 @@ int main(int argc, char* argv[]) {
     printf("Dataset file: %s\n", FILENAME);
     double file_size_mb = (double)fsize / (1024.0 * 1024.0);
     printf("File size on disk: %.2f MB\n", file_size_mb);
+    if (local_runs)
+      printf("Run-length ingestion: %zu runs on rank 0\n", n_runs);
   }
-
-  uint32_t* local_items = malloc(local_line_count * sizeof(uint32_t));
-  if (!local_items) MPI_Abort(MPI_COMM_WORLD, 99);
-
-  size_t idx = 0;
-  char* token = strtok(buffer, "\n");
-  while (token) {
-    local_items[idx++] = (uint32_t)strtoul(token, NULL, 10);
-    token = strtok(NULL, "\n");
+  if (opts.dynamic) {
+    chunk_queue_report(&queue, MPI_COMM_WORLD);
+    chunk_queue_free(&queue);
   }
-  free(buffer);
 
+  perf_end(&perf, &perf_io);
   MPI_Barrier(MPI_COMM_WORLD);
   double t_io_end = MPI_Wtime();
 
   //  CMS update + local counters
   MPI_Barrier(MPI_COMM_WORLD);
   double t_update_start = MPI_Wtime();
+  perf = perf_begin();
+
+  // with --checkpoint the local input is updated in segments, each one followed by a checkpoint
+  uint64_t n_segs = opts.checkpoint ? checkpoint_segments(idx, n_runs, every, MPI_COMM_WORLD) : 1;
+  uint64_t resumed = pos.done_items + pos.done_runs;
+  size_t done_items = 0, done_runs = 0;
+  double t_checkpoint = 0;
+  int n_checkpoints = 0;
+  uint32_t total_before = local_cms.total;
+
+  // --pipeline: the segments of the reduction are set up before the updates
+  PendingReduce pending;
+  if (opts.pipeline && cms_ireduce_begin(&local_cms, 3, opts.reduce, opts.pipeline, MPI_COMM_WORLD, &pending) != 0)
+    MPI_Abort(MPI_COMM_WORLD, 98);
+
+  for (uint64_t seg = 0; seg < n_segs; seg++) {
+    size_t items_end = idx - done_items > every ? done_items + every : idx;
+    size_t runs_end = n_runs - done_runs > every ? done_runs + every : n_runs;
+    trace_begin(TRACE_UPDATE);
+
+    if (opts.pipeline && seg + 1 == n_segs) {
+      // last segment row by row: the reduction segments of a row are posted as soon as
+      // it is final and progress while the next rows are updated
+      for (size_t i = done_items; i < items_end; i++) {
+        uint32_t val = local_items[i];
+        if (val == 123) local_123++;
+        if (val == 456) local_456++;
+        if (val >= 100 && val <= 110) local_range++;
+      }
+      local_cms.total += items_end - done_items;
+      for (size_t r = done_runs; r < runs_end; r++) {
+        uint32_t val = local_runs[r].key;
+        uint32_t count = local_runs[r].count;
+        local_cms.total += count;
+        if (val == 123) local_123 += count;
+        if (val == 456) local_456 += count;
+        if (val >= 100 && val <= 110) local_range += count;
+      }
+
+      for (uint32_t d = 0; d < local_cms.depth; d++) {
+        const UniversalHash* hash = &local_cms.hashFunctions[d];
+        uint32_t* row = local_cms.table[d];
+        for (size_t i = done_items; i < items_end; i++) {
+          row[cms_column(hash, local_items[i])]++;
+          if (i % IREDUCE_PROGRESS_EVERY == 0)
+            cms_ireduce_test(&pending);
+        }
+        for (size_t r = done_runs; r < runs_end; r++) {
+          row[cms_column(hash, local_runs[r].key)] += local_runs[r].count;
+          if (r % IREDUCE_PROGRESS_EVERY == 0)
+            cms_ireduce_test(&pending);
+        }
+        if (d + 1 < local_cms.depth)
+          cms_ireduce_post(&pending, d + 1, NULL);
+      }
+      done_items = items_end;
+      done_runs = runs_end;
+      trace_end(TRACE_UPDATE);
+      continue;
+    }
 
-  uint32_t local_123 = 0, local_456 = 0, local_range = 0;
+    for (size_t i = done_items; i < items_end; i++) {
+      uint32_t val = local_items[i];
+      kern->update(&local_cms, val, 1);
 
-  for (size_t i = 0; i < idx; i++) {
-    uint32_t val = local_items[i];
-    cms_update_int(&local_cms, val, 1);
+      if (val == 123) local_123++;
+      if (val == 456) local_456++;
+      if (val >= 100 && val <= 110) local_range++;
+    }
 
-    if (val == 123) local_123++;
-    if (val == 456) local_456++;
-    if (val >= 100 && val <= 110) local_range++;
-  }
-  free(local_items);
+    // one weighted update per run
+    for (size_t r = done_runs; r < runs_end; r++) {
+      uint32_t val = local_runs[r].key;
+      uint32_t count = local_runs[r].count;
+      kern->update(&local_cms, val, count);
 
-  MPI_Barrier(MPI_COMM_WORLD);
+      if (val == 123) local_123 += count;
+      if (val == 456) local_456 += count;
+      if (val >= 100 && val <= 110) local_range += count;
+    }
+    done_items = items_end;
+    done_runs = runs_end;
+    trace_end(TRACE_UPDATE);
+
+    if (seg + 1 < n_segs) {
+      double t0 = MPI_Wtime();
+      uint32_t counters[3] = {local_123, local_456, local_range};
+      CheckpointPosition at = pos;
+      at.done_items += done_items;
+      at.done_runs += done_runs;
+      at.next = mode == CHECKPOINT_RUNS ? checkpoint_offset(marks, every, done_runs, n_runs, pos.end)
+                                        : checkpoint_offset(marks, every, done_items, idx, pos.end);
+      if (checkpoint_write(opts.checkpoint, &local_cms, counters, 3, mode, &at, file_size, MPI_COMM_WORLD) != 0) {
+        if (my_rank == 0) fprintf(stderr, "Error writing the checkpoint %s\n", opts.checkpoint);
+        MPI_Abort(MPI_COMM_WORLD, 97);
+      }
+      t_checkpoint += MPI_Wtime() - t0;
+      n_checkpoints++;
+    }
+  }
+  worker->items = local_cms.total - total_before;
+  report_add(worker, REPORT_UPDATE, MPI_Wtime() - t_update_start);
+  MPI_Allreduce(MPI_IN_PLACE, &resumed, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  perf_end(&perf, &perf_update);
+  cms_buffer_free(local_items);
+  free(local_runs);
+  free(marks);
+
+  // in pipelined mode every rank starts reducing as soon as it is done
+  if (!opts.pipeline) MPI_Barrier(MPI_COMM_WORLD);
   double t_update_end = MPI_Wtime();
 
   //  Reduction
-  MPI_Barrier(MPI_COMM_WORLD);
+  if (!opts.pipeline) MPI_Barrier(MPI_COMM_WORLD);
   double t_reduce_start = MPI_Wtime();
-
-  CountMinSketch global_cms;
-  if (my_rank == 0) {
-    global_cms.depth = local_cms.depth;
-    global_cms.width = local_cms.width;
-    global_cms.total = 0;
-    global_cms.hashFunctions = malloc(global_cms.depth * sizeof(UniversalHash));
-    global_cms.table = malloc(global_cms.depth * sizeof(uint32_t*));
-    for (uint32_t d = 0; d < global_cms.depth; d++) {
-      global_cms.hashFunctions[d] = local_cms.hashFunctions[d];
-      global_cms.table[d] = calloc(global_cms.width, sizeof(uint32_t));
-    }
+  perf = perf_begin();
+
+  // sketch, total and ground-truth counters in a single collective
+  uint32_t true_counts[3] = {local_123, local_456, local_range};
+  ReducedSketch global_cms;
+  int reduce_status;
+  trace_begin(TRACE_REDUCE);
+  if (opts.pipeline) {
+    // the last rows, the total and the counters; the first rows are already on their way
+    cms_ireduce_post(&pending, local_cms.depth, true_counts);
+    reduce_status = cms_ireduce_wait(&pending, &global_cms, true_counts);
+  } else if (opts.hierarchical) {
+    reduce_status = cms_reduce_hierarchical(&local_cms, &global_cms, true_counts, 3, opts.reduce, MPI_COMM_WORLD);
+  } else {
+    reduce_status = cms_reduce(&local_cms, &global_cms, true_counts, 3, opts.reduce, MPI_COMM_WORLD);
   }
-
-  for (uint32_t d = 0; d < local_cms.depth; d++) {
-    MPI_Reduce(local_cms.table[d],
-               (my_rank == 0 ? global_cms.table[d] : NULL),
-               local_cms.width,
-               MPI_UINT32_T,
-               MPI_SUM,
-               0,
-               MPI_COMM_WORLD);
-  }
-
-  MPI_Reduce(&local_cms.total,
-             (my_rank == 0 ? &global_cms.total : NULL),
-             1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-
-  uint32_t true_123 = 0, true_456 = 0, true_range = 0;
-  MPI_Reduce(&local_123, &true_123, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_456, &true_456, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_range, &true_range, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  trace_end(TRACE_REDUCE);
+  if (reduce_status != 0)
+    MPI_Abort(MPI_COMM_WORLD, 98);
+  report_add(worker, REPORT_REDUCE, MPI_Wtime() - t_reduce_start);
+  uint32_t true_123 = true_counts[0];
+  uint32_t true_456 = true_counts[1];
+  uint32_t true_range = true_counts[2];
+  perf_end(&perf, &perf_reduce_phase);
 
   MPI_Barrier(MPI_COMM_WORLD);
   double t_reduce_end = MPI_Wtime();
 
-  if (my_rank == 0) {
-    printf("\n--- ITEM ESTIMATIONS ---\n");
-    printf("Item 123 → estimation: %u, real: %u\n", cms_point_query_int(&global_cms, 123), true_123);
-    printf("Item 456 → estimation: %u, real: %u\n", cms_point_query_int(&global_cms, 456), true_456);
-    printf("Item 999 → estimation: %u (expected: 0 or a small number)\n", cms_point_query_int(&global_cms, 999));
-
-    printf("\nStart Test: Range Query\n");
-    printf("Range 100–110 → estimation: %u, real: %u\n", cms_range_query_int(&global_cms, 100, 110), true_range);
-
-    size_t batch_size = 1000000;
-    double pq_start = MPI_Wtime();
+  // hardware counters of every rank, summed on rank 0 (no-op unless built with PERF=1)
+  perf_reduce(&perf_io, MPI_COMM_WORLD);
+  perf_reduce(&perf_update, MPI_COMM_WORLD);
+  perf_reduce(&perf_reduce_phase, MPI_COMM_WORLD);
+
+  report.wall = t_reduce_end - t_start;
+  if (opts.report)
+    report_gather(&report, MPI_COMM_WORLD);
+  if (opts.trace && trace_gather_write(opts.trace, MPI_COMM_WORLD) != 0)
+    fprintf(stderr, "Error writing the trace to %s\n", opts.trace);
+
+  // reduction time not hidden behind the slowest rank's updates
+  double t_last_update;
+  MPI_Reduce(&t_update_end, &t_last_update, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  // with a scattered sketch every query is a collective, so all ranks take part and fewer are timed
+  int collective = (opts.reduce == CMS_REDUCE_SCATTER);
+  uint32_t est_123 = reduced_point_query(&global_cms, 123);
+  uint32_t est_456 = reduced_point_query(&global_cms, 456);
+  uint32_t est_999 = reduced_point_query(&global_cms, 999);
+  uint32_t est_range = reduced_range_query(&global_cms, 100, 110);
+
+  size_t batch_size = collective ? 1000 : 1000000;
+  double pq_start = 0, pq_end = 0, rq_start = 0, rq_end = 0, ip_start = 0, ip_end = 0;
+  if (collective || my_rank == 0) {
+    pq_start = MPI_Wtime();
     for (size_t i = 0; i < batch_size; i++)
-      (void)cms_point_query_int(&global_cms, 123);
-    double pq_end = MPI_Wtime();
+      (void)reduced_point_query(&global_cms, 123);
+    pq_end = MPI_Wtime();
 
-    double rq_start = MPI_Wtime();
+    rq_start = MPI_Wtime();
     for (size_t i = 0; i < batch_size; i++)
-      (void)cms_range_query_int(&global_cms, 100, 110);
-    double rq_end = MPI_Wtime();
+      (void)reduced_range_query(&global_cms, 100, 110);
+    rq_end = MPI_Wtime();
 
-    double ip_start = MPI_Wtime();
+    ip_start = MPI_Wtime();
     for (size_t i = 0; i < batch_size; i++)
-      (void)cms_inner_product(&global_cms, &global_cms);
-    double ip_end = MPI_Wtime();
+      (void)reduced_inner_product(&global_cms, &global_cms);
+    ip_end = MPI_Wtime();
+  }
+
+  if (my_rank == 0) {
+    printf("\n--- ITEM ESTIMATIONS ---\n");
+    printf("Item 123 → estimation: %u, real: %u\n", est_123, true_123);
+    printf("Item 456 → estimation: %u, real: %u\n", est_456, true_456);
+    printf("Item 999 → estimation: %u (expected: 0 or a small number)\n", est_999);
+
+    printf("\nStart Test: Range Query\n");
+    printf("Range 100–110 → estimation: %u, real: %u\n", est_range, true_range);
 
     printf("\n--- TIMINGS ---\n");
     printf("Total time: %f seconds\n", t_reduce_end - t_start);
     printf("I/O + parsing time: %f s\n", t_io_end - t_io_start);
     printf("CMS update time: %f s\n", t_update_end - t_update_start);
+    printf("Update kernel: %s\n", kern->name);
+    // after the updates: transparent huge pages only show up once the table is touched
+    if (opts.huge_pages)
+      printf("Sketch pages: %s, %zu KB\n", cms_buffer_backing(local_cms.table[0]),
+             cms_buffer_page_size(local_cms.table[0]) / 1024);
+    if (opts.checkpoint)
+      printf("Checkpoint time: %f s (%d checkpoints, included in the update time)\n", t_checkpoint, n_checkpoints);
+    if (opts.restart)
+      printf("Restart time: %f s (%llu items and runs skipped)\n", t_restart, (unsigned long long)resumed);
+    printf("Reduction strategy: %s%s\n", cms_reduce_strategy_name(opts.reduce),
+           opts.hierarchical ? " (hierarchical)" : opts.pipeline ? " (pipelined)" : "");
     printf("Reduction time: %f s\n", t_reduce_end - t_reduce_start);
+    if (opts.pipeline) {
+      printf("Exposed reduction time: %f s\n", t_reduce_end - t_last_update);
+      printf("Pipelined segments: %d of %d posted during the update, in flight for %f s of it\n", pending.early,
+             pending.n_reqs, pending.early ? t_update_end - pending.t_first_post : 0.0);
+    }
     printf("Point query time: %e s\n", (pq_end - pq_start) / batch_size);
     printf("Range query time: %e s\n", (rq_end - rq_start) / batch_size);
     printf("Inner product time: %e s\n", (ip_end - ip_start) / batch_size);
+    perf_print("I/O", &perf_io, total_items);
+    perf_print("update", &perf_update, total_items);
+    perf_print("reduce", &perf_reduce_phase, 0);
     printf("\n --------------------------------------\n");
-
-    cms_free(&global_cms);
+    if (opts.report && report_write(&report, opts.report) != 0)
+      fprintf(stderr, "Error writing the report to %s\n", opts.report);
+
+    // rank 0 holds the whole table unless it was scattered
+    if ((opts.accuracy || opts.snapshot) && opts.reduce == CMS_REDUCE_SCATTER)
+      fprintf(stderr, "Warning: --accuracy and --snapshot need the full sketch on rank 0, use --reduce=reduce or allreduce\n");
+    else if (opts.accuracy)
+      accuracy_run(&global_cms.cms, opts.accuracy, "mpiV2", opts.accuracy_out);
+    if (opts.snapshot && opts.reduce != CMS_REDUCE_SCATTER &&
+        snapshot_write(opts.snapshot, &global_cms.cms, global_cms.cms.total) != 0)
+      fprintf(stderr, "Error writing the snapshot to %s\n", opts.snapshot);
   }
 
+  report_free(&report);
+  reduced_free(&global_cms);
   cms_free(&local_cms);
   MPI_Finalize();
   return 0;
@@ -5,6 +5,9 @@
 #include <string.h>
 #include <time.h>
 
+#include "../core/cms_kernels.h"
+#include "../core/cms_options.h"
+#include "../core/cms_reduce.h"
 #include "../core/count_min_sketch.h"
 
 #define MAX_LINE_LEN 64
@@ -20,6 +23,13 @@ int main(int argc, char* argv[]) {
   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
+  // no flags: anything but the input file is rejected
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, 0, &opts) != 0) {
+    if (my_rank == 0) cms_print_options_usage(argv[0], 0);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
   // Start TIMER
   double t_start = MPI_Wtime();
   srand(time(NULL) + my_rank);
@@ -32,6 +42,10 @@ int main(int argc, char* argv[]) {
     if (my_rank == 0) fprintf(stderr, "Error initializing local CMS\n");
     MPI_Abort(MPI_COMM_WORLD, 1);
   }
+  // the local sketches are summed cell by cell, so they must share the hashes of rank 0
+  MPI_Bcast(local_cms.hashFunctions, local_cms.depth * sizeof(UniversalHash), MPI_BYTE, 0, MPI_COMM_WORLD);
+  // unrolled update for the shape of the sketch
+  const CmsKernels* kern = cms_kernels_select(&local_cms);
 
   // Rank 0 reads the total number of lines
   if (my_rank == 0) {
@@ -82,7 +96,7 @@ int main(int argc, char* argv[]) {
   uint32_t local_123 = 0, local_456 = 0, local_range = 0;
   for (size_t i = 0; i < local_count; i++) {
     uint32_t val = local_items[i];
-    cms_update_int(&local_cms, val, 1);
+    kern->update(&local_cms, val, 1);
 
     // Count ground truth values
     if (val == 123) local_123++;
@@ -90,49 +104,31 @@ int main(int argc, char* argv[]) {
     if (val >= 100 && val <= 110) local_range++;
   }
 
-  CountMinSketch global_cms;
-  if (my_rank == 0) {
-    if (cms_init(&global_cms, EPSILON, DELTA, PRIME) != 0) {
-      fprintf(stderr, "Error initializing global CMS\n");
-      MPI_Abort(MPI_COMM_WORLD, 5);
-    }
-    global_cms.total = 0;
-    for (uint32_t i = 0; i < global_cms.depth; i++)
-      global_cms.hashFunctions[i] = local_cms.hashFunctions[i];
-  }
-
-  for (uint32_t d = 0; d < local_cms.depth; d++) {
-    MPI_Reduce(local_cms.table[d],
-               (my_rank == 0 ? global_cms.table[d] : NULL),
-               local_cms.width, MPI_UINT32_T,
-               MPI_SUM, 0, MPI_COMM_WORLD);
+  // sketch, total and ground-truth counters in a single collective
+  uint32_t true_counts[3] = {local_123, local_456, local_range};
+  ReducedSketch global;
+  if (cms_reduce(&local_cms, &global, true_counts, 3, CMS_REDUCE_ROOT, MPI_COMM_WORLD) != 0) {
+    fprintf(stderr, "Rank %d: reduction failed\n", my_rank);
+    MPI_Abort(MPI_COMM_WORLD, 5);
   }
-
-  MPI_Reduce(&local_cms.total,
-             (my_rank == 0 ? &global_cms.total : NULL),
-             1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-
-  // Reduce ground truth counts
-  uint32_t true_123 = 0, true_456 = 0, true_range = 0;
-  MPI_Reduce(&local_123, &true_123, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_456, &true_456, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&local_range, &true_range, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  uint32_t true_123 = true_counts[0], true_456 = true_counts[1], true_range = true_counts[2];
+  CountMinSketch* global_cms = &global.cms;
 
   // Run tests on rank 0
   if (my_rank == 0) {
     // Point Query Test
     double t_point_start = MPI_Wtime();
-    test_basic_update_query(&global_cms, true_123, true_456);
+    test_basic_update_query(global_cms, true_123, true_456);
     double t_point_end = MPI_Wtime();
 
     // Range Query Test
     double t_range_start = MPI_Wtime();
-    test_range_query(&global_cms, true_range);
+    test_range_query(global_cms, true_range);
     double t_range_end = MPI_Wtime();
 
     // Inner Product Test
     double t_inner_start = MPI_Wtime();
-    uint64_t inner_prod = cms_inner_product(&global_cms, &global_cms);
+    uint64_t inner_prod = cms_inner_product(global_cms, global_cms);
     double t_inner_end = MPI_Wtime();
     printf("Inner product (self): %lu\n", (unsigned long)inner_prod);
 
@@ -140,15 +136,15 @@ int main(int argc, char* argv[]) {
     printf("Point query time:  %f s\n", t_point_end - t_point_start);
     printf("Range query time:  %f s\n", t_range_end - t_range_start);
     printf("Inner product time: %f s\n", t_inner_end - t_inner_start);
-
-    cms_free(&global_cms);
   }
 
   double t_end = MPI_Wtime();
   if (my_rank == 0) {
     printf("Total time: %f seconds\n", t_end - t_start);
+    printf("Update kernel: %s\n", kern->name);
   }
 
+  reduced_free(&global);
   cms_free(&local_cms);
   free(local_items);
   local_items = NULL;
@@ -0,0 +1,191 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../core/cms_alloc.h"
+#include "../core/cms_chunks.h"
+#include "../core/cms_ingest.h"
+#include "../core/cms_options.h"
+#include "../core/cms_shard.h"
+#include "../core/count_min_sketch.h"
+
+/*
+ * MPI-only version with a column-sharded sketch
+ * no rank holds the whole table: each one owns a column slice, the items are hashed
+ * where they are read and the increments are routed to the owners with MPI_Alltoallv
+ * (or MPI_Accumulate with --exchange=accumulate), so the sketch (and its accuracy)
+ * can grow with the memory of the whole cluster
+ */
+
+// the flags this driver implements
+#define DRIVER_OPTIONS (CMS_OPT_RUNS | CMS_OPT_HUGE_PAGES | CMS_OPT_DYNAMIC | CMS_OPT_EPSILON | CMS_OPT_EXCHANGE)
+
+int main(int argc, char* argv[]) {
+  int comm_sz, my_rank;
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_start = MPI_Wtime();
+
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, DRIVER_OPTIONS, &opts) != 0) {
+    if (my_rank == 0) cms_print_options_usage(argv[0], DRIVER_OPTIONS);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  srand(time(NULL) + my_rank);
+  const char* FILENAME = argv[1];
+
+  // the slices are large with a small epsilon, huge pages cut the TLB misses
+  cms_alloc_use_huge_pages(opts.huge_pages);
+
+  //  Sharded CMS initialization
+  ShardedSketch cms;
+  double epsilon = opts.epsilon > 0.0 ? opts.epsilon : EPSILON;
+  if (ceil(exp(1.0) / epsilon) > PRIME) {
+    if (my_rank == 0)
+      fprintf(stderr, "Error: --epsilon=%g gives more columns than the hash prime %u can address, the minimum is %g\n",
+              epsilon, PRIME, exp(1.0) / PRIME);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  if (shard_init(&cms, epsilon, DELTA, PRIME, opts.exchange, MPI_COMM_WORLD) != 0) {
+    fprintf(stderr, "Rank %d: error initializing the sharded CMS\n", my_rank);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  if (my_rank == 0) {
+    printf("Parallel Count-Min Sketch (MPI, column-sharded)\n");
+    printf("\n MEMORY USAGE \n");
+    printf("Sketch: %u x %u (epsilon %g)\n", cms.depth, cms.width, epsilon);
+    printf("CMS total global: %.2f MB\n", (double)cms.depth * cms.width * sizeof(uint32_t) / (1024.0 * 1024.0));
+    printf("CMS per rank: %.2f MB (%u columns)\n", shard_local_bytes(&cms) / (1024.0 * 1024.0), cms.slice);
+    printf("Exchange: %s\n", opts.exchange == CMS_SHARD_ACCUMULATE ? "MPI_Accumulate (one-sided)" : "MPI_Alltoallv");
+  }
+
+  //  MPI-I/O: ranks claim chunks of the file, with --dynamic the chunk size is configurable
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_io_start = MPI_Wtime();
+
+  MPI_File fh;
+  if (MPI_File_open(MPI_COMM_WORLD, FILENAME, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+    if (my_rank == 0) fprintf(stderr, "Cannot open file %s\n", FILENAME);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  uint32_t* local_items = NULL;
+  ItemRun* local_runs = NULL;
+  size_t idx = 0;
+  size_t n_runs = 0;
+
+  ChunkQueue queue;
+  uint32_t chunk_kb = opts.dynamic ? opts.dynamic : DYNAMIC_DEFAULT_CHUNK_KB;
+  if (chunk_queue_init(&queue, fh, (MPI_Offset)chunk_kb * 1024, is_rle_file(FILENAME), MPI_COMM_WORLD) != 0 ||
+      chunk_read_all(&queue, opts.runs, &local_items, &idx, &local_runs, &n_runs) < 0)
+    MPI_Abort(MPI_COMM_WORLD, 99);
+  if (opts.dynamic) chunk_queue_report(&queue, MPI_COMM_WORLD);
+  chunk_queue_free(&queue);
+  MPI_File_close(&fh);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_io_end = MPI_Wtime();
+
+  // ground truth of the test items
+  uint32_t true_counts[3] = {0, 0, 0};
+  for (size_t i = 0; i < idx; i++) {
+    uint32_t val = local_items[i];
+    if (val == 123) true_counts[0]++;
+    if (val == 456) true_counts[1]++;
+    if (val >= 100 && val <= 110) true_counts[2]++;
+  }
+  for (size_t r = 0; r < n_runs; r++) {
+    uint32_t val = local_runs[r].key;
+    if (val == 123) true_counts[0] += local_runs[r].count;
+    if (val == 456) true_counts[1] += local_runs[r].count;
+    if (val >= 100 && val <= 110) true_counts[2] += local_runs[r].count;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, true_counts, 3, MPI_UINT32_T, MPI_SUM, MPI_COMM_WORLD);
+
+  //  CMS update: hash locally, apply on the owners
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_update_start = MPI_Wtime();
+
+  if (shard_update_items(&cms, local_items, idx) != 0 ||
+      shard_update_runs(&cms, local_runs, n_runs) != 0) {
+    fprintf(stderr, "Rank %d: error allocating the exchange buffers\n", my_rank);
+    MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+  double t_local_update = MPI_Wtime() - t_update_start;
+  free(local_items);
+  free(local_runs);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_update_end = MPI_Wtime();
+
+  // achieved update rate of every rank (one update per item or per run)
+  double rate = t_local_update > 0 ? (idx + n_runs) / t_local_update : 0.0;
+  double* rates = my_rank == 0 ? malloc(comm_sz * sizeof(double)) : NULL;
+  MPI_Gather(&rate, 1, MPI_DOUBLE, rates, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  uint64_t total = shard_total(&cms);
+
+  // every query is routed to the owners of its columns, so all ranks take part
+  uint32_t est_123 = shard_point_query(&cms, 123);
+  uint32_t est_456 = shard_point_query(&cms, 456);
+  uint32_t est_999 = shard_point_query(&cms, 999);
+
+  uint32_t range_items[11], range_est[11];
+  for (uint32_t i = 0; i < 11; i++) range_items[i] = 100 + i;
+  uint32_t est_range = 0;
+  if (shard_query_batch(&cms, range_items, 11, range_est) != 0) MPI_Abort(MPI_COMM_WORLD, 99);
+  for (int i = 0; i < 11; i++) est_range += range_est[i];
+
+  // batch throughput: every rank looks up its own keys
+  size_t batch_size = 100000;
+  uint32_t* batch = malloc(batch_size * sizeof(uint32_t));
+  uint32_t* batch_est = malloc(batch_size * sizeof(uint32_t));
+  if (!batch || !batch_est) MPI_Abort(MPI_COMM_WORLD, 99);
+  for (size_t i = 0; i < batch_size; i++) batch[i] = (uint32_t)rand();
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double bq_start = MPI_Wtime();
+  if (shard_query_batch(&cms, batch, batch_size, batch_est) != 0) MPI_Abort(MPI_COMM_WORLD, 99);
+  MPI_Barrier(MPI_COMM_WORLD);
+  double bq_end = MPI_Wtime();
+  free(batch);
+  free(batch_est);
+
+  if (my_rank == 0) {
+    printf("\n DATASET INFO \n");
+    printf("Dataset file: %s\n", FILENAME);
+    printf("Items: %llu\n", (unsigned long long)total);
+
+    printf("\n--- ITEM ESTIMATIONS ---\n");
+    printf("Item 123 → estimation: %u, real: %u\n", est_123, true_counts[0]);
+    printf("Item 456 → estimation: %u, real: %u\n", est_456, true_counts[1]);
+    printf("Item 999 → estimation: %u (expected: 0 or a small number)\n", est_999);
+
+    printf("\nStart Test: Range Query\n");
+    printf("Range 100–110 → estimation: %u, real: %u\n", est_range, true_counts[2]);
+
+    printf("\n--- TIMINGS ---\n");
+    printf("Total time: %f seconds\n", t_update_end - t_start);
+    printf("I/O + parsing time: %f s\n", t_io_end - t_io_start);
+    printf("CMS update time: %f s\n", t_update_end - t_update_start);
+    for (int r = 0; r < comm_sz; r++)
+      printf("Rank %d: %.3e updates/s\n", r, rates[r]);
+    printf("Batch point query time: %e s per query (%zu per rank)\n",
+           (bq_end - bq_start) / (batch_size * comm_sz), batch_size);
+    printf("\n --------------------------------------\n");
+  }
+
+  free(rates);
+  shard_free(&cms);
+  MPI_Finalize();
+  return 0;
+}
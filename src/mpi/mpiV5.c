@@ -0,0 +1,264 @@
+#define _DEFAULT_SOURCE
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../core/cms_alloc.h"
+#include "../core/cms_chunks.h"
+#include "../core/cms_epoch.h"
+#include "../core/cms_ingest.h"
+#include "../core/cms_kernels.h"
+#include "../core/cms_options.h"
+#include "../core/count_min_sketch.h"
+
+// a file with this name in a watched directory ends the job
+#define STOP_FILE "STOP"
+
+/*
+ * MPI-only version with continuous ingestion
+ * every positional argument (a file or a directory of files) is an epoch: the ranks
+ * ingest it into their local sketches, the deltas are summed into a running global
+ * sketch and the local tables are zeroed and reused for the next epoch.
+ * With --watch the directories are polled for new files, each batch of new files
+ * becoming one more epoch, until a STOP file appears
+ */
+
+// send the file list of the next epoch from rank 0 to everyone, newline separated
+static void bcast_paths(PathList* files, int my_rank) {
+  unsigned long long len = 0;
+  char* joined = NULL;
+  if (my_rank == 0) {
+    for (size_t i = 0; i < files->n; i++) len += strlen(files->paths[i]) + 1;
+    joined = malloc(len + 1);
+    if (!joined) MPI_Abort(MPI_COMM_WORLD, 99);
+    char* p = joined;
+    for (size_t i = 0; i < files->n; i++) p += sprintf(p, "%s\n", files->paths[i]);
+  }
+  MPI_Bcast(&len, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+  if (my_rank != 0) {
+    joined = malloc(len + 1);
+    if (!joined) MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+  MPI_Bcast(joined, (int)len, MPI_CHAR, 0, MPI_COMM_WORLD);
+  joined[len] = '\0';
+
+  if (my_rank != 0) {
+    for (char* path = strtok(joined, "\n"); path; path = strtok(NULL, "\n"))
+      if (path_list_add(files, path) != 0) MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+  free(joined);
+}
+
+// move the STOP marker out of files, returns 1 if it was there
+static int take_stop_marker(PathList* files) {
+  int stop = 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < files->n; i++) {
+    const char* base = strrchr(files->paths[i], '/');
+    base = base ? base + 1 : files->paths[i];
+    if (strcmp(base, STOP_FILE) == 0) {
+      stop = 1;
+      free(files->paths[i]);
+    } else {
+      files->paths[kept++] = files->paths[i];
+    }
+  }
+  files->n = kept;
+  return stop;
+}
+
+// the flags this driver implements
+#define DRIVER_OPTIONS (CMS_OPT_RUNS | CMS_OPT_REDUCE | CMS_OPT_HUGE_PAGES | CMS_OPT_DYNAMIC | CMS_OPT_WATCH)
+
+int main(int argc, char* argv[]) {
+  int comm_sz, my_rank;
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_start = MPI_Wtime();
+
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, DRIVER_OPTIONS, &opts) != 0) {
+    if (my_rank == 0) cms_print_options_usage(argv[0], DRIVER_OPTIONS);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  if (opts.reduce == CMS_REDUCE_SCATTER) {
+    if (my_rank == 0) fprintf(stderr, "Error: epochs are reduced with --reduce=reduce or allreduce\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // the positional arguments are the epochs
+  const char** sources = malloc(argc * sizeof(char*));
+  int n_sources = 0;
+  if (!sources) MPI_Abort(MPI_COMM_WORLD, 99);
+  for (int i = 1; i < argc; i++)
+    if (strncmp(argv[i], "--", 2) != 0) sources[n_sources++] = argv[i];
+
+  srand(time(NULL) + my_rank);
+  cms_alloc_use_huge_pages(opts.huge_pages);
+
+  //  CMS initialization: one local table per rank for the whole job
+  CountMinSketch local_cms;
+  if (cms_init(&local_cms, EPSILON, DELTA, PRIME) != 0) {
+    if (my_rank == 0) fprintf(stderr, "Error initializing CMS\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  MPI_Bcast(local_cms.hashFunctions, local_cms.depth * sizeof(UniversalHash), MPI_BYTE, 0, MPI_COMM_WORLD);
+  // unrolled update for the shape of the sketch
+  const CmsKernels* kern = cms_kernels_select(&local_cms);
+  if (my_rank == 0)
+    printf("Update kernel: %s\n", kern->name);
+
+  // ground truth of the test items, accumulated by the epochs like the sketch
+  uint32_t true_counts[3] = {0, 0, 0};
+  EpochSketch global_cms;
+  if (epoch_init(&global_cms, &local_cms, 3, opts.reduce, MPI_COMM_WORLD) != 0) {
+    fprintf(stderr, "Rank %d: error allocating the global sketch\n", my_rank);
+    MPI_Abort(MPI_COMM_WORLD, 99);
+  }
+
+  if (my_rank == 0) {
+    printf("Parallel Count-Min Sketch (MPI, continuous ingestion)\n");
+    printf("Epoch sources: %d%s, global sketch on %s\n", n_sources,
+           opts.watch ? " (watched)" : "", opts.reduce == CMS_REDUCE_ALL ? "every rank" : "rank 0");
+  }
+
+  PathList seen = {NULL, 0, 0};  // files already ingested, rank 0 only
+  FileStates pending = {{NULL, 0, 0}, NULL, NULL};  // polled files that may still grow, rank 0 only
+  int next_source = 0;
+  int stop = 0, stop_seen = 0;
+  while (!stop) {
+    // rank 0 picks the files of the next epoch: the next source, then new files of the watched ones
+    PathList files = {NULL, 0, 0};
+    int action = 0;  // 0 = done, 1 = epoch, 2 = nothing new yet (wait), 3 = empty source (skip)
+    if (my_rank == 0) {
+      int polled = 0;
+      if (next_source < n_sources) {
+        if (epoch_scan(sources[next_source], &seen, &files) != 0)
+          fprintf(stderr, "Warning: cannot read %s\n", sources[next_source]);
+        next_source++;
+        action = 1;
+      } else if (opts.watch) {
+        for (int s = 0; s < n_sources; s++) epoch_scan(sources[s], &seen, &files);
+        polled = 1;
+        action = 1;
+      }
+      if (take_stop_marker(&files)) stop_seen = 1;
+      // a new file is taken once its size and mtime held for a whole interval,
+      // and STOP waits for the files still settling
+      if (polled && epoch_settle(&files, &pending) != 0) MPI_Abort(MPI_COMM_WORLD, 99);
+      stop = stop_seen && pending.list.n == 0;
+      for (size_t i = 0; i < files.n; i++)
+        if (path_list_add(&seen, files.paths[i]) != 0) MPI_Abort(MPI_COMM_WORLD, 99);
+      if (action == 1 && files.n == 0)
+        action = next_source < n_sources ? 3 : opts.watch ? 2 : 0;
+      if (stop && action != 1) action = 0;
+    }
+    MPI_Bcast(&action, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&stop, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (action == 0) {
+      path_list_free(&files);
+      break;
+    }
+    if (action >= 2) {
+      // every rank sleeps instead of spinning in the next collective
+      if (action == 2) sleep(opts.watch);
+      continue;
+    }
+    bcast_paths(&files, my_rank);
+
+    //  Ingestion of the epoch into the local tables
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_epoch_start = MPI_Wtime();
+    uint64_t epoch_items = 0;
+
+    for (size_t f = 0; f < files.n; f++) {
+      MPI_File fh;
+      if (MPI_File_open(MPI_COMM_WORLD, files.paths[f], MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (my_rank == 0) fprintf(stderr, "Warning: cannot open %s\n", files.paths[f]);
+        continue;
+      }
+      uint32_t* local_items = NULL;
+      ItemRun* local_runs = NULL;
+      size_t idx = 0, n_runs = 0;
+      ChunkQueue queue;
+      uint32_t chunk_kb = opts.dynamic ? opts.dynamic : DYNAMIC_DEFAULT_CHUNK_KB;
+      if (chunk_queue_init(&queue, fh, (MPI_Offset)chunk_kb * 1024, is_rle_file(files.paths[f]), MPI_COMM_WORLD) != 0 ||
+          chunk_read_all(&queue, opts.runs, &local_items, &idx, &local_runs, &n_runs) < 0)
+        MPI_Abort(MPI_COMM_WORLD, 99);
+      chunk_queue_free(&queue);
+      MPI_File_close(&fh);
+
+      for (size_t i = 0; i < idx; i++) {
+        uint32_t val = local_items[i];
+        kern->update(&local_cms, val, 1);
+
+        if (val == 123) true_counts[0]++;
+        if (val == 456) true_counts[1]++;
+        if (val >= 100 && val <= 110) true_counts[2]++;
+      }
+      for (size_t r = 0; r < n_runs; r++) {
+        uint32_t val = local_runs[r].key;
+        uint32_t count = local_runs[r].count;
+        kern->update(&local_cms, val, count);
+
+        if (val == 123) true_counts[0] += count;
+        if (val == 456) true_counts[1] += count;
+        if (val >= 100 && val <= 110) true_counts[2] += count;
+      }
+      epoch_items += idx + runs_total(local_runs, n_runs);
+      free(local_items);
+      free(local_runs);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_ingest_end = MPI_Wtime();
+
+    //  Reduction of the epoch delta into the global sketch
+    epoch_commit(&global_cms, &local_cms, true_counts);
+    MPI_Allreduce(MPI_IN_PLACE, &epoch_items, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_commit_end = MPI_Wtime();
+
+    // the global sketch answers queries between epochs
+    if (my_rank == 0) {
+      printf("\n--- EPOCH %llu ---\n", (unsigned long long)global_cms.epochs);
+      printf("Files: %zu, items: %llu (total %llu)\n", files.n, (unsigned long long)epoch_items,
+             (unsigned long long)global_cms.total);
+      printf("Item 123 → estimation: %u, real: %llu\n",
+             cms_point_query_int(&global_cms.global, 123), (unsigned long long)global_cms.meta[0]);
+      printf("Item 456 → estimation: %u, real: %llu\n",
+             cms_point_query_int(&global_cms.global, 456), (unsigned long long)global_cms.meta[1]);
+      printf("Range 100–110 → estimation: %u, real: %llu\n",
+             cms_range_query_int(&global_cms.global, 100, 110), (unsigned long long)global_cms.meta[2]);
+      printf("Ingestion time: %f s\n", t_ingest_end - t_epoch_start);
+      printf("Reduction time: %f s\n", t_commit_end - t_ingest_end);
+      fflush(stdout);
+    }
+    path_list_free(&files);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t_end = MPI_Wtime();
+  if (my_rank == 0) {
+    printf("\n--- TIMINGS ---\n");
+    printf("Epochs: %llu\n", (unsigned long long)global_cms.epochs);
+    printf("Total time: %f seconds\n", t_end - t_start);
+    printf("\n --------------------------------------\n");
+  }
+
+  path_list_free(&seen);
+  file_states_free(&pending);
+  free(sources);
+  epoch_free(&global_cms);
+  cms_free(&local_cms);
+  MPI_Finalize();
+  return 0;
+}
@@ -5,11 +5,29 @@
 #include <string.h>
 #include <time.h>
 
-#include "../core/count_min_sketch_hybridV1.h"
+#include "../core/cms_accuracy.h"
+#include "../core/cms_alloc.h"
+#include "../core/cms_combiner.h"
+#include "../core/cms_ingest.h"
+#include "../core/cms_kernels.h"
+#include "../core/cms_merge.h"
+#include "../core/cms_options.h"
+#include "../core/cms_perf.h"
+#include "../core/cms_report.h"
+#include "../core/cms_snapshot.h"
+#include "../core/cms_trace.h"
+#include "../core/cms_topology.h"
+#include "../core/count_min_sketch.h"
+
+// the flags this driver implements
+#define DRIVER_OPTIONS \
+  (CMS_OPT_RUNS | CMS_OPT_COMBINER | CMS_OPT_MERGE | CMS_OPT_NUMA | CMS_OPT_HUGE_PAGES | \
+   CMS_OPT_REPORT | CMS_OPT_TRACE | CMS_OPT_ACCURACY | CMS_OPT_SNAPSHOT)
 
 int main(int argc, char* argv[]) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, DRIVER_OPTIONS, &opts) != 0) {
+    cms_print_options_usage(argv[0], DRIVER_OPTIONS);
     return 1;
   }
 
@@ -20,9 +38,14 @@ int main(int argc, char* argv[]) {
 
   printf("Parallel Count-Min Sketch (OpenMP only, per-thread private CMS)\n");
 
+  // sketch tables and large input buffers on huge pages when asked
+  cms_alloc_use_huge_pages(opts.huge_pages);
+
   // CMS initialization
   CountMinSketch global_cms;
   cms_init(&global_cms, EPSILON, DELTA, PRIME);
+  // unrolled update for the shape of the sketch, valid for the thread copies
+  const CmsKernels* kern = cms_kernels_select(&global_cms);
 
   // MEMORY USAGE
   size_t cms_table_bytes = global_cms.depth * global_cms.width * sizeof(uint32_t);
@@ -36,73 +59,168 @@ int main(int argc, char* argv[]) {
   printf("\n MEMORY USAGE \n");
   printf("CMS total global: %.2f MB\n", cms_total_rank_bytes / (1024.0 * 1024.0));
 
-  // Read entire file (serial)
-  t_io_start = omp_get_wtime();
-  FILE* f = fopen(argv[1], "r");
-  if (!f) {
-    perror("fopen");
+  // phase times of every thread for --report, the input is read by the main thread alone
+  CmsReport report;
+  if (report_init(&report, "openmpV1", argv[1], 0, omp_threads) != 0) {
+    fprintf(stderr, "Error allocating the report\n");
     return 1;
   }
 
-  size_t cap = 1 << 20;
+  if (opts.trace)
+    trace_enable(0);
+
+  // Read entire file (serial)
+  t_io_start = omp_get_wtime();
+  PerfPhase perf_io = {{0}, 0, 0}, perf_update = {{0}, 0, 0};
+  PerfCounters perf = perf_begin();
   size_t n = 0;
-  uint32_t* items = malloc(cap * sizeof(uint32_t));
+  uint32_t* items = NULL;
+  size_t n_runs = 0;
+  ItemRun* runs = NULL;
+
+  if (is_rle_file(argv[1])) {
+    trace_begin(TRACE_READ);
+    runs = load_runs_rle(argv[1], &n_runs);
+    trace_end(TRACE_READ);
+    if (!runs) {
+      perror("load_runs_rle");
+      return 1;
+    }
+    report.workers[0].bytes = n_runs * sizeof(ItemRun);
+  } else {
+    FILE* f = fopen(argv[1], "r");
+    if (!f) {
+      perror("fopen");
+      return 1;
+    }
+
+    size_t cap = 1 << 20;
+    items = malloc(cap * sizeof(uint32_t));
 
-  while (!feof(f)) {
-    if (n == cap) {
-      cap *= 2;
-      items = realloc(items, cap * sizeof(uint32_t));
+    // buffered reads and parsing are interleaved in fscanf
+    trace_begin(TRACE_PARSE);
+    while (!feof(f)) {
+      if (n == cap) {
+        cap *= 2;
+        items = realloc(items, cap * sizeof(uint32_t));
+      }
+      fscanf(f, "%u", &items[n++]);
+    }
+    trace_end(TRACE_PARSE);
+    report.workers[0].bytes = ftell(f);
+    fclose(f);
+
+    if (opts.runs) {
+      // sorted input: collapse consecutive equal keys into weighted updates
+      runs = malloc((n > 0 ? n : 1) * sizeof(ItemRun));
+      n_runs = collapse_runs(items, n, runs);
+      free(items);
+      items = NULL;
+      n = 0;
     }
-    fscanf(f, "%u", &items[n++]);
   }
-  fclose(f);
 
-  double dataset_size_mb = (double)(n * sizeof(uint32_t)) / (1024.0 * 1024.0);
+  uint64_t n_total = n + runs_total(runs, n_runs);
+  double dataset_size_mb = (double)(n_total * sizeof(uint32_t)) / (1024.0 * 1024.0);
 
   printf("\n DATASET INFO \n");
   printf("Dataset file: %s\n", argv[1]);
   printf("Dataset size: %.2f MB\n", dataset_size_mb);
+  if (runs)
+    printf("Run-length ingestion: %zu runs\n", n_runs);
 
+  perf_end(&perf, &perf_io);
   t_io_end = omp_get_wtime();
+  report_add(&report.workers[0], REPORT_IO, t_io_end - t_io_start);
+
+  if (opts.numa) {
+    // pinned threads first-touch the static block of the input they will process
+    int pinned = topo_pin_threads();
+    items = topo_rehome_items(items, n);
+    printf("NUMA: %d node(s), %d thread(s) pinned\n", topo_num_nodes(), pinned);
+  } else if (opts.huge_pages) {
+    // move the input into a huge-page backed buffer
+    items = topo_rehome_items(items, n);
+  }
 
   // OpenMP parallel update
   t_update_start = omp_get_wtime();
 
   uint32_t local_123 = 0, local_456 = 0, local_range = 0;
 
+  CountMinSketch** merge_slots = malloc(omp_get_max_threads() * sizeof(CountMinSketch*));
+
 #pragma omp parallel
   {
+    // every thread counts its own updates and merge
+    PerfCounters thread_perf = perf_begin();
+    ReportWorker* worker = &report.workers[omp_get_thread_num()];
+    trace_begin(TRACE_UPDATE);
+    double t_thread = omp_get_wtime();
+    uint64_t thread_items = 0;
     CountMinSketch thread_cms;
     cms_init_private(&thread_cms, &global_cms);
 
+    // optional pre-aggregation in front of the private copy
+    Combiner comb;
+    int use_comb = opts.combiner &&
+                   combiner_init(&comb, opts.combiner, &thread_cms, kern->update) == 0;
+
     uint32_t local_123_private = 0;
     uint32_t local_456_private = 0;
     uint32_t local_range_private = 0;
 
-#pragma omp for
+    // no barrier after the loops: the merge waits anyway, and each thread times its own share
+#pragma omp for schedule(static) nowait
     for (size_t i = 0; i < n; i++) {
       uint32_t val = items[i];
-      cms_update_int_parallel(&thread_cms, val, 1);
+      thread_items++;
+      if (use_comb)
+        combiner_add(&comb, val, 1);
+      else
+        kern->update(&thread_cms, val, 1);
 
       if (val == 123) local_123_private++;
       if (val == 456) local_456_private++;
       if (val >= 100 && val <= 110) local_range_private++;
     }
 
-#pragma omp critical
-    {
-      for (uint32_t d = 0; d < global_cms.depth; d++)
-        for (uint32_t w = 0; w < global_cms.width; w++)
-          global_cms.table[d][w] += thread_cms.table[d][w];
+    // whole runs are handed to threads, a run costs one weighted update
+#pragma omp for nowait
+    for (size_t r = 0; r < n_runs; r++) {
+      uint32_t val = runs[r].key;
+      uint32_t count = runs[r].count;
+      kern->update(&thread_cms, val, count);
+      thread_items += count;
 
-      global_cms.total += thread_cms.total;
-      local_123 += local_123_private;
-      local_456 += local_456_private;
-      local_range += local_range_private;
+      if (val == 123) local_123_private += count;
+      if (val == 456) local_456_private += count;
+      if (val >= 100 && val <= 110) local_range_private += count;
     }
 
+    if (use_comb) combiner_free(&comb);  // flushes the last block
+    double t_merge = omp_get_wtime();
+    trace_end(TRACE_UPDATE);
+    report_add(worker, REPORT_UPDATE, t_merge - t_thread);
+    worker->items = thread_items;
+
+    // column-parallel merge of the private copies
+    trace_begin(TRACE_MERGE);
+    cms_merge_private(&global_cms, merge_slots, &thread_cms, opts.merge);
+    trace_end(TRACE_MERGE);
+    report_add(worker, REPORT_MERGE, omp_get_wtime() - t_merge);
+
+#pragma omp atomic
+    local_123 += local_123_private;
+#pragma omp atomic
+    local_456 += local_456_private;
+#pragma omp atomic
+    local_range += local_range_private;
+
     cms_free_private(&thread_cms);
+    perf_end(&thread_perf, &perf_update);
   }
+  free(merge_slots);
 
   t_update_end = omp_get_wtime();
 
@@ -124,9 +242,28 @@ int main(int argc, char* argv[]) {
   printf("Total time: %f seconds\n", t_end - t_start);
   printf("I/O + parsing time: %f s\n", t_io_end - t_io_start);
   printf("CMS update time: %f s\n", t_update_end - t_update_start);
+  printf("Update kernel: %s\n", kern->name);
+  // after the updates: transparent huge pages only show up once the table is touched
+  if (opts.huge_pages)
+    printf("Sketch pages: %s, %zu KB\n", cms_buffer_backing(global_cms.table[0]),
+           cms_buffer_page_size(global_cms.table[0]) / 1024);
+  perf_print("I/O", &perf_io, n_total);
+  perf_print("update", &perf_update, n_total);
   printf("\n --------------------------------------\n");
 
-  free(items);
+  report.wall = t_end - t_start;
+  if (opts.report && report_write(&report, opts.report) != 0)
+    fprintf(stderr, "Error writing the report to %s\n", opts.report);
+  report_free(&report);
+  if (opts.trace && trace_write(opts.trace) != 0)
+    fprintf(stderr, "Error writing the trace to %s\n", opts.trace);
+  if (opts.accuracy)
+    accuracy_run(&global_cms, opts.accuracy, "openmpV1", opts.accuracy_out);
+  if (opts.snapshot && snapshot_write(opts.snapshot, &global_cms, n_total) != 0)
+    fprintf(stderr, "Error writing the snapshot to %s\n", opts.snapshot);
+
+  cms_buffer_free(items);
+  free(runs);
   cms_free(&global_cms);
 
   return 0;
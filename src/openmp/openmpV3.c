@@ -0,0 +1,180 @@
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../core/cms_accuracy.h"
+#include "../core/cms_alloc.h"
+#include "../core/cms_engine.h"
+#include "../core/cms_ingest.h"
+#include "../core/cms_options.h"
+#include "../core/count_min_sketch.h"
+
+/*
+ * OpenMP version on the unified engine (libcms)
+ * one binary for every update strategy: --strategy=private|atomic|partitioned
+ * picks one, --strategy=auto (default) calibrates them on a sample of the input
+ * with the current thread count and keeps the fastest
+ */
+
+// the flags this driver implements
+#define DRIVER_OPTIONS \
+  (CMS_OPT_RUNS | CMS_OPT_MERGE | CMS_OPT_HUGE_PAGES | CMS_OPT_STRATEGY | CMS_OPT_BATCH | \
+   CMS_OPT_ACCURACY)
+
+int main(int argc, char* argv[]) {
+  CmsOptions opts;
+  if (argc < 2 || cms_parse_options(argc, argv, DRIVER_OPTIONS, &opts) != 0) {
+    cms_print_options_usage(argv[0], DRIVER_OPTIONS);
+    return 1;
+  }
+
+  double t_start, t_io_start, t_io_end, t_tune_end, t_update_start, t_update_end, t_end;
+  t_start = omp_get_wtime();
+
+  srand(time(NULL));
+
+  printf("Parallel Count-Min Sketch (OpenMP only, unified engine)\n");
+
+  // sketch tables and large input buffers on huge pages when asked
+  cms_alloc_use_huge_pages(opts.huge_pages);
+
+  // CMS initialization
+  CountMinSketch global_cms;
+  if (cms_init(&global_cms, EPSILON, DELTA, PRIME) != 0) {
+    fprintf(stderr, "Error initializing CMS\n");
+    return 1;
+  }
+
+  // Read entire file (serial)
+  t_io_start = omp_get_wtime();
+  size_t n = 0;
+  uint32_t* items = NULL;
+  size_t n_runs = 0;
+  ItemRun* runs = NULL;
+
+  if (is_rle_file(argv[1])) {
+    runs = load_runs_rle(argv[1], &n_runs);
+    if (!runs) {
+      perror("load_runs_rle");
+      return 1;
+    }
+  } else {
+    FILE* f = fopen(argv[1], "r");
+    if (!f) {
+      perror("fopen");
+      return 1;
+    }
+
+    size_t cap = 1 << 20;
+    items = malloc(cap * sizeof(uint32_t));
+    uint32_t val;
+    while (items && fscanf(f, "%u", &val) == 1) {
+      if (n == cap) {
+        cap *= 2;
+        uint32_t* tmp = realloc(items, cap * sizeof(uint32_t));
+        if (!tmp) free(items);
+        items = tmp;
+        if (!items) break;
+      }
+      items[n++] = val;
+    }
+    fclose(f);
+    if (!items) {
+      fprintf(stderr, "Error allocating the input buffer\n");
+      return 1;
+    }
+
+    if (opts.runs) {
+      // sorted input: collapse consecutive equal keys into weighted updates
+      runs = malloc((n > 0 ? n : 1) * sizeof(ItemRun));
+      n_runs = collapse_runs(items, n, runs);
+      free(items);
+      items = NULL;
+      n = 0;
+    }
+  }
+
+  uint64_t n_total = n + runs_total(runs, n_runs);
+  printf("\n DATASET INFO \n");
+  printf("Dataset file: %s\n", argv[1]);
+  printf("Dataset size: %.2f MB\n", (double)(n_total * sizeof(uint32_t)) / (1024.0 * 1024.0));
+  if (runs)
+    printf("Run-length ingestion: %zu runs\n", n_runs);
+
+  t_io_end = omp_get_wtime();
+
+  // Engine: the calibration sample is the head of the input, items or runs as they will be updated
+  CmsEngine engine;
+  if (engine_init(&engine, &global_cms, opts.strategy, opts.batch, opts.merge, items, runs,
+                  items ? n : n_runs) != 0) {
+    fprintf(stderr, "Error initializing the update engine\n");
+    return 1;
+  }
+  t_tune_end = omp_get_wtime();
+
+  size_t l1, l2;
+  engine_cache_sizes(&l1, &l2);
+  printf("\n ENGINE \n");
+  printf("Threads: %d, sketch: %.2f KB, L1d: %zu KB, L2: %zu KB\n", engine.threads,
+         global_cms.depth * global_cms.width * sizeof(uint32_t) / 1024.0, l1 / 1024, l2 / 1024);
+  for (int t = 0; t < engine.n_trials; t++)
+    printf("  calibration %-11s batch %7zu: %.2f Mupdates/s\n", cms_strategy_name(engine.trials[t].strategy),
+           engine.trials[t].batch, engine.trials[t].rate / 1e6);
+  printf("Strategy: %s, batch %zu%s\n", cms_strategy_name(engine.strategy), engine.batch,
+         opts.strategy == CMS_STRATEGY_AUTO ? " (auto-tuned)" : "");
+
+  // OpenMP parallel update
+  t_update_start = omp_get_wtime();
+  engine_update_items(&engine, items, n);
+  engine_update_runs(&engine, runs, n_runs);
+  t_update_end = omp_get_wtime();
+
+  // ground truth of the test items
+  uint32_t local_123 = 0, local_456 = 0, local_range = 0;
+#pragma omp parallel for reduction(+ : local_123, local_456, local_range)
+  for (size_t i = 0; i < n; i++) {
+    uint32_t val = items[i];
+    if (val == 123) local_123++;
+    if (val == 456) local_456++;
+    if (val >= 100 && val <= 110) local_range++;
+  }
+  for (size_t r = 0; r < n_runs; r++) {
+    uint32_t val = runs[r].key;
+    if (val == 123) local_123 += runs[r].count;
+    if (val == 456) local_456 += runs[r].count;
+    if (val >= 100 && val <= 110) local_range += runs[r].count;
+  }
+
+  // --- Query and validation ---
+  printf("\n ITEM ESTIMATIONS \n");
+  printf("Item 123 → estimation: %u, real: %u\n",
+         cms_point_query_int(&global_cms, 123), local_123);
+  printf("Item 456 → estimation: %u, real: %u\n",
+         cms_point_query_int(&global_cms, 456), local_456);
+  printf("Item 999 → estimation: %u (expected: 0 or small)\n",
+         cms_point_query_int(&global_cms, 999));
+  printf("Range 100–110 → estimation: %u, real: %u\n",
+         cms_range_query_int(&global_cms, 100, 110), local_range);
+
+  t_end = omp_get_wtime();
+
+  printf("\n TIMINGS \n");
+  printf("Total time: %f seconds\n", t_end - t_start);
+  printf("I/O + parsing time: %f s\n", t_io_end - t_io_start);
+  printf("Calibration time: %f s\n", t_tune_end - t_io_end);
+  printf("CMS update time: %f s\n", t_update_end - t_update_start);
+  printf("\n --------------------------------------\n");
+
+  if (opts.accuracy)
+    accuracy_run(&global_cms, opts.accuracy, "openmpV3", opts.accuracy_out);
+
+  engine_free(&engine);
+  free(items);
+  free(runs);
+  cms_free(&global_cms);
+
+  return 0;
+}
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "../core/cms_kernels.h"
 #include "../core/count_min_sketch.h"
 
 int main(int argc, char* argv[]) {
@@ -18,6 +19,8 @@ int main(int argc, char* argv[]) {
     fprintf(stderr, "Error in cms_init\n");
     return 1;
   }
+  // unrolled update for the shape of the sketch, same kernels as the parallel drivers
+  const CmsKernels* kern = cms_kernels_select(&cms);
 
   const char* FILENAME = argv[1];
 
@@ -33,7 +36,7 @@ int main(int argc, char* argv[]) {
   char line[64];
   while (fgets(line, sizeof(line), fp)) {
     uint32_t v = (uint32_t)atoi(line);
-    cms_update_int(&cms, v, 1);
+    kern->update(&cms, v, 1);
 
     if (v == 123) true_A_sum++;
     if (v == 456) true_B_sum++;
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "../core/cms_kernels.h"
 #include "../core/count_min_sketch.h"
 
 // Linear CMS version with accuracy
@@ -20,6 +21,8 @@ int main(int argc, char* argv[]) {
     fprintf(stderr, "Error in cms_init\n");
     return 1;
   }
+  // unrolled update for the shape of the sketch, same kernels as the parallel drivers
+  const CmsKernels* kern = cms_kernels_select(&cms);
 
   const char* FILENAME = argv[1];
   const char* FOLDER = argv[2];
@@ -58,7 +61,7 @@ int main(int argc, char* argv[]) {
 
   // Aggiorno CMS locale
   for (int i = 0; i < total_items; i++) {
-    cms_update_int(&cms, all_items[i], 1);
+    kern->update(&cms, all_items[i], 1);
   }
 
   double t_before_accuracy = MPI_Wtime();
@@ -0,0 +1,659 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../core/cms_ingest.h"
+#include "../core/cms_types.h"
+
+/*
+ * Parallel exact frequency counter (ground truth of the accuracy tests)
+ * replaces scripts/frequency_counter.py: reads a text dataset (one key per line),
+ * a raw uint32 .bin file or an .rle file and writes total_<dataset>, the
+ * "val count" lines load_count reads, sorted by key, or the same pairs as
+ * binary RealCount records with --format=bin.
+ * The input is mapped and split between the threads. Two counting modes:
+ *   hash  (default) every thread counts its share into its own hash table, then
+ *         each thread merges one key range of all the tables: memory grows with
+ *         threads x distinct keys, good up to millions of distinct keys
+ *   radix the keys are scattered into key-range partitions and every partition is
+ *         counted with a dense array, or sorted when its keys are too sparse for
+ *         one: 8 bytes per item, any number of distinct keys
+ *
+ *   ./cms_count data/dataset_1000000000.txt            -> data/total_dataset_1000000000.txt
+ *   ./cms_count data/dataset_1000000000.txt data/ --mode=radix --format=bin
+ */
+
+typedef enum { MODE_HASH, MODE_RADIX } CountMode;
+
+#define DENSE_BITS 20        // keys per radix partition at most 2^DENSE_BITS
+#define SPARSE_RATIO 16      // a partition with fewer items than keys / SPARSE_RATIO is sorted
+#define TABLE_MIN_SLOTS 1024
+
+typedef struct {
+  const char* input;
+  const char* folder;  // NULL = the directory of the input
+  CountMode mode;
+  int binary;
+  int threads;         // 0 = OpenMP default
+} CountConfig;
+
+// the mapped input, exactly one of text, keys and runs is set
+typedef struct {
+  void* map;
+  size_t size;
+  const char* text;
+  const uint32_t* keys;
+  const ItemRun* runs;
+  size_t n;  // keys or runs
+} Input;
+
+// open addressing key -> count, count 0 marks an empty slot
+typedef struct {
+  uint32_t* keys;
+  uint64_t* counts;
+  size_t mask;
+  size_t used;
+} CountTable;
+
+// RealCount with room for more than 2^32 occurrences
+typedef struct {
+  uint32_t key;
+  uint64_t count;
+} KeyCount;
+
+// counts of one key range, ascending keys
+typedef struct {
+  KeyCount* entries;
+  size_t n;
+} Partition;
+
+static int table_init(CountTable* t, size_t slots) {
+  t->keys = malloc(slots * sizeof(uint32_t));
+  t->counts = calloc(slots, sizeof(uint64_t));
+  t->mask = slots - 1;
+  t->used = 0;
+  return t->keys && t->counts ? 0 : -1;
+}
+
+static void table_free(CountTable* t) {
+  free(t->keys);
+  free(t->counts);
+}
+
+static inline size_t table_slot(uint32_t key, size_t mask) {
+  return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+static int table_add(CountTable* t, uint32_t key, uint64_t count);
+
+// double the slots at half load
+static int table_grow(CountTable* t) {
+  CountTable bigger;
+  if (table_init(&bigger, (t->mask + 1) * 2) != 0) {
+    table_free(&bigger);
+    return -1;
+  }
+  for (size_t s = 0; s <= t->mask; s++)
+    if (t->counts[s])
+      table_add(&bigger, t->keys[s], t->counts[s]);
+  table_free(t);
+  *t = bigger;
+  return 0;
+}
+
+static int table_add(CountTable* t, uint32_t key, uint64_t count) {
+  size_t s = table_slot(key, t->mask);
+  while (t->counts[s] && t->keys[s] != key)
+    s = (s + 1) & t->mask;
+  if (t->counts[s] == 0) {
+    t->keys[s] = key;
+    if (++t->used * 2 > t->mask + 1) {
+      t->counts[s] = count;
+      return table_grow(t);
+    }
+  }
+  t->counts[s] += count;
+  return 0;
+}
+
+// LSD radix sort of entries with keys in [base, base + span), 11 bits per pass
+static int sort_by_key(KeyCount* a, size_t n, uint32_t base, uint64_t span) {
+  KeyCount* tmp = malloc((n > 0 ? n : 1) * sizeof(KeyCount));
+  if (!tmp)
+    return -1;
+  KeyCount *src = a, *dst = tmp;
+  for (int shift = 0; shift < 32 && (span - 1) >> shift != 0; shift += 11) {
+    size_t count[2048] = {0};
+    for (size_t i = 0; i < n; i++)
+      count[((src[i].key - base) >> shift) & 2047]++;
+    size_t sum = 0;
+    for (int d = 0; d < 2048; d++) {
+      size_t c = count[d];
+      count[d] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; i++)
+      dst[count[((src[i].key - base) >> shift) & 2047]++] = src[i];
+    KeyCount* swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != a)
+    memcpy(a, src, n * sizeof(KeyCount));
+  free(tmp);
+  return 0;
+}
+
+// bytes [lo, hi) of the text belong to one thread: the lines starting there,
+// a line starting before lo belongs to the previous range
+static const char* range_start(const char* text, size_t size, size_t lo) {
+  const char* p = text + lo;
+  const char* limit = text + size;
+  if (lo > 0 && p[-1] != '\n')
+    while (p < limit && *p != '\n') p++;
+  return p;
+}
+
+// next key starting before end, the digits may run past it; returns 0 when none is left
+static inline int next_key(const char** p, const char* end, const char* limit, uint32_t* key) {
+  const char* q = *p;
+  while (q < end && (*q < '0' || *q > '9')) q++;
+  if (q >= end)
+    return 0;
+  uint32_t v = 0;
+  while (q < limit && *q >= '0' && *q <= '9') v = v * 10 + (uint32_t)(*q++ - '0');
+  *key = v;
+  *p = q;
+  return 1;
+}
+
+static int map_input(const char* path, Input* in) {
+  memset(in, 0, sizeof(*in));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  in->size = (size_t)st.st_size;
+  if (in->size > 0) {
+    in->map = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (in->map == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+    madvise(in->map, in->size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  const char* ext = strrchr(path, '.');
+  if (is_rle_file(path)) {
+    in->runs = in->map;
+    in->n = in->size / sizeof(ItemRun);
+  } else if (ext && strcmp(ext, ".bin") == 0) {
+    in->keys = in->map;
+    in->n = in->size / sizeof(uint32_t);
+  } else {
+    in->text = in->map;
+  }
+  return 0;
+}
+
+// per-thread hash tables, merged by key range: thread p owns partition p of every table
+static Partition* count_hash(const Input* in, int nt, uint32_t* max_key, uint64_t* items) {
+  CountTable* tables = calloc(nt, sizeof(CountTable));
+  Partition* parts = calloc(nt, sizeof(Partition));
+  uint32_t* maxes = calloc(nt, sizeof(uint32_t));
+  uint64_t* totals = calloc(nt, sizeof(uint64_t));
+  if (!tables || !parts || !maxes || !totals)
+    return NULL;
+  int failed = 0;
+
+#pragma omp parallel num_threads(nt) reduction(| : failed)
+  {
+    int t = omp_get_thread_num();
+    CountTable* mine = &tables[t];
+    uint32_t max = 0;
+    uint64_t total = 0;
+    if (table_init(mine, TABLE_MIN_SLOTS) != 0)
+      failed = 1;
+
+    if (in->text) {
+      size_t lo = in->size * t / nt, hi = in->size * (t + 1) / nt;
+      const char* p = range_start(in->text, in->size, lo);
+      const char* end = in->text + hi;
+      const char* limit = in->text + in->size;
+      uint32_t key;
+      while (!failed && next_key(&p, end, limit, &key)) {
+        failed |= table_add(mine, key, 1) != 0;
+        if (key > max) max = key;
+        total++;
+      }
+    } else {
+      size_t lo = in->n * t / nt, hi = in->n * (t + 1) / nt;
+      for (size_t i = lo; !failed && i < hi; i++) {
+        uint32_t key = in->runs ? in->runs[i].key : in->keys[i];
+        uint32_t count = in->runs ? in->runs[i].count : 1;
+        if (count == 0) continue;
+        failed |= table_add(mine, key, count) != 0;
+        if (key > max) max = key;
+        total += count;
+      }
+    }
+    maxes[t] = max;
+    totals[t] = total;
+  }
+
+  *max_key = 0;
+  *items = 0;
+  for (int t = 0; t < nt; t++) {
+    if (maxes[t] > *max_key) *max_key = maxes[t];
+    *items += totals[t];
+  }
+  // partition p holds keys [p * span, (p + 1) * span)
+  uint64_t span = ((uint64_t)*max_key + nt) / nt;
+
+#pragma omp parallel for num_threads(nt) schedule(dynamic, 1) reduction(| : failed)
+  for (int p = 0; p < nt; p++) {
+    if (failed) continue;
+    // sized for every entry of the range so the merged table never grows
+    size_t entries = 0, slots = TABLE_MIN_SLOTS;
+    for (int t = 0; t < nt; t++)
+      for (size_t s = 0; s <= tables[t].mask; s++)
+        entries += tables[t].counts[s] && tables[t].keys[s] / span == (uint64_t)p;
+    while (slots < 2 * entries + 2) slots *= 2;
+    CountTable merged;
+    if (table_init(&merged, slots) != 0) {
+      table_free(&merged);
+      failed = 1;
+      continue;
+    }
+    for (int t = 0; t < nt; t++)
+      for (size_t s = 0; s <= tables[t].mask; s++)
+        if (tables[t].counts[s] && tables[t].keys[s] / span == (uint64_t)p)
+          failed |= table_add(&merged, tables[t].keys[s], tables[t].counts[s]) != 0;
+
+    // the partition is a key range, sorting it sorts the output
+    parts[p].entries = malloc((merged.used > 0 ? merged.used : 1) * sizeof(KeyCount));
+    if (!parts[p].entries) {
+      failed = 1;
+    } else {
+      for (size_t s = 0; s <= merged.mask; s++)
+        if (merged.counts[s])
+          parts[p].entries[parts[p].n++] = (KeyCount){merged.keys[s], merged.counts[s]};
+      failed |= sort_by_key(parts[p].entries, parts[p].n, (uint32_t)(p * span), span) != 0;
+    }
+    table_free(&merged);
+  }
+
+  for (int t = 0; t < nt; t++)
+    table_free(&tables[t]);
+  free(tables);
+  free(maxes);
+  free(totals);
+  if (failed) {
+    for (int p = 0; p < nt; p++)
+      free(parts[p].entries);
+    free(parts);
+    return NULL;
+  }
+  return parts;
+}
+
+// keys of one thread's share, radix mode only (runs are always hashed)
+typedef struct {
+  uint32_t* keys;
+  size_t n;
+  size_t cap;
+} KeyArray;
+
+static int key_push(KeyArray* a, uint32_t key) {
+  if (a->n == a->cap) {
+    size_t cap = a->cap ? a->cap * 2 : 1u << 16;
+    uint32_t* keys = realloc(a->keys, cap * sizeof(uint32_t));
+    if (!keys)
+      return -1;
+    a->keys = keys;
+    a->cap = cap;
+  }
+  a->keys[a->n++] = key;
+  return 0;
+}
+
+// scatter the keys into 2^part_bits key ranges of 2^shift keys, then count
+// every range with a dense array: no hashing and the ranges come out sorted.
+// The dense arrays of all the ranges span the whole key space whatever shift
+// is, so a sparse range is radix sorted instead of scanned.
+static Partition* count_radix(const Input* in, int nt, uint32_t* max_key, uint64_t* items, int* n_parts) {
+  KeyArray* shares = calloc(nt, sizeof(KeyArray));
+  uint32_t* maxes = calloc(nt, sizeof(uint32_t));
+  if (!shares || !maxes)
+    return NULL;
+  int failed = 0;
+
+  // text is parsed once into per-thread arrays, .bin keys are used where they are mapped
+  if (in->text) {
+#pragma omp parallel num_threads(nt) reduction(| : failed)
+    {
+      int t = omp_get_thread_num();
+      size_t lo = in->size * t / nt, hi = in->size * (t + 1) / nt;
+      const char* p = range_start(in->text, in->size, lo);
+      const char* end = in->text + hi;
+      const char* limit = in->text + in->size;
+      uint32_t key, max = 0;
+      while (!failed && next_key(&p, end, limit, &key)) {
+        failed |= key_push(&shares[t], key) != 0;
+        if (key > max) max = key;
+      }
+      maxes[t] = max;
+    }
+  } else {
+#pragma omp parallel num_threads(nt)
+    {
+      int t = omp_get_thread_num();
+      size_t lo = in->n * t / nt, hi = in->n * (t + 1) / nt;
+      uint32_t max = 0;
+      for (size_t i = lo; i < hi; i++)
+        if (in->keys[i] > max) max = in->keys[i];
+      shares[t].keys = (uint32_t*)in->keys + lo;  // not owned
+      shares[t].n = hi - lo;
+      maxes[t] = max;
+    }
+  }
+
+  *max_key = 0;
+  *items = 0;
+  for (int t = 0; t < nt; t++) {
+    if (maxes[t] > *max_key) *max_key = maxes[t];
+    *items += shares[t].n;
+  }
+  int bits = 1;
+  while (bits < 32 && (*max_key >> bits) != 0) bits++;
+  // at least a few ranges per thread, at most 2^DENSE_BITS keys per range
+  int part_bits = 0;
+  while ((1 << part_bits) < 4 * nt && part_bits < bits) part_bits++;
+  if (bits - part_bits > DENSE_BITS)
+    part_bits = bits - DENSE_BITS;
+  int shift = bits - part_bits;
+  int np = 1 << part_bits;
+
+  // offsets[t * np + p]: where thread t scatters its keys of range p
+  size_t* offsets = calloc((size_t)nt * np, sizeof(size_t));
+  size_t* starts = malloc((np + 1) * sizeof(size_t));
+  uint32_t* scattered = malloc((*items > 0 ? *items : 1) * sizeof(uint32_t));
+  Partition* parts = calloc(np, sizeof(Partition));
+  if (failed || !offsets || !starts || !scattered || !parts) {
+    failed = 1;
+  } else {
+#pragma omp parallel for num_threads(nt) schedule(static)
+    for (int t = 0; t < nt; t++)
+      for (size_t i = 0; i < shares[t].n; i++)
+        offsets[(size_t)t * np + (shares[t].keys[i] >> shift)]++;
+
+    // exclusive prefix sum in (range, thread) order keeps every range contiguous
+    size_t sum = 0;
+    for (int p = 0; p < np; p++) {
+      starts[p] = sum;
+      for (int t = 0; t < nt; t++) {
+        size_t c = offsets[(size_t)t * np + p];
+        offsets[(size_t)t * np + p] = sum;
+        sum += c;
+      }
+    }
+    starts[np] = sum;
+
+#pragma omp parallel for num_threads(nt) schedule(static)
+    for (int t = 0; t < nt; t++) {
+      size_t* mine = &offsets[(size_t)t * np];
+      for (size_t i = 0; i < shares[t].n; i++) {
+        uint32_t key = shares[t].keys[i];
+        scattered[mine[key >> shift]++] = key;
+      }
+      if (in->text) {
+        free(shares[t].keys);
+        shares[t].keys = NULL;
+      }
+    }
+
+#pragma omp parallel num_threads(nt) reduction(| : failed)
+    {
+      uint64_t* dense = NULL;  // only for the dense ranges
+#pragma omp for schedule(dynamic, 1)
+      for (int p = 0; p < np; p++) {
+        uint32_t base = (uint32_t)p << shift;
+        size_t n = starts[p + 1] - starts[p];
+        if (n < ((size_t)1 << shift) / SPARSE_RATIO) {
+          // sort, then equal keys are adjacent
+          KeyCount* e = malloc((n > 0 ? n : 1) * sizeof(KeyCount));
+          parts[p].entries = e;
+          if (!e) {
+            failed = 1;
+            continue;
+          }
+          for (size_t i = 0; i < n; i++)
+            e[i] = (KeyCount){scattered[starts[p] + i], 1};
+          if (sort_by_key(e, n, base, (uint64_t)1 << shift) != 0) {
+            failed = 1;
+            continue;
+          }
+          for (size_t i = 0; i < n; i++) {
+            if (parts[p].n > 0 && e[parts[p].n - 1].key == e[i].key)
+              e[parts[p].n - 1].count++;
+            else
+              e[parts[p].n++] = e[i];
+          }
+          continue;
+        }
+        if (!dense && !(dense = calloc((size_t)1 << shift, sizeof(uint64_t)))) {
+          failed = 1;
+          continue;
+        }
+        size_t distinct = 0;
+        for (size_t i = starts[p]; i < starts[p + 1]; i++)
+          distinct += dense[scattered[i] - base]++ == 0;
+        parts[p].entries = malloc((distinct > 0 ? distinct : 1) * sizeof(KeyCount));
+        if (!parts[p].entries) {
+          failed = 1;
+          continue;
+        }
+        // emit and clear only the touched part of the array
+        for (uint64_t k = 0; parts[p].n < distinct; k++) {
+          if (dense[k]) {
+            parts[p].entries[parts[p].n++] = (KeyCount){base + (uint32_t)k, dense[k]};
+            dense[k] = 0;
+          }
+        }
+      }
+      free(dense);
+    }
+  }
+
+  if (in->text)
+    for (int t = 0; t < nt; t++)
+      free(shares[t].keys);
+  free(shares);
+  free(maxes);
+  free(offsets);
+  free(starts);
+  free(scattered);
+  if (failed) {
+    for (int p = 0; parts && p < np; p++)
+      free(parts[p].entries);
+    free(parts);
+    return NULL;
+  }
+  *n_parts = np;
+  return parts;
+}
+
+// ranges in key order, "val count" lines or RealCount records
+static int write_counts(const char* path, const Partition* parts, int np, int binary) {
+  FILE* f = fopen(path, binary ? "wb" : "w");
+  if (!f)
+    return -1;
+  setvbuf(f, NULL, _IOFBF, 8u << 20);
+  for (int p = 0; p < np; p++) {
+    for (size_t i = 0; i < parts[p].n; i++) {
+      const KeyCount* e = &parts[p].entries[i];
+      if (!binary) {
+        fprintf(f, "%u %llu\n", e->key, (unsigned long long)e->count);
+        continue;
+      }
+      // counts past the uint32 field take several records, as the RLE runs
+      for (uint64_t left = e->count; left > 0;) {
+        RealCount rc = {e->key, left > UINT32_MAX ? UINT32_MAX : (uint32_t)left};
+        fwrite(&rc, sizeof(rc), 1, f);
+        left -= rc.count;
+      }
+    }
+  }
+  int status = ferror(f) ? -1 : 0;
+  if (fclose(f) != 0)
+    status = -1;
+  return status;
+}
+
+// total_<name> in folder, or next to the input; --format=bin adds .bin
+static char* output_path(const CountConfig* cfg) {
+  const char* slash = strrchr(cfg->input, '/');
+  const char* name = slash ? slash + 1 : cfg->input;
+  const char* suffix = cfg->binary ? ".bin" : "";
+  size_t dir_len = cfg->folder ? strlen(cfg->folder) : (size_t)(name - cfg->input);
+  size_t len = dir_len + strlen(name) + 16;
+  char* path = malloc(len);
+  if (!path)
+    return NULL;
+  if (cfg->folder) {
+    int sep = dir_len > 0 && cfg->folder[dir_len - 1] != '/';
+    snprintf(path, len, "%s%stotal_%s%s", cfg->folder, sep ? "/" : "", name, suffix);
+  } else {
+    snprintf(path, len, "%.*stotal_%s%s", (int)dir_len, cfg->input, name, suffix);
+  }
+  return path;
+}
+
+static int parse_config(int argc, char* argv[], CountConfig* cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->mode = MODE_HASH;
+
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* eq = strchr(arg, '=');
+    const char* v = eq ? eq + 1 : "";
+    if (strncmp(arg, "--", 2) != 0) {
+      if (positional == 0)
+        cfg->input = arg;
+      else if (positional == 1)
+        cfg->folder = arg;
+      positional++;
+    } else if (strncmp(arg, "--mode=", 7) == 0) {
+      if (strcmp(v, "hash") == 0) {
+        cfg->mode = MODE_HASH;
+      } else if (strcmp(v, "radix") == 0) {
+        cfg->mode = MODE_RADIX;
+      } else {
+        fprintf(stderr, "Error: --mode expects hash or radix\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--format=", 9) == 0) {
+      if (strcmp(v, "text") == 0) {
+        cfg->binary = 0;
+      } else if (strcmp(v, "bin") == 0) {
+        cfg->binary = 1;
+      } else {
+        fprintf(stderr, "Error: --format expects text or bin\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      cfg->threads = atoi(v);
+      if (cfg->threads <= 0) {
+        fprintf(stderr, "Error: --threads must be positive\n");
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", arg);
+      return -1;
+    }
+  }
+  if (positional < 1 || positional > 2) {
+    fprintf(stderr, "Error: expected a dataset and an optional output folder\n");
+    return -1;
+  }
+  return 0;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s <dataset> [output_folder] [options]\n"
+          "  writes total_<dataset> (\"val count\" lines sorted by key) next to the dataset\n"
+          "  or in output_folder; the dataset is text (one key per line), .bin (uint32) or .rle\n"
+          "  --mode=m           hash (default, per-thread tables) or radix (key-range\n"
+          "                     partitions, for many distinct keys; .rle input is always hashed)\n"
+          "  --format=fmt       text (default) or bin (RealCount records, total_<dataset>.bin)\n"
+          "  --threads=n        OpenMP threads\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  CountConfig cfg;
+  if (parse_config(argc, argv, &cfg) != 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (cfg.threads > 0)
+    omp_set_num_threads(cfg.threads);
+  int nt = omp_get_max_threads();
+
+  double t_start = omp_get_wtime();
+  Input in;
+  if (map_input(cfg.input, &in) != 0) {
+    perror(cfg.input);
+    return 1;
+  }
+  if (in.runs && cfg.mode == MODE_RADIX)
+    cfg.mode = MODE_HASH;
+
+  uint32_t max_key = 0;
+  uint64_t items = 0;
+  int np = nt;
+  Partition* parts = cfg.mode == MODE_RADIX ? count_radix(&in, nt, &max_key, &items, &np)
+                                            : count_hash(&in, nt, &max_key, &items);
+  if (!parts) {
+    fprintf(stderr, "Error allocating the counters\n");
+    return 1;
+  }
+  double t_count = omp_get_wtime();
+
+  char* out = output_path(&cfg);
+  if (!out || write_counts(out, parts, np, cfg.binary) != 0) {
+    fprintf(stderr, "Error writing %s\n", out ? out : "the counts");
+    return 1;
+  }
+  double t_end = omp_get_wtime();
+
+  size_t distinct = 0;
+  for (int p = 0; p < np; p++)
+    distinct += parts[p].n;
+  printf("%s: %llu items, %zu distinct keys (max %u), %s mode, %d threads\n", out,
+         (unsigned long long)items, distinct, max_key, cfg.mode == MODE_RADIX ? "radix" : "hash", nt);
+  printf("count %.3f s (%.1f Mitems/s), write %.3f s\n", t_count - t_start,
+         items / (t_count - t_start) / 1e6, t_end - t_count);
+
+  for (int p = 0; p < np; p++)
+    free(parts[p].entries);
+  free(parts);
+  free(out);
+  if (in.map)
+    munmap(in.map, in.size);
+  return 0;
+}
@@ -0,0 +1,422 @@
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/cms_ingest.h"
+
+/*
+ * Parallel dataset generator
+ * the distributions of scripts/gen_datasets.py (10% 123, 10% 456, 10% 100-110,
+ * the rest 1000-9999) and scripts/dataset_generator.py (Pareto), plus Zipf and
+ * uniform keys, written as text (one key per line), raw uint32 or the binary RLE
+ * format of the drivers. Item i is drawn from a counter-based stream indexed by
+ * i alone, so the output only depends on the seed, never on the thread count.
+ * Sorted output is a counting sort of the key histogram: no item is kept in memory.
+ *
+ *   ./cms_gen 1000000000 data/dataset_1000000000.txt
+ *   ./cms_gen 1000000000 data/dataset_1000000000_sorted.rle --sorted --dist=zipf --skew=1.2
+ */
+
+typedef enum { DIST_MIX, DIST_PARETO, DIST_ZIPF, DIST_UNIFORM } GenDist;
+typedef enum { OUT_TEXT, OUT_BIN, OUT_RLE } GenFormat;
+
+static const char* DIST_NAMES[] = {"mix", "pareto", "zipf", "uniform"};
+static const char* FORMAT_NAMES[] = {"text", "bin", "rle"};
+
+#define GEN_BLOCK (1u << 22)       // items generated and written per round
+#define GEN_MAX_DIGITS 11          // "4294967295\n"
+#define GEN_SORT_MAX (1u << 26)    // largest key range the sorted output accepts
+#define MIX_KEYS 10000             // keys of the mix are below this
+
+typedef struct {
+  uint64_t n;
+  const char* out;
+  GenDist dist;
+  double skew;        // zipf exponent
+  double alpha;       // pareto shape
+  uint32_t universe;  // keys in [0, universe) for pareto, zipf and uniform
+  uint64_t seed;
+  int sorted;
+  GenFormat format;
+  int threads;        // 0 = OpenMP default
+} GenConfig;
+
+typedef struct {
+  GenConfig cfg;
+  double* zipf_cdf;    // cumulative weights of the zipf ranks
+  uint64_t* cum;       // sorted output: items with a key <= k
+  uint32_t n_keys;     // keys in [0, n_keys) can occur
+} Gen;
+
+// splitmix64 is counter-based: output i is a bijective mix of seed + (i + 1) * gamma
+static inline uint64_t counter_random(uint64_t seed, uint64_t i) {
+  uint64_t z = seed + (i + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static inline double counter_unit(uint64_t seed, uint64_t i) {
+  return (counter_random(seed, i) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// key of item i, two draws per item: 2i and 2i + 1
+static inline uint32_t draw(const Gen* g, uint64_t i) {
+  const GenConfig* cfg = &g->cfg;
+  double u = counter_unit(cfg->seed, 2 * i);
+  uint64_t r = counter_random(cfg->seed, 2 * i + 1);
+
+  switch (cfg->dist) {
+    case DIST_MIX:
+      if (u < 0.10) return 123;
+      if (u < 0.20) return 456;
+      if (u < 0.30) return 100 + (uint32_t)(r % 11);
+      return 1000 + (uint32_t)(r % 9000);
+    case DIST_PARETO: {
+      // numpy's pareto (Lomax) scaled to the key range and clipped, as dataset_generator.py
+      double x = (pow(1.0 - u, -1.0 / cfg->alpha) - 1.0) * (cfg->universe - 1);
+      return x >= cfg->universe - 1 ? cfg->universe - 1 : (uint32_t)x;
+    }
+    case DIST_ZIPF: {
+      // inverse CDF, key 0 is the most frequent
+      double target = u * g->zipf_cdf[cfg->universe - 1];
+      uint32_t lo = 0, hi = cfg->universe - 1;
+      while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (g->zipf_cdf[mid] < target)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      return lo;
+    }
+    default:
+      return (uint32_t)(r % cfg->universe);
+  }
+}
+
+// key at position i of the sorted output
+static uint32_t sorted_key(const Gen* g, uint64_t i) {
+  uint32_t lo = 0, hi = g->n_keys - 1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (g->cum[mid] <= i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// keys [lo, lo + n) of the output stream, each thread fills a contiguous slice
+static void fill_block(const Gen* g, uint64_t lo, uint32_t* keys, size_t n) {
+#pragma omp parallel
+  {
+    size_t t = omp_get_thread_num(), nt = omp_get_num_threads();
+    size_t begin = n * t / nt, end = n * (t + 1) / nt;
+    if (g->cum) {
+      // walk the histogram from the key of the slice start
+      uint32_t k = begin < end ? sorted_key(g, lo + begin) : 0;
+      for (size_t i = begin; i < end; i++) {
+        while (g->cum[k] <= lo + i) k++;
+        keys[i] = k;
+      }
+    } else {
+      for (size_t i = begin; i < end; i++)
+        keys[i] = draw(g, lo + i);
+    }
+  }
+}
+
+// histogram of all n draws into cum, then prefix sums
+static int build_histogram(Gen* g) {
+  uint32_t n_keys = g->n_keys;
+  uint64_t* hist = calloc(n_keys, sizeof(uint64_t));
+  if (!hist)
+    return -1;
+  uint64_t n = g->cfg.n;
+  int nt = omp_get_max_threads();
+  uint64_t* priv = calloc((size_t)nt * n_keys, sizeof(uint64_t));
+
+  if (priv) {
+#pragma omp parallel num_threads(nt)
+    {
+      uint64_t* mine = priv + (size_t)omp_get_thread_num() * n_keys;
+#pragma omp for schedule(static)
+      for (uint64_t i = 0; i < n; i++)
+        mine[draw(g, i)]++;
+      // every thread sums a range of keys over the private histograms
+#pragma omp for schedule(static)
+      for (uint32_t k = 0; k < n_keys; k++)
+        for (int t = 0; t < nt; t++)
+          hist[k] += priv[(size_t)t * n_keys + k];
+    }
+    free(priv);
+  } else {
+    // no room for private histograms, count straight into the shared one
+#pragma omp parallel for schedule(static)
+    for (uint64_t i = 0; i < n; i++) {
+      uint32_t k = draw(g, i);
+#pragma omp atomic
+      hist[k]++;
+    }
+  }
+  for (uint32_t k = 1; k < n_keys; k++)
+    hist[k] += hist[k - 1];
+  g->cum = hist;
+  return 0;
+}
+
+// keys as decimal lines, formatted in parallel into one buffer per slice, written in order
+static int write_text(FILE* f, const uint32_t* keys, size_t n, char** bufs, int n_slices) {
+  size_t lens[n_slices];
+#pragma omp parallel for schedule(static)
+  for (int t = 0; t < n_slices; t++) {
+    size_t begin = n * t / n_slices, end = n * (t + 1) / n_slices;
+    char* p = bufs[t];
+    for (size_t i = begin; i < end; i++) {
+      char digits[GEN_MAX_DIGITS];
+      int d = 0;
+      uint32_t v = keys[i];
+      do {
+        digits[d++] = (char)('0' + v % 10);
+        v /= 10;
+      } while (v);
+      while (d) *p++ = digits[--d];
+      *p++ = '\n';
+    }
+    lens[t] = (size_t)(p - bufs[t]);
+  }
+  for (int t = 0; t < n_slices; t++)
+    if (fwrite(bufs[t], 1, lens[t], f) != lens[t])
+      return -1;
+  return 0;
+}
+
+// runs of consecutive equal keys, the last run stays pending: the next block may extend it
+static int write_runs(FILE* f, const uint32_t* keys, size_t n, ItemRun* runs, ItemRun* pending) {
+  size_t n_runs = collapse_runs(keys, n, runs);
+  for (size_t r = 0; r < n_runs; r++) {
+    if (pending->count > 0 && pending->key == runs[r].key &&
+        (uint64_t)pending->count + runs[r].count <= UINT32_MAX) {
+      pending->count += runs[r].count;
+      continue;
+    }
+    if (pending->count > 0 && fwrite(pending, sizeof(ItemRun), 1, f) != 1)
+      return -1;
+    *pending = runs[r];
+  }
+  return 0;
+}
+
+// sorted RLE straight from the histogram: one run per key, split above UINT32_MAX
+static int write_sorted_runs(FILE* f, const Gen* g) {
+  uint64_t prev = 0;
+  for (uint32_t k = 0; k < g->n_keys; k++) {
+    uint64_t count = g->cum[k] - prev;
+    prev = g->cum[k];
+    while (count > 0) {
+      ItemRun run = {k, count > UINT32_MAX ? UINT32_MAX : (uint32_t)count};
+      if (fwrite(&run, sizeof(run), 1, f) != 1)
+        return -1;
+      count -= run.count;
+    }
+  }
+  return 0;
+}
+
+static int generate(Gen* g, FILE* f) {
+  const GenConfig* cfg = &g->cfg;
+  if (cfg->sorted && cfg->format == OUT_RLE)
+    return write_sorted_runs(f, g);
+
+  int nt = omp_get_max_threads();
+  uint32_t* keys = malloc(GEN_BLOCK * sizeof(uint32_t));
+  ItemRun* runs = cfg->format == OUT_RLE ? malloc(GEN_BLOCK * sizeof(ItemRun)) : NULL;
+  char** bufs = calloc(nt, sizeof(char*));
+  int status = keys && bufs && (runs || cfg->format != OUT_RLE) ? 0 : -1;
+  for (int t = 0; status == 0 && cfg->format == OUT_TEXT && t < nt; t++) {
+    // one text slice per thread, a slice holds at most GEN_BLOCK / nt + 1 keys
+    bufs[t] = malloc((GEN_BLOCK / nt + 1) * GEN_MAX_DIGITS);
+    if (!bufs[t]) status = -1;
+  }
+
+  ItemRun pending = {0, 0};
+  for (uint64_t lo = 0; status == 0 && lo < cfg->n; lo += GEN_BLOCK) {
+    size_t n = cfg->n - lo < GEN_BLOCK ? (size_t)(cfg->n - lo) : GEN_BLOCK;
+    fill_block(g, lo, keys, n);
+    if (cfg->format == OUT_TEXT)
+      status = write_text(f, keys, n, bufs, nt);
+    else if (cfg->format == OUT_BIN)
+      status = fwrite(keys, sizeof(uint32_t), n, f) == n ? 0 : -1;
+    else
+      status = write_runs(f, keys, n, runs, &pending);
+  }
+  if (status == 0 && pending.count > 0 && fwrite(&pending, sizeof(ItemRun), 1, f) != 1)
+    status = -1;
+
+  for (int t = 0; bufs && t < nt; t++)
+    free(bufs[t]);
+  free(bufs);
+  free(runs);
+  free(keys);
+  return status;
+}
+
+static int parse_config(int argc, char* argv[], GenConfig* cfg) {
+  cfg->n = 0;
+  cfg->out = NULL;
+  cfg->dist = DIST_MIX;
+  cfg->skew = 1.1;
+  cfg->alpha = 2.0;
+  cfg->universe = 10000;
+  cfg->seed = 12345;
+  cfg->sorted = 0;
+  cfg->format = OUT_TEXT;
+  cfg->threads = 0;
+
+  int format_set = 0, positional = 0;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* eq = strchr(arg, '=');
+    const char* v = eq ? eq + 1 : "";
+    if (strncmp(arg, "--", 2) != 0) {
+      if (positional == 0)
+        cfg->n = strtoull(arg, NULL, 10);
+      else if (positional == 1)
+        cfg->out = arg;
+      positional++;
+    } else if (strncmp(arg, "--dist=", 7) == 0) {
+      int found = 0;
+      for (int d = DIST_MIX; d <= DIST_UNIFORM; d++) {
+        if (strcmp(v, DIST_NAMES[d]) == 0) {
+          cfg->dist = (GenDist)d;
+          found = 1;
+        }
+      }
+      if (!found) {
+        fprintf(stderr, "Error: --dist expects mix, pareto, zipf or uniform\n");
+        return -1;
+      }
+    } else if (strncmp(arg, "--format=", 9) == 0) {
+      int found = 0;
+      for (int o = OUT_TEXT; o <= OUT_RLE; o++) {
+        if (strcmp(v, FORMAT_NAMES[o]) == 0) {
+          cfg->format = (GenFormat)o;
+          found = 1;
+        }
+      }
+      if (!found) {
+        fprintf(stderr, "Error: --format expects text, bin or rle\n");
+        return -1;
+      }
+      format_set = 1;
+    } else if (strncmp(arg, "--skew=", 7) == 0) {
+      cfg->skew = strtod(v, NULL);
+    } else if (strncmp(arg, "--alpha=", 8) == 0) {
+      cfg->alpha = strtod(v, NULL);
+    } else if (strncmp(arg, "--universe=", 11) == 0) {
+      cfg->universe = (uint32_t)strtoul(v, NULL, 10);
+    } else if (strncmp(arg, "--seed=", 7) == 0) {
+      cfg->seed = strtoull(v, NULL, 10);
+    } else if (strcmp(arg, "--sorted") == 0) {
+      cfg->sorted = 1;
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      cfg->threads = atoi(v);
+    } else if (strcmp(arg, "--help") == 0) {
+      return -1;
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", arg);
+      return -1;
+    }
+  }
+  if (positional != 2 || cfg->n == 0) {
+    fprintf(stderr, "Error: expected the number of items and the output file\n");
+    return -1;
+  }
+  // .rle files are what the drivers read as runs
+  if (!format_set && is_rle_file(cfg->out))
+    cfg->format = OUT_RLE;
+  if (cfg->universe == 0 || cfg->skew <= 0 || cfg->alpha <= 0 || cfg->threads < 0) {
+    fprintf(stderr, "Error: universe, skew, alpha and threads must be positive\n");
+    return -1;
+  }
+  if (cfg->sorted && cfg->dist != DIST_MIX && cfg->universe > GEN_SORT_MAX) {
+    fprintf(stderr, "Error: --sorted supports a universe of at most %u keys\n", GEN_SORT_MAX);
+    return -1;
+  }
+  return 0;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s <items> <output_file> [options]\n"
+          "  --dist=name        mix (default: 10%% 123, 10%% 456, 10%% 100-110, 70%% 1000-9999),\n"
+          "                     pareto, zipf or uniform over [0, universe)\n"
+          "  --skew=s           zipf exponent (default 1.1)\n"
+          "  --alpha=a          pareto shape (default 2.0)\n"
+          "  --universe=u       distinct keys of pareto, zipf and uniform (default 10000)\n"
+          "  --sorted           keys in ascending order\n"
+          "  --format=fmt       text (one key per line), bin (uint32) or rle (key, count pairs),\n"
+          "                     default text, rle for .rle files\n"
+          "  --seed=n           the output only depends on the seed (default 12345)\n"
+          "  --threads=n        OpenMP threads\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  Gen g;
+  memset(&g, 0, sizeof(g));
+  if (parse_config(argc, argv, &g.cfg) != 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  GenConfig* cfg = &g.cfg;
+  if (cfg->threads > 0)
+    omp_set_num_threads(cfg->threads);
+
+  double t_start = omp_get_wtime();
+
+  if (cfg->dist == DIST_ZIPF) {
+    g.zipf_cdf = malloc(cfg->universe * sizeof(double));
+    if (!g.zipf_cdf) {
+      fprintf(stderr, "Error allocating the zipf table\n");
+      return 1;
+    }
+    double sum = 0;
+    for (uint32_t k = 0; k < cfg->universe; k++)
+      g.zipf_cdf[k] = (sum += 1.0 / pow(k + 1.0, cfg->skew));
+  }
+
+  g.n_keys = cfg->dist == DIST_MIX ? MIX_KEYS : cfg->universe;
+  if (cfg->sorted && build_histogram(&g) != 0) {
+    fprintf(stderr, "Error allocating the histogram\n");
+    return 1;
+  }
+
+  FILE* f = fopen(cfg->out, "wb");
+  if (!f) {
+    perror("fopen");
+    return 1;
+  }
+  setvbuf(f, NULL, _IOFBF, 8u << 20);
+  int status = generate(&g, f);
+  if (fclose(f) != 0)
+    status = -1;
+  if (status != 0) {
+    fprintf(stderr, "Error writing %s\n", cfg->out);
+    return 1;
+  }
+
+  double elapsed = omp_get_wtime() - t_start;
+  printf("%s: %llu %s%s items (%s) in %.2f s, %d threads, %.1f Mitems/s\n", cfg->out,
+         (unsigned long long)cfg->n, cfg->sorted ? "sorted " : "", DIST_NAMES[cfg->dist],
+         FORMAT_NAMES[cfg->format], elapsed, omp_get_max_threads(), cfg->n / elapsed / 1e6);
+
+  free(g.cum);
+  free(g.zipf_cdf);
+  return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef CMS_PROTOCOL_H
+#define CMS_PROTOCOL_H
+
+#include <stdint.h>
+
+// Binary protocol of cms_serve, host byte order (the socket is local).
+// A request is a RequestHeader followed by its payload, a response a
+// ResponseHeader followed by bytes of payload. Requests may be pipelined:
+// a client can send many before reading, the responses come back in order.
+//
+//   op          n                  request payload          response payload
+//   CMS_POINT   1                  uint32 key               uint32 estimate
+//   CMS_BATCH   keys               n x uint32 key           n x uint32 estimate
+//   CMS_RANGE   0                  uint32 lo, uint32 hi     uint64 sum of the estimates of [lo, hi]
+//   CMS_TOPK    k                  uint32 lo, uint32 hi     up to k x CmsKeyEstimate, largest first
+//   CMS_INNER   0                  uint32 other sketch      uint64 inner product with it
+//   CMS_INFO    0                  -                        CmsInfo
+//   CMS_STATS   0                  -                        JSON text: requests and latency percentiles
+//
+// sketch selects one of the snapshots given to the server (0 = the first).
+
+#define CMS_MAX_KEYS (1u << 20)   // keys of a batch
+#define CMS_MAX_RANGE (1u << 26)  // keys of a range or top-k scan
+#define CMS_MAX_TOPK 4096
+
+typedef enum {
+  CMS_POINT = 1,
+  CMS_BATCH,
+  CMS_RANGE,
+  CMS_TOPK,
+  CMS_INNER,
+  CMS_INFO,
+  CMS_STATS,
+} CmsOp;
+
+typedef enum {
+  CMS_OK = 0,
+  CMS_EBADOP,      // unknown op
+  CMS_EBADSKETCH,  // no such sketch
+  CMS_ETOOBIG,     // over one of the limits above
+  CMS_EMISMATCH,   // inner product of sketches of different shapes
+} CmsStatus;
+
+typedef struct {
+  uint8_t op;
+  uint8_t sketch;
+  uint16_t reserved;
+  uint32_t n;
+} RequestHeader;
+
+typedef struct {
+  uint32_t status;
+  uint32_t bytes;  // payload that follows
+} ResponseHeader;
+
+typedef struct {
+  uint32_t key;
+  uint32_t estimate;
+} CmsKeyEstimate;
+
+typedef struct {
+  uint32_t depth;
+  uint32_t width;
+  uint64_t total;
+  double epsilon;
+  double delta;
+  uint32_t sketches;
+  uint32_t threads;
+} CmsInfo;
+
+// request payload bytes beyond the header
+static inline uint64_t cms_request_bytes(const RequestHeader* h) {
+  switch (h->op) {
+    case CMS_POINT: return sizeof(uint32_t);
+    case CMS_BATCH: return (uint64_t)h->n * sizeof(uint32_t);
+    case CMS_RANGE:
+    case CMS_TOPK: return 2 * sizeof(uint32_t);
+    case CMS_INNER: return sizeof(uint32_t);
+    default: return 0;
+  }
+}
+
+#endif  // CMS_PROTOCOL_H
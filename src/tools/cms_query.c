@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cms_protocol.h"
+
+/*
+ * Client of cms_serve: one query from the command line, or a load generator
+ *   ./cms_query /tmp/cms.sock point 123
+ *   ./cms_query /tmp/cms.sock topk 10 0 9999
+ *   ./cms_query /tmp/cms.sock bench --threads=4 --batch=64 --pipeline=16
+ * bench runs one connection per thread, each keeping --pipeline requests of
+ * --batch uniform random keys in flight (--batch=1 sends CMS_POINT), and
+ * reports the keys per second and the round-trip latency percentiles.
+ */
+
+typedef struct {
+  const char* socket;
+  int sketch;
+  int threads;
+  uint32_t batch;
+  uint32_t pipeline;
+  uint64_t requests;  // per thread
+  uint32_t universe;
+  uint64_t seed;
+} QueryConfig;
+
+typedef struct {
+  const QueryConfig* cfg;
+  int id;
+  uint64_t* latencies;  // ns, one per request
+  uint64_t keys;
+  int failed;
+} BenchThread;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int connect_to(const char* path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int send_all(int fd, const void* buf, size_t n) {
+  for (size_t done = 0; done < n;) {
+    ssize_t w = write(fd, (const char*)buf + done, n - done);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return -1;
+    done += (size_t)w;
+  }
+  return 0;
+}
+
+static int recv_all(int fd, void* buf, size_t n) {
+  for (size_t done = 0; done < n;) {
+    ssize_t r = read(fd, (char*)buf + done, n - done);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return -1;
+    done += (size_t)r;
+  }
+  return 0;
+}
+
+// one request, the payload of the response goes to a new buffer (free it)
+static int request(int fd, uint8_t op, int sketch, uint32_t n, const void* payload, size_t bytes,
+                   ResponseHeader* rh, char** response) {
+  RequestHeader h = {op, (uint8_t)sketch, 0, n};
+  if (send_all(fd, &h, sizeof(h)) != 0 || (bytes > 0 && send_all(fd, payload, bytes) != 0) ||
+      recv_all(fd, rh, sizeof(*rh)) != 0)
+    return -1;
+  *response = malloc(rh->bytes + 1);
+  if (!*response || recv_all(fd, *response, rh->bytes) != 0)
+    return -1;
+  (*response)[rh->bytes] = '\0';
+  return 0;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static void* bench_main(void* arg) {
+  BenchThread* bt = arg;
+  const QueryConfig* cfg = bt->cfg;
+  int fd = connect_to(cfg->socket);
+  uint8_t op = cfg->batch == 1 ? CMS_POINT : CMS_BATCH;
+  size_t req_bytes = sizeof(RequestHeader) + cfg->batch * sizeof(uint32_t);
+  size_t resp_bytes = sizeof(ResponseHeader) + cfg->batch * sizeof(uint32_t);
+  char* out = malloc(req_bytes * cfg->pipeline);
+  char* in = malloc(resp_bytes * cfg->pipeline);
+  if (fd < 0 || !out || !in) {
+    bt->failed = 1;
+    free(out);
+    free(in);
+    return NULL;
+  }
+  uint64_t rng = cfg->seed + (uint64_t)bt->id * 0x632BE59BD9B4E019ULL;
+
+  // windows of --pipeline requests sent with one write, then their responses
+  for (uint64_t done = 0; done < cfg->requests && !bt->failed;) {
+    uint32_t w = cfg->requests - done < cfg->pipeline ? (uint32_t)(cfg->requests - done) : cfg->pipeline;
+    for (uint32_t r = 0; r < w; r++) {
+      RequestHeader h = {op, (uint8_t)cfg->sketch, 0, cfg->batch};
+      char* p = out + r * req_bytes;
+      memcpy(p, &h, sizeof(h));
+      uint32_t* keys = (uint32_t*)(p + sizeof(h));
+      for (uint32_t k = 0; k < cfg->batch; k++)
+        keys[k] = (uint32_t)(splitmix64(&rng) % cfg->universe);
+    }
+    uint64_t t_sent = now_ns();
+    if (send_all(fd, out, w * req_bytes) != 0) {
+      bt->failed = 1;
+      break;
+    }
+    for (uint32_t r = 0; r < w; r++) {
+      ResponseHeader* rh = (ResponseHeader*)(in + r * resp_bytes);
+      if (recv_all(fd, rh, resp_bytes) != 0 || rh->status != CMS_OK) {
+        bt->failed = 1;
+        break;
+      }
+      bt->latencies[done + r] = now_ns() - t_sent;
+    }
+    bt->keys += (uint64_t)w * cfg->batch;
+    done += w;
+  }
+  close(fd);
+  free(out);
+  free(in);
+  return NULL;
+}
+
+static int compare_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int run_bench(const QueryConfig* cfg) {
+  BenchThread* bts = calloc(cfg->threads, sizeof(BenchThread));
+  pthread_t* tids = malloc(cfg->threads * sizeof(pthread_t));
+  uint64_t* all = malloc(cfg->threads * cfg->requests * sizeof(uint64_t));
+  if (!bts || !tids || !all) {
+    fprintf(stderr, "Error allocating the benchmark\n");
+    return 1;
+  }
+  uint64_t t_start = now_ns();
+  for (int t = 0; t < cfg->threads; t++) {
+    bts[t] = (BenchThread){cfg, t, all + t * cfg->requests, 0, 0};
+    pthread_create(&tids[t], NULL, bench_main, &bts[t]);
+  }
+  uint64_t keys = 0;
+  int failed = 0;
+  for (int t = 0; t < cfg->threads; t++) {
+    pthread_join(tids[t], NULL);
+    keys += bts[t].keys;
+    failed |= bts[t].failed;
+  }
+  double elapsed = (now_ns() - t_start) * 1e-9;
+  if (failed) {
+    fprintf(stderr, "Error: a benchmark connection failed\n");
+    return 1;
+  }
+
+  uint64_t n = cfg->threads * cfg->requests;
+  qsort(all, n, sizeof(uint64_t), compare_u64);
+  uint64_t p50 = all[(n - 1) / 2], p99 = all[(uint64_t)(0.99 * (n - 1))], p999 = all[(uint64_t)(0.999 * (n - 1))];
+  printf("{\"threads\":%d,\"batch\":%u,\"pipeline\":%u,\"requests\":%llu,\"keys\":%llu,\"seconds\":%.6f,"
+         "\"keys_per_s\":%.0f,\"requests_per_s\":%.0f,\"rtt_ns\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+         cfg->threads, cfg->batch, cfg->pipeline, (unsigned long long)n, (unsigned long long)keys, elapsed,
+         keys / elapsed, n / elapsed, (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999,
+         (unsigned long long)all[n - 1]);
+  free(bts);
+  free(tids);
+  free(all);
+  return 0;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s <socket> <command> [arguments] [options]\n"
+          "  point KEY | batch KEY... | range LO HI | topk K LO HI | inner SKETCH | info | stats | bench\n"
+          "  --sketch=i         sketch queried (default 0)\n"
+          "bench options:\n"
+          "  --threads=n        connections, one thread each (default 4)\n"
+          "  --batch=b          keys per request, 1 = point queries (default 1)\n"
+          "  --pipeline=p       requests in flight per connection (default 16)\n"
+          "  --requests=n       requests per connection (default 100000)\n"
+          "  --universe=u       keys drawn from [0, u) (default 10000)\n"
+          "  --seed=n           key stream seed (default 12345)\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  QueryConfig cfg = {NULL, 0, 4, 1, 16, 100000, 10000, 12345};
+  const char* args[CMS_MAX_TOPK];
+  int n_args = 0;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = strchr(a, '=') ? strchr(a, '=') + 1 : "";
+    if (strncmp(a, "--sketch=", 9) == 0) cfg.sketch = atoi(v);
+    else if (strncmp(a, "--threads=", 10) == 0) cfg.threads = atoi(v);
+    else if (strncmp(a, "--batch=", 8) == 0) cfg.batch = (uint32_t)strtoul(v, NULL, 10);
+    else if (strncmp(a, "--pipeline=", 11) == 0) cfg.pipeline = (uint32_t)strtoul(v, NULL, 10);
+    else if (strncmp(a, "--requests=", 11) == 0) cfg.requests = strtoull(v, NULL, 10);
+    else if (strncmp(a, "--universe=", 11) == 0) cfg.universe = (uint32_t)strtoul(v, NULL, 10);
+    else if (strncmp(a, "--seed=", 7) == 0) cfg.seed = strtoull(v, NULL, 10);
+    else if (strncmp(a, "--", 2) == 0) {
+      fprintf(stderr, "Error: unknown option %s\n", a);
+      print_usage(argv[0]);
+      return 1;
+    } else if (n_args < CMS_MAX_TOPK) {
+      args[n_args++] = a;
+    }
+  }
+  if (n_args < 2 || cfg.threads <= 0 || cfg.batch == 0 || cfg.batch > CMS_MAX_KEYS || cfg.pipeline == 0 ||
+      cfg.requests == 0 || cfg.universe == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  cfg.socket = args[0];
+  const char* cmd = args[1];
+  if (strcmp(cmd, "bench") == 0)
+    return run_bench(&cfg);
+
+  int fd = connect_to(cfg.socket);
+  if (fd < 0)
+    return 1;
+  uint32_t params[CMS_MAX_TOPK];
+  int n = n_args - 2;
+  for (int i = 0; i < n; i++)
+    params[i] = (uint32_t)strtoul(args[i + 2], NULL, 10);
+
+  ResponseHeader rh;
+  char* resp = NULL;
+  int status = -1;
+  if (strcmp(cmd, "point") == 0 && n == 1)
+    status = request(fd, CMS_POINT, cfg.sketch, 1, params, sizeof(uint32_t), &rh, &resp);
+  else if (strcmp(cmd, "batch") == 0 && n >= 1)
+    status = request(fd, CMS_BATCH, cfg.sketch, n, params, n * sizeof(uint32_t), &rh, &resp);
+  else if (strcmp(cmd, "range") == 0 && n == 2)
+    status = request(fd, CMS_RANGE, cfg.sketch, 0, params, 2 * sizeof(uint32_t), &rh, &resp);
+  else if (strcmp(cmd, "topk") == 0 && n == 3)
+    status = request(fd, CMS_TOPK, cfg.sketch, params[0], params + 1, 2 * sizeof(uint32_t), &rh, &resp);
+  else if (strcmp(cmd, "inner") == 0 && n == 1)
+    status = request(fd, CMS_INNER, cfg.sketch, 0, params, sizeof(uint32_t), &rh, &resp);
+  else if (strcmp(cmd, "info") == 0 && n == 0)
+    status = request(fd, CMS_INFO, cfg.sketch, 0, NULL, 0, &rh, &resp);
+  else if (strcmp(cmd, "stats") == 0 && n == 0)
+    status = request(fd, CMS_STATS, cfg.sketch, 0, NULL, 0, &rh, &resp);
+  else {
+    print_usage(argv[0]);
+    close(fd);
+    return 1;
+  }
+  close(fd);
+  if (status != 0) {
+    fprintf(stderr, "Error: connection to %s lost\n", cfg.socket);
+    return 1;
+  }
+  if (rh.status != CMS_OK) {
+    fprintf(stderr, "Error: the server answered status %u\n", rh.status);
+    free(resp);
+    return 1;
+  }
+
+  if (strcmp(cmd, "point") == 0 || strcmp(cmd, "batch") == 0) {
+    for (int i = 0; i < n; i++)
+      printf("%u %u\n", params[i], ((uint32_t*)resp)[i]);
+  } else if (strcmp(cmd, "range") == 0 || strcmp(cmd, "inner") == 0) {
+    uint64_t v;
+    memcpy(&v, resp, sizeof(v));
+    printf("%llu\n", (unsigned long long)v);
+  } else if (strcmp(cmd, "topk") == 0) {
+    const CmsKeyEstimate* top = (const CmsKeyEstimate*)resp;
+    for (uint32_t i = 0; i < rh.bytes / sizeof(CmsKeyEstimate); i++)
+      printf("%u %u\n", top[i].key, top[i].estimate);
+  } else if (strcmp(cmd, "info") == 0) {
+    const CmsInfo* info = (const CmsInfo*)resp;
+    printf("depth %u, width %u, %llu items, epsilon %g, delta %g, %u sketches, %u threads\n", info->depth,
+           info->width, (unsigned long long)info->total, info->epsilon, info->delta, info->sketches, info->threads);
+  } else {
+    printf("%s\n", resp);
+  }
+  free(resp);
+  return 0;
+}
@@ -0,0 +1,644 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../core/cms_accuracy.h"
+#include "../core/cms_snapshot.h"
+#include "cms_protocol.h"
+
+/*
+ * Query server for sketch snapshots (--snapshot=FILE of the drivers)
+ * maps the snapshots read-only and answers the requests of cms_protocol.h on a
+ * Unix domain socket. The connections are registered one-shot in a single
+ * epoll set shared by a pool of reader threads: a ready connection is taken by
+ * exactly one thread, which reads everything the client has sent, answers all
+ * the complete requests in it and sends the responses back with one write.
+ * A client pipelining requests therefore gets them served in batches.
+ * Responses the socket does not take are kept with the connection, which is
+ * then re-armed for EPOLLOUT only: a client that stops reading holds no thread
+ * and gets no new request answered until it has drained them.
+ * Every thread keeps a latency histogram of its requests, from the read that
+ * brought the request in to its response being ready, reported by CMS_STATS
+ * and on exit.
+ *
+ *   ./cms_serve /tmp/cms.sock sketch.snap [more.snap ...] [--threads=n]
+ */
+
+#define MAX_SKETCHES 16
+#define READ_CHUNK (64u << 10)
+#define READ_LIMIT (8u << 20)  // buffered input per connection before answering, above the largest request
+#define QUERY_KEYS 1024  // keys per block of a range or top-k scan
+
+// log-linear latency buckets: 16 per power of two of nanoseconds
+#define LAT_SUB_BITS 4
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS (64 * LAT_SUB)
+
+typedef struct {
+  uint64_t requests;
+  uint64_t keys;
+  uint64_t reads;  // reads that brought in at least one request
+  uint64_t errors;
+  uint64_t lat[LAT_BUCKETS];
+} WorkerStats;
+
+typedef struct {
+  int fd;
+  char* in;
+  size_t in_len, in_cap;
+  char* out;
+  size_t out_len, out_cap;
+  size_t out_sent;  // bytes of out already written
+  int closed;       // the client sent its last request
+} Conn;
+
+typedef struct {
+  CmsSnapshot snaps[MAX_SKETCHES];
+  int n_snaps;
+  int listen_fd;
+  int epoll_fd;
+  int threads;
+  WorkerStats* stats;  // one per thread, read by CMS_STATS without locking
+} Server;
+
+typedef struct {
+  Server* server;
+  WorkerStats* stats;
+} Worker;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  stopping = 1;
+}
+
+// the counters of a thread have a single writer: relaxed stores keep the
+// lock-free reads of CMS_STATS well defined without a locked add per request
+static inline void bump(uint64_t* counter, uint64_t v) {
+  __atomic_store_n(counter, *counter + v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline int lat_bucket(uint64_t ns) {
+  if (ns < LAT_SUB)
+    return (int)ns;
+  int e = 63 - __builtin_clzll(ns);
+  return (e - LAT_SUB_BITS + 1) * LAT_SUB + (int)((ns >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+// smallest latency of a bucket
+static uint64_t lat_lower(int b) {
+  if (b < LAT_SUB)
+    return (uint64_t)b;
+  int e = b / LAT_SUB + LAT_SUB_BITS - 1;
+  return (uint64_t)(LAT_SUB + b % LAT_SUB) << (e - LAT_SUB_BITS);
+}
+
+// ---------------------------------------------------------------- queries
+
+static inline uint32_t point_query(const CountMinSketch* cms, uint32_t key) {
+  uint32_t min = UINT32_MAX;
+  for (uint32_t d = 0; d < cms->depth; d++) {
+    uint32_t v = cms->table[d][cms_column(&cms->hashFunctions[d], key)];
+    if (v < min) min = v;
+  }
+  return min;
+}
+
+// estimates of the keys [lo, lo + n), n <= QUERY_KEYS, through the batched path
+static void query_block(const CountMinSketch* cms, uint32_t lo, uint32_t n, uint32_t* keys, uint32_t* est) {
+  for (uint32_t i = 0; i < n; i++)
+    keys[i] = lo + i;
+  cms_point_query_batch(cms, keys, n, est);
+}
+
+static uint64_t range_query(const CountMinSketch* cms, uint32_t lo, uint32_t hi) {
+  uint32_t keys[QUERY_KEYS], est[QUERY_KEYS];
+  uint64_t sum = 0;
+  for (uint64_t k = lo; k <= hi; k += QUERY_KEYS) {
+    uint32_t n = hi - k + 1 < QUERY_KEYS ? (uint32_t)(hi - k + 1) : QUERY_KEYS;
+    query_block(cms, (uint32_t)k, n, keys, est);
+    for (uint32_t i = 0; i < n; i++)
+      sum += est[i];
+  }
+  return sum;
+}
+
+// heap order: the smallest estimate on top, on ties the largest key
+static inline int heap_less(const CmsKeyEstimate* a, const CmsKeyEstimate* b) {
+  return a->estimate < b->estimate || (a->estimate == b->estimate && a->key > b->key);
+}
+
+static void sift_down(CmsKeyEstimate* heap, uint32_t n, uint32_t i) {
+  for (;;) {
+    uint32_t l = 2 * i + 1, r = l + 1, m = i;
+    if (l < n && heap_less(&heap[l], &heap[m])) m = l;
+    if (r < n && heap_less(&heap[r], &heap[m])) m = r;
+    if (m == i)
+      return;
+    CmsKeyEstimate t = heap[i];
+    heap[i] = heap[m];
+    heap[m] = t;
+    i = m;
+  }
+}
+
+// the k keys of [lo, hi] with the largest estimates, largest first; returns how many
+static uint32_t topk_query(const CountMinSketch* cms, uint32_t lo, uint32_t hi, uint32_t k, CmsKeyEstimate* heap) {
+  uint32_t keys[QUERY_KEYS], est[QUERY_KEYS];
+  uint32_t n = 0;
+  for (uint64_t base = lo; base <= hi; base += QUERY_KEYS) {
+    uint32_t m = hi - base + 1 < QUERY_KEYS ? (uint32_t)(hi - base + 1) : QUERY_KEYS;
+    query_block(cms, (uint32_t)base, m, keys, est);
+    for (uint32_t i = 0; i < m; i++) {
+      CmsKeyEstimate e = {keys[i], est[i]};
+      if (n < k) {
+        // sift up
+        uint32_t j = n++;
+        heap[j] = e;
+        while (j > 0 && heap_less(&heap[j], &heap[(j - 1) / 2])) {
+          CmsKeyEstimate t = heap[j];
+          heap[j] = heap[(j - 1) / 2];
+          heap[(j - 1) / 2] = t;
+          j = (j - 1) / 2;
+        }
+      } else if (heap_less(&heap[0], &e)) {
+        heap[0] = e;
+        sift_down(heap, n, 0);
+      }
+    }
+  }
+  // heap sort: the smallest goes last
+  for (uint32_t end = n; end > 1; end--) {
+    CmsKeyEstimate t = heap[0];
+    heap[0] = heap[end - 1];
+    heap[end - 1] = t;
+    sift_down(heap, end - 1, 0);
+  }
+  return n;
+}
+
+// min over the rows of the row dot products, both sketches must share their hashes
+static uint64_t inner_product(const CountMinSketch* a, const CountMinSketch* b) {
+  uint64_t min = UINT64_MAX;
+  for (uint32_t d = 0; d < a->depth; d++) {
+    uint64_t sum = 0;
+    for (uint32_t j = 0; j < a->width; j++)
+      sum += (uint64_t)a->table[d][j] * b->table[d][j];
+    if (sum < min) min = sum;
+  }
+  return min;
+}
+
+static int same_shape(const CountMinSketch* a, const CountMinSketch* b) {
+  return a->depth == b->depth && a->width == b->width &&
+         memcmp(a->hashFunctions, b->hashFunctions, a->depth * sizeof(UniversalHash)) == 0;
+}
+
+// ---------------------------------------------------------------- connections
+
+static int reserve(char** buf, size_t* cap, size_t need) {
+  if (need <= *cap)
+    return 0;
+  size_t c = *cap ? *cap : READ_CHUNK;
+  while (c < need) c *= 2;
+  char* p = realloc(*buf, c);
+  if (!p)
+    return -1;
+  *buf = p;
+  *cap = c;
+  return 0;
+}
+
+// room for a response of payload bytes, returns its payload or NULL if out of memory
+static char* begin_response(Conn* c, uint32_t status, uint32_t bytes) {
+  if (reserve(&c->out, &c->out_cap, c->out_len + sizeof(ResponseHeader) + bytes) != 0)
+    return NULL;
+  ResponseHeader h = {status, bytes};
+  memcpy(c->out + c->out_len, &h, sizeof(h));
+  char* payload = c->out + c->out_len + sizeof(h);
+  c->out_len += sizeof(h) + bytes;
+  return payload;
+}
+
+static int write_stats(const Server* s, char* buf, size_t cap);
+
+// answer one complete request, returns -1 if the connection has to be dropped
+static int handle(Server* s, Conn* c, const RequestHeader* h, const char* payload, WorkerStats* ws) {
+  if (h->sketch >= s->n_snaps && h->op != CMS_STATS) {
+    bump(&ws->errors, 1);
+    return begin_response(c, CMS_EBADSKETCH, 0) ? 0 : -1;
+  }
+  const CountMinSketch* cms = &s->snaps[h->op != CMS_STATS ? h->sketch : 0].cms;
+  uint32_t a, b;
+  char* out;
+
+  switch (h->op) {
+    case CMS_POINT: {
+      memcpy(&a, payload, sizeof(a));
+      if (!(out = begin_response(c, CMS_OK, sizeof(uint32_t))))
+        return -1;
+      uint32_t est = point_query(cms, a);
+      memcpy(out, &est, sizeof(est));
+      bump(&ws->keys, 1);
+      return 0;
+    }
+
+    case CMS_BATCH:
+      if (!(out = begin_response(c, CMS_OK, h->n * sizeof(uint32_t))))
+        return -1;
+      // payload and response offsets are multiples of 4 in malloc'd buffers
+      cms_point_query_batch(cms, (const uint32_t*)payload, h->n, (uint32_t*)out);
+      bump(&ws->keys, h->n);
+      return 0;
+
+    case CMS_RANGE:
+    case CMS_TOPK: {
+      memcpy(&a, payload, sizeof(a));
+      memcpy(&b, payload + sizeof(a), sizeof(b));
+      if (a > b || (uint64_t)b - a + 1 > CMS_MAX_RANGE || (h->op == CMS_TOPK && (h->n == 0 || h->n > CMS_MAX_TOPK))) {
+        bump(&ws->errors, 1);
+        return begin_response(c, CMS_ETOOBIG, 0) ? 0 : -1;
+      }
+      bump(&ws->keys, (uint64_t)b - a + 1);
+      if (h->op == CMS_RANGE) {
+        uint64_t sum = range_query(cms, a, b);
+        if (!(out = begin_response(c, CMS_OK, sizeof(sum))))
+          return -1;
+        memcpy(out, &sum, sizeof(sum));
+        return 0;
+      }
+      CmsKeyEstimate top[CMS_MAX_TOPK];
+      uint32_t n = topk_query(cms, a, b, h->n, top);
+      if (!(out = begin_response(c, CMS_OK, n * sizeof(CmsKeyEstimate))))
+        return -1;
+      memcpy(out, top, n * sizeof(CmsKeyEstimate));
+      return 0;
+    }
+
+    case CMS_INNER: {
+      memcpy(&a, payload, sizeof(a));
+      if (a >= (uint32_t)s->n_snaps || !same_shape(cms, &s->snaps[a].cms)) {
+        bump(&ws->errors, 1);
+        return begin_response(c, a >= (uint32_t)s->n_snaps ? CMS_EBADSKETCH : CMS_EMISMATCH, 0) ? 0 : -1;
+      }
+      uint64_t ip = inner_product(cms, &s->snaps[a].cms);
+      if (!(out = begin_response(c, CMS_OK, sizeof(ip))))
+        return -1;
+      memcpy(out, &ip, sizeof(ip));
+      return 0;
+    }
+
+    case CMS_INFO: {
+      CmsInfo info = {cms->depth, cms->width, s->snaps[h->sketch].total, cms->epsilon, cms->delta,
+                      (uint32_t)s->n_snaps, (uint32_t)s->threads};
+      if (!(out = begin_response(c, CMS_OK, sizeof(info))))
+        return -1;
+      memcpy(out, &info, sizeof(info));
+      return 0;
+    }
+
+    case CMS_STATS: {
+      char text[1024];
+      int len = write_stats(s, text, sizeof(text));
+      if (!(out = begin_response(c, CMS_OK, (uint32_t)len)))
+        return -1;
+      memcpy(out, text, len);
+      return 0;
+    }
+
+    default:
+      bump(&ws->errors, 1);
+      return begin_response(c, CMS_EBADOP, 0) ? 0 : -1;
+  }
+}
+
+// write as much of the pending responses as the socket takes, the rest waits
+// for EPOLLOUT; returns -1 if the connection is broken
+static int flush_out(Conn* c) {
+  while (c->out_sent < c->out_len) {
+    ssize_t w = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+    if (w > 0)
+      c->out_sent += (size_t)w;
+    else if (w < 0 && errno == EINTR)
+      continue;
+    else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return 0;
+    else
+      return -1;
+  }
+  c->out_len = c->out_sent = 0;
+  return 0;
+}
+
+static int out_pending(const Conn* c) {
+  return c->out_sent < c->out_len;
+}
+
+// read what the client sent and answer every complete request,
+// returns -1 once the connection is closed or broken
+static int serve(Server* s, Conn* c, WorkerStats* ws) {
+  // no new requests are read while the previous responses are still pending
+  if (out_pending(c)) {
+    if (flush_out(c) != 0)
+      return -1;
+    if (out_pending(c))
+      return 0;
+    if (c->closed)
+      return -1;
+  }
+
+  for (;;) {
+    if (reserve(&c->in, &c->in_cap, c->in_len + READ_CHUNK) != 0)
+      return -1;
+    ssize_t r = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+    if (r > 0) {
+      c->in_len += (size_t)r;
+      // a client that keeps sending is answered now, epoll reports the rest again
+      if (c->in_len >= READ_LIMIT)
+        break;
+      continue;
+    }
+    if (r == 0)
+      c->closed = 1;
+    else if (errno == EINTR)
+      continue;
+    else if (errno != EAGAIN && errno != EWOULDBLOCK)
+      return -1;
+    break;
+  }
+
+  uint64_t t_read = now_ns();
+  size_t pos = 0;
+  int answered = 0;
+  while (c->in_len - pos >= sizeof(RequestHeader)) {
+    RequestHeader h;
+    memcpy(&h, c->in + pos, sizeof(h));
+    if (h.op == CMS_BATCH && h.n > CMS_MAX_KEYS) {
+      // the payload cannot be skipped safely, answer and drop the client
+      begin_response(c, CMS_ETOOBIG, 0);
+      flush_out(c);
+      return -1;
+    }
+    size_t need = sizeof(h) + (size_t)cms_request_bytes(&h);
+    if (c->in_len - pos < need)
+      break;
+    if (handle(s, c, &h, c->in + pos + sizeof(h), ws) != 0)
+      return -1;
+    pos += need;
+    answered++;
+    bump(&ws->requests, 1);
+    bump(&ws->lat[lat_bucket(now_ns() - t_read)], 1);
+  }
+  if (answered)
+    bump(&ws->reads, 1);
+
+  // keep the partial request at the front, aligned as it was sent
+  if (pos > 0) {
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+  }
+  if (flush_out(c) != 0)
+    return -1;
+  return c->closed && !out_pending(c) ? -1 : 0;
+}
+
+static void conn_close(Conn* c) {
+  close(c->fd);
+  free(c->in);
+  free(c->out);
+  free(c);
+}
+
+static void accept_all(Server* s) {
+  for (;;) {
+    int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    Conn* c = calloc(1, sizeof(Conn));
+    if (!c) {
+      close(fd);
+      continue;
+    }
+    c->fd = fd;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, .data.ptr = c};
+    if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+      conn_close(c);
+  }
+}
+
+static void* worker_main(void* arg) {
+  Worker* w = arg;
+  Server* s = w->server;
+  while (!stopping) {
+    // one event at a time, so a busy thread does not hold ready connections back
+    struct epoll_event ev;
+    int n = epoll_wait(s->epoll_fd, &ev, 1, 200);
+    if (n <= 0)
+      continue;
+    if (ev.data.ptr == NULL) {
+      accept_all(s);
+      struct epoll_event again = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = NULL};
+      epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, s->listen_fd, &again);
+      continue;
+    }
+    Conn* c = ev.data.ptr;
+    if (serve(s, c, w->stats) != 0) {
+      epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+      conn_close(c);
+      continue;
+    }
+    // pending responses: wait for room only, EPOLLRDHUP would keep firing after
+    // a half close; a peer gone for good still wakes it with EPOLLHUP or EPOLLERR
+    uint32_t events = out_pending(c) ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+    struct epoll_event again = {.events = events | EPOLLONESHOT, .data.ptr = c};
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, c->fd, &again);
+  }
+  return NULL;
+}
+
+// ---------------------------------------------------------------- statistics
+
+// sums of the threads' counters, read while they run: a snapshot, not an atomic one
+static void merge_stats(const Server* s, WorkerStats* all) {
+  memset(all, 0, sizeof(*all));
+  for (int t = 0; t < s->threads; t++) {
+    const WorkerStats* ws = &s->stats[t];
+    all->requests += __atomic_load_n(&ws->requests, __ATOMIC_RELAXED);
+    all->keys += __atomic_load_n(&ws->keys, __ATOMIC_RELAXED);
+    all->reads += __atomic_load_n(&ws->reads, __ATOMIC_RELAXED);
+    all->errors += __atomic_load_n(&ws->errors, __ATOMIC_RELAXED);
+    for (int b = 0; b < LAT_BUCKETS; b++)
+      all->lat[b] += __atomic_load_n(&ws->lat[b], __ATOMIC_RELAXED);
+  }
+}
+
+// upper end of the bucket holding the request of rank ceil(p * n)
+static uint64_t lat_percentile(const WorkerStats* all, double p) {
+  uint64_t n = 0;
+  for (int b = 0; b < LAT_BUCKETS; b++)
+    n += all->lat[b];
+  if (n == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(p * n + 0.999999), seen = 0;
+  for (int b = 0; b < LAT_BUCKETS; b++) {
+    seen += all->lat[b];
+    if (seen >= rank && all->lat[b])
+      return b + 1 < LAT_BUCKETS ? lat_lower(b + 1) - 1 : UINT64_MAX;
+  }
+  return UINT64_MAX;
+}
+
+static int write_stats(const Server* s, char* buf, size_t cap) {
+  WorkerStats all;
+  merge_stats(s, &all);
+  int len = snprintf(buf, cap,
+                     "{\"threads\":%d,\"requests\":%llu,\"keys\":%llu,\"batches\":%llu,\"errors\":%llu,"
+                     "\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu}}",
+                     s->threads, (unsigned long long)all.requests, (unsigned long long)all.keys,
+                     (unsigned long long)all.reads, (unsigned long long)all.errors,
+                     (unsigned long long)lat_percentile(&all, 0.5), (unsigned long long)lat_percentile(&all, 0.9),
+                     (unsigned long long)lat_percentile(&all, 0.99), (unsigned long long)lat_percentile(&all, 0.999));
+  return len < (int)cap ? len : (int)cap - 1;
+}
+
+// ---------------------------------------------------------------- setup
+
+static int open_socket(const char* path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error: socket path too long\n");
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  // a socket left by a previous server is replaced, any other file is not
+  struct stat st;
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "Error: %s exists and is not a socket\n", path);
+      return -1;
+    }
+    unlink(path);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s <socket> <snapshot> [snapshot ...] [options]\n"
+          "  serves the snapshots written by the drivers with --snapshot=file, sketch 0 is the first\n"
+          "  --threads=n        reader threads (default: online CPUs)\n"
+          "Stops on SIGINT or SIGTERM and prints the latency percentiles.\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  Server s;
+  memset(&s, 0, sizeof(s));
+  s.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  const char* socket_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--threads=", 10) == 0) {
+      s.threads = atoi(argv[i] + 10);
+    } else if (strncmp(argv[i], "--", 2) == 0) {
+      fprintf(stderr, "Error: unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    } else if (!socket_path) {
+      socket_path = argv[i];
+    } else if (s.n_snaps == MAX_SKETCHES) {
+      fprintf(stderr, "Error: at most %d snapshots\n", MAX_SKETCHES);
+      return 1;
+    } else if (snapshot_map(argv[i], &s.snaps[s.n_snaps]) != 0) {
+      fprintf(stderr, "Error: cannot load the snapshot %s\n", argv[i]);
+      return 1;
+    } else {
+      const CmsSnapshot* snap = &s.snaps[s.n_snaps++];
+      printf("sketch %d: %s, depth %u, width %u, %llu items\n", s.n_snaps - 1, argv[i], snap->cms.depth,
+             snap->cms.width, (unsigned long long)snap->total);
+    }
+  }
+  if (!socket_path || s.n_snaps == 0 || s.threads <= 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  s.listen_fd = open_socket(socket_path);
+  s.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = NULL};
+  if (s.listen_fd < 0 || s.epoll_fd < 0 || epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, s.listen_fd, &ev) != 0)
+    return 1;
+
+  s.stats = aligned_alloc(64, ((s.threads * sizeof(WorkerStats) + 63) / 64) * 64);
+  pthread_t* tids = malloc(s.threads * sizeof(pthread_t));
+  Worker* workers = malloc(s.threads * sizeof(Worker));
+  if (!s.stats || !tids || !workers) {
+    fprintf(stderr, "Error allocating the reader threads\n");
+    return 1;
+  }
+  memset(s.stats, 0, s.threads * sizeof(WorkerStats));
+  for (int t = 0; t < s.threads; t++) {
+    workers[t] = (Worker){&s, &s.stats[t]};
+    if (pthread_create(&tids[t], NULL, worker_main, &workers[t]) != 0) {
+      fprintf(stderr, "Error starting the reader threads\n");
+      return 1;
+    }
+  }
+  printf("listening on %s with %d threads\n", socket_path, s.threads);
+  fflush(stdout);
+
+  for (int t = 0; t < s.threads; t++)
+    pthread_join(tids[t], NULL);
+
+  char text[1024];
+  write_stats(&s, text, sizeof(text));
+  printf("%s\n", text);
+
+  // connections still open are dropped with the process
+  close(s.listen_fd);
+  close(s.epoll_fd);
+  unlink(socket_path);
+  for (int i = 0; i < s.n_snaps; i++)
+    snapshot_unmap(&s.snaps[i]);
+  free(s.stats);
+  free(tids);
+  free(workers);
+  return 0;
+}